@@ -29,12 +29,17 @@ static char* lskip(char *s) {
 
 // Format:
 // achievement <id> "<title>" <memaddr>
+// leaderboard <id> "<title>" <STA:...::CAN:...::SUB:...::VAL:...> [FORMAT]
+// richpresence
+// <rcheevos rich presence script lines>
+// end
 //
 // Examples:
 // achievement 1 "Entered World 1-1" 0xH00075C=1
 // achievement 2 "Stockpile (5 lives)" 0xH00075A=5
 // achievement 3 "Counter Hit 5 (coins LE16)" 0xH0007ED=5
-static bool parse_line(const char *line_in, mmr_ach_def_t *out) {
+// leaderboard 10 "Most coins" STA:0xH00075C=1::CAN:0xH00075A=0::SUB:0xH00075C=2::VAL:0xH0007ED SCORE
+static bool parse_line(const char *line_in, const char *kw, mmr_ach_def_t *out) {
   char buf[2048];
   memset(out, 0, sizeof(*out));
 
@@ -48,8 +53,7 @@ static bool parse_line(const char *line_in, mmr_ach_def_t *out) {
   if (*s == '#') return false;
   if (s[0] == '/' && s[1] == '/') return false;
 
-  // must start with "achievement"
-  const char *kw = "achievement";
+  // must start with the keyword
   size_t kwlen = strlen(kw);
   if (strncmp(s, kw, kwlen) != 0 || !isspace((unsigned char)s[kwlen])) return false;
   s = lskip(s + kwlen);
@@ -71,70 +75,173 @@ static bool parse_line(const char *line_in, mmr_ach_def_t *out) {
   s++;
   s = lskip(s);
 
-  // remainder is memaddr string
+  // remainder is memaddr string (memaddrs contain no spaces, so anything
+  // after one is the optional leaderboard format)
   if (!*s) return false;
   char *memaddr = s;
+  char *format = NULL;
+  while (*s && !isspace((unsigned char)*s)) s++;
+  if (*s) {
+    *s++ = 0;
+    s = lskip(s);
+    if (*s) format = s;
+  }
 
   out->id = (uint32_t)id;
   out->title = mmr_strdup(title);
   out->memaddr = mmr_strdup(memaddr);
-  if (!out->title || !out->memaddr) {
+  out->format = format ? mmr_strdup(format) : NULL;
+  if (!out->title || !out->memaddr || (format && !out->format)) {
     free(out->title);
     free(out->memaddr);
+    free(out->format);
     memset(out, 0, sizeof(*out));
     return false;
   }
   return true;
 }
 
+// true if the trimmed line is exactly word
+static bool line_is(const char *line, const char *word) {
+  char buf[64];
+  strncpy(buf, line, sizeof(buf)-1);
+  buf[sizeof(buf)-1] = 0;
+  rstrip(buf);
+  return strcmp(lskip(buf), word) == 0;
+}
+
+static bool list_push(mmr_ach_def_t **items, size_t *count, size_t *cap, const mmr_ach_def_t *def) {
+  if (*count == *cap) {
+    size_t ncap = *cap ? *cap * 2 : 16;
+    mmr_ach_def_t *nitems = (mmr_ach_def_t*)realloc(*items, ncap * sizeof(*nitems));
+    if (!nitems) return false;
+    *items = nitems;
+    *cap = ncap;
+  }
+  (*items)[(*count)++] = *def;
+  return true;
+}
+
+// Appends one script line (with its trailing newline normalised) to *rp.
+static bool rp_append(char **rp, size_t *len, const char *line) {
+  size_t n = strlen(line);
+  while (n && (line[n-1] == '\n' || line[n-1] == '\r')) n--;
+
+  char *p = (char*)realloc(*rp, *len + n + 2);
+  if (!p) return false;
+  memcpy(p + *len, line, n);
+  p[*len + n] = '\n';
+  p[*len + n + 1] = 0;
+  *rp = p;
+  *len += n + 1;
+  return true;
+}
+
+typedef struct {
+  mmr_ach_list_t *out;
+  size_t cap;
+  size_t lboard_cap;
+  size_t rp_len;
+  bool in_rp;
+} load_state_t;
+
+// One line of a set; false on OOM.
+static bool load_line(load_state_t *st, const char *line) {
+  mmr_ach_list_t *out = st->out;
+  mmr_ach_def_t def;
+  bool ok;
+
+  if (st->in_rp) {
+    if (line_is(line, "end")) st->in_rp = false;
+    else return rp_append(&out->richpresence, &st->rp_len, line);
+    return true;
+  }
+
+  if (line_is(line, "richpresence")) {
+    // a later block replaces an earlier one
+    free(out->richpresence);
+    out->richpresence = NULL;
+    st->rp_len = 0;
+    st->in_rp = true;
+    return true;
+  }
+
+  if (parse_line(line, "achievement", &def)) {
+    ok = list_push(&out->items, &out->count, &st->cap, &def);
+  } else if (parse_line(line, "leaderboard", &def)) {
+    ok = list_push(&out->lboards, &out->lboard_count, &st->lboard_cap, &def);
+  } else {
+    return true;
+  }
+
+  if (!ok) {
+    free(def.title);
+    free(def.memaddr);
+    free(def.format);
+  }
+  return ok;
+}
+
 bool mmr_ach_load_file(const char *path, mmr_ach_list_t *out) {
   memset(out, 0, sizeof(*out));
   FILE *f = fopen(path, "r");
   if (!f) return false;
 
-  mmr_ach_def_t *items = NULL;
-  size_t count = 0, cap = 0;
+  load_state_t st = { .out = out };
+  bool ok = true;
 
   char line[2048];
-  while (fgets(line, sizeof(line), f)) {
-    mmr_ach_def_t def;
-    if (!parse_line(line, &def)) continue;
-
-    if (count == cap) {
-      size_t ncap = cap ? cap * 2 : 16;
-      mmr_ach_def_t *nitems = (mmr_ach_def_t*)realloc(items, ncap * sizeof(*nitems));
-      if (!nitems) {
-        // cleanup
-        free(def.title);
-        free(def.memaddr);
-        fclose(f);
-        for (size_t i = 0; i < count; i++) {
-          free(items[i].title);
-          free(items[i].memaddr);
-        }
-        free(items);
-        return false;
-      }
-      items = nitems;
-      cap = ncap;
-    }
+  while (ok && fgets(line, sizeof(line), f)) ok = load_line(&st, line);
 
-    items[count++] = def;
+  fclose(f);
+  if (!ok) {
+    mmr_ach_free(out);
+    return false;
   }
+  return true;
+}
 
-  fclose(f);
-  out->items = items;
-  out->count = count;
+bool mmr_ach_load_text(const char *text, size_t len, mmr_ach_list_t *out) {
+  memset(out, 0, sizeof(*out));
+
+  load_state_t st = { .out = out };
+  bool ok = true;
+
+  // split as fgets would with the same buffer: an overlong line comes
+  // through in pieces
+  char line[2048];
+  size_t pos = 0;
+  while (ok && pos < len) {
+    size_t n = 0;
+    while (pos < len && n < sizeof(line) - 1) {
+      char c = text[pos++];
+      line[n++] = c;
+      if (c == '\n') break;
+    }
+    line[n] = 0;
+    ok = load_line(&st, line);
+  }
+
+  if (!ok) {
+    mmr_ach_free(out);
+    return false;
+  }
   return true;
 }
 
+static void free_defs(mmr_ach_def_t *items, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    free(items[i].title);
+    free(items[i].memaddr);
+    free(items[i].format);
+  }
+  free(items);
+}
+
 void mmr_ach_free(mmr_ach_list_t *list) {
   if (!list) return;
-  for (size_t i = 0; i < list->count; i++) {
-    free(list->items[i].title);
-    free(list->items[i].memaddr);
-  }
-  free(list->items);
-  list->items = NULL;
-  list->count = 0;
+  free_defs(list->items, list->count);
+  free_defs(list->lboards, list->lboard_count);
+  free(list->richpresence);
+  memset(list, 0, sizeof(*list));
 }
@@ -7,16 +7,28 @@ typedef struct {
   uint32_t id;
   char *title;     // heap allocated
   char *memaddr;   // heap allocated (rcheevos memaddr string)
+  char *format;    // leaderboards only: optional value format (SCORE, TIME, ...), or NULL
 } mmr_ach_def_t;
 
 typedef struct {
   mmr_ach_def_t *items;
   size_t count;
+
+  // leaderboards reuse mmr_ach_def_t; memaddr is the "STA:...::CAN:...::SUB:...::VAL:..." string
+  mmr_ach_def_t *lboards;
+  size_t lboard_count;
+
+  // rich presence script (newline-separated, rcheevos syntax) or NULL
+  char *richpresence;
 } mmr_ach_list_t;
 
 // Loads a simple .ach text file (see achievements/smb1_demo.ach for format).
 // Returns true on success, false on failure.
 bool mmr_ach_load_file(const char *path, mmr_ach_list_t *out);
 
+// The same for a set already in memory (len bytes, need not be
+// NUL-terminated), e.g. one mapped from a library (achlib.h).
+bool mmr_ach_load_text(const char *text, size_t len, mmr_ach_list_t *out);
+
 // Frees all heap allocations in a list.
 void mmr_ach_free(mmr_ach_list_t *list);
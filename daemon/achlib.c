@@ -0,0 +1,100 @@
+#include "achlib.h"
+#include "notify.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int hex_digit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool achlib_hash_parse(const char *s, uint8_t out[16]) {
+  for (size_t i = 0; i < 16; i++) {
+    int hi = hex_digit(s[2 * i]);
+    int lo = hi >= 0 ? hex_digit(s[2 * i + 1]) : -1;
+    if (lo < 0) return false;
+    out[i] = (uint8_t)(hi << 4 | lo);
+  }
+  return s[32] == 0;
+}
+
+bool achlib_open(achlib_t *lib, const char *path) {
+  memset(lib, 0, sizeof(*lib));
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    notify(NOTIFY_WARN, "achlib: %s: %s", path, strerror(errno));
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(mmr_achlib_header_t)) {
+    notify(NOTIFY_WARN, "achlib: %s: too short", path);
+    close(fd);
+    return false;
+  }
+  size_t size = (size_t)st.st_size;
+  void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    notify(NOTIFY_WARN, "achlib: %s: mmap failed: %s", path, strerror(errno));
+    return false;
+  }
+  /* lookups touch a few scattered pages; readahead would pull in the sets
+   * around them */
+  (void)madvise(p, size, MADV_RANDOM);
+
+  const mmr_achlib_header_t *h = (const mmr_achlib_header_t*)p;
+  const char *why = NULL;
+  if (h->magic != MMR_ACHLIB_MAGIC) why = "not a library";
+  else if (h->version != MMR_ACHLIB_VERSION) why = "unsupported version";
+  else if (h->header_size < sizeof(*h) || h->entry_size != sizeof(mmr_achlib_entry_t)) why = "bad header";
+  else if (h->file_size != size) why = "size does not match the header (truncated?)";
+  else if (h->index_offset % _Alignof(mmr_achlib_entry_t) != 0 ||
+           h->index_offset < h->header_size || h->index_offset > size ||
+           (size - h->index_offset) / sizeof(mmr_achlib_entry_t) < h->count) why = "index out of range";
+  if (why) {
+    notify(NOTIFY_WARN, "achlib: %s: %s", path, why);
+    munmap(p, size);
+    return false;
+  }
+
+  lib->base = (const uint8_t*)p;
+  lib->map_size = size;
+  lib->hdr = h;
+  lib->index = (const mmr_achlib_entry_t*)(lib->base + h->index_offset);
+  lib->count = h->count;
+  return true;
+}
+
+bool achlib_find(const achlib_t *lib, const char *hash, const char **text, size_t *len) {
+  uint8_t key[16];
+  if (!lib->base || !achlib_hash_parse(hash, key)) return false;
+
+  uint32_t lo = 0, hi = lib->count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    int c = memcmp(lib->index[mid].hash, key, sizeof(key));
+    if (c == 0) {
+      const mmr_achlib_entry_t *e = &lib->index[mid];
+      if (e->offset > lib->map_size || lib->map_size - e->offset < e->length) return false;
+      *text = (const char*)(lib->base + e->offset);
+      *len = e->length;
+      return true;
+    }
+    if (c < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  return false;
+}
+
+void achlib_close(achlib_t *lib) {
+  if (lib->base) munmap((void*)lib->base, lib->map_size);
+  memset(lib, 0, sizeof(*lib));
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Achievement-set library (--ach-lib): the .ach sets for many games packed
+// into one file, found by the game's rc_hash (see romhash.h).
+//
+// The file is mapped read-only and advised MADV_RANDOM, so the kernel reads
+// only the pages a lookup touches: the header, the handful of index pages
+// a binary search visits, and the selected set. mmr-achpack builds it from a
+// directory of <hash>.ach files (the --ach-dir naming) and places each set on
+// a page boundary by default, so no set shares a page with another.
+//
+// Layout (little-endian, fixed offsets):
+//   mmr_achlib_header_t            at offset 0
+//   mmr_achlib_entry_t[count]      at index_offset, sorted by hash
+//   the sets' .ach text, verbatim  at each entry's offset
+
+#define MMR_ACHLIB_MAGIC    0x4C43414Du  // 'MACL'
+#define MMR_ACHLIB_VERSION  1u
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t entry_size;
+  uint32_t count;           // sets in the index
+  uint32_t align;           // set alignment the packer used (informational)
+  uint64_t index_offset;
+  uint64_t file_size;       // the packer's; a shorter file is truncated
+  uint8_t reserved[24];
+} mmr_achlib_header_t;      // 64 bytes
+
+typedef struct {
+  uint8_t hash[16];         // rc_hash as bytes (memcmp order = hex order)
+  uint64_t offset;          // the set's text, from the start of the file
+  uint32_t length;          // bytes, no terminator
+  uint16_t achievements;    // counted by the packer, for --list
+  uint16_t lboards;
+} mmr_achlib_entry_t;       // 32 bytes
+
+typedef struct {
+  const uint8_t *base;
+  size_t map_size;
+  const mmr_achlib_header_t *hdr;
+  const mmr_achlib_entry_t *index;
+  uint32_t count;
+} achlib_t;
+
+// Parses a 32-digit hex hash (either case); false if s is anything else.
+bool achlib_hash_parse(const char *s, uint8_t out[16]);
+
+// Maps path and checks the header; false (with a warning) if it is not a
+// usable library.
+bool achlib_open(achlib_t *lib, const char *path);
+
+// The set packed for hash (32 hex digits), pointing into the mapping and
+// valid until achlib_close; false if the library has none.
+bool achlib_find(const achlib_t *lib, const char *hash, const char **text, size_t *len);
+
+void achlib_close(achlib_t *lib);
@@ -0,0 +1,368 @@
+/*
+ * mmr-achpack: build the achievement-set library mmr-daemon --ach-lib maps
+ * (see achlib.h) from a directory of per-game sets, and inspect one.
+ *
+ * Sets are taken from files named <hash>.ach, the game's rc_hash in hex as
+ * --ach-dir expects; other files are skipped. Each set is checked with the
+ * daemon's own parser and stored verbatim. The library is written next to
+ * the output as OUT.tmp and renamed over it, so a daemon starting meanwhile
+ * maps either the old library or the new one.
+ *
+ *   ./mmr-achpack -o /media/fat/mmr/sets.mmrl /media/fat/mmr/sets
+ *   ./mmr-achpack --list /media/fat/mmr/sets.mmrl
+ *   ./mmr-achpack --show 0123456789abcdef0123456789abcdef /media/fat/mmr/sets.mmrl
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ach_load.h"
+#include "achlib.h"
+
+#define ALIGN_DEFAULT 4096u
+#define ALIGN_MAX     (1u << 20)
+
+typedef struct {
+  char *path;
+  mmr_achlib_entry_t e;     /* offset filled in at layout */
+} set_t;
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+    "MiSTer Milestones achievement-set packer (mmr-achpack)\n"
+    "\n"
+    "Usage:\n"
+    "  %s [--align N] -o LIB DIR\n"
+    "  %s --list LIB\n"
+    "  %s --show HASH LIB\n"
+    "\n"
+    "Options:\n"
+    "  -o LIB                pack every DIR/<hash>.ach into the library LIB\n"
+    "  --align N             start each set on an N-byte boundary, a power of two\n"
+    "                        (default: %u, a page, so loading a set reads only its\n"
+    "                        own pages; 1 packs tightly)\n"
+    "  --list                print the library's index\n"
+    "  --show HASH           print the set packed for HASH\n"
+    "  -h, --help            show help\n",
+    argv0, argv0, argv0, ALIGN_DEFAULT);
+}
+
+static int parse_u32(const char *s, uint32_t *out) {
+  if (!s || !*s) return 0;
+  char *end = NULL;
+  errno = 0;
+  unsigned long v = strtoul(s, &end, 10);
+  if (errno || !end || *end || v > UINT32_MAX) return 0;
+  *out = (uint32_t)v;
+  return 1;
+}
+
+static uint64_t align_up(uint64_t v, uint32_t align) {
+  return (v + align - 1u) & ~(uint64_t)(align - 1u);
+}
+
+/* The whole file, or NULL (with a message). */
+static char *read_file(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "[ERR] %s: %s\n", path, strerror(errno));
+    return NULL;
+  }
+  struct stat st;
+  char *buf = NULL;
+  if (fstat(fileno(f), &st) == 0 && st.st_size >= 0 && (uint64_t)st.st_size <= UINT32_MAX) {
+    size_t n = (size_t)st.st_size;
+    buf = (char*)malloc(n ? n : 1);
+    if (buf && fread(buf, 1, n, f) != n) {
+      free(buf);
+      buf = NULL;
+    }
+    *len = n;
+  }
+  if (!buf) fprintf(stderr, "[ERR] %s: could not read it\n", path);
+  fclose(f);
+  return buf;
+}
+
+static int set_cmp(const void *a, const void *b) {
+  return memcmp(((const set_t*)a)->e.hash, ((const set_t*)b)->e.hash, 16);
+}
+
+static uint16_t sat16(size_t v) {
+  return v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+}
+
+/* <32 hex digits>.ach */
+static int hash_name(const char *name, uint8_t hash[16]) {
+  char hex[33];
+  if (strlen(name) != 36 || strcmp(name + 32, ".ach") != 0) return 0;
+  memcpy(hex, name, 32);
+  hex[32] = 0;
+  return achlib_hash_parse(hex, hash);
+}
+
+/* Every usable DIR/<hash>.ach, checked and counted, sorted by hash. */
+static set_t *scan(const char *dir, size_t *count) {
+  DIR *d = opendir(dir);
+  if (!d) {
+    fprintf(stderr, "[ERR] %s: %s\n", dir, strerror(errno));
+    return NULL;
+  }
+
+  set_t *sets = NULL;
+  size_t n = 0, cap = 0, skipped = 0, bad = 0;
+  int oom = 0;
+  struct dirent *de;
+  while ((de = readdir(d)) != NULL) {
+    uint8_t hash[16];
+    if (!hash_name(de->d_name, hash)) {
+      if (de->d_name[0] != '.') skipped++;
+      continue;
+    }
+
+    size_t plen = strlen(dir) + 1 + strlen(de->d_name) + 1;
+    char *path = (char*)malloc(plen);
+    if (!path) {
+      oom = 1;
+      break;
+    }
+    snprintf(path, plen, "%s/%s", dir, de->d_name);
+
+    size_t len = 0;
+    char *text = read_file(path, &len);
+    mmr_ach_list_t list;
+    int ok = text && mmr_ach_load_text(text, len, &list);
+    free(text);
+    if (!ok || (list.count == 0 && list.lboard_count == 0 && !list.richpresence)) {
+      if (ok) mmr_ach_free(&list);
+      fprintf(stderr, "[WARN] %s: no achievements, leaderboards or rich presence; skipped\n", path);
+      free(path);
+      bad++;
+      continue;
+    }
+
+    if (n == cap) {
+      size_t ncap = cap ? cap * 2 : 256;
+      set_t *nsets = (set_t*)realloc(sets, ncap * sizeof(*nsets));
+      if (!nsets) {
+        mmr_ach_free(&list);
+        free(path);
+        oom = 1;
+        break;
+      }
+      sets = nsets;
+      cap = ncap;
+    }
+    set_t *s = &sets[n++];
+    memset(s, 0, sizeof(*s));
+    s->path = path;
+    memcpy(s->e.hash, hash, sizeof(hash));
+    s->e.length = (uint32_t)len;
+    s->e.achievements = sat16(list.count);
+    s->e.lboards = sat16(list.lboard_count);
+    mmr_ach_free(&list);
+  }
+  closedir(d);
+
+  if (skipped) fprintf(stderr, "[INFO] %zu files in %s not named <hash>.ach; skipped\n", skipped, dir);
+  if (bad) fprintf(stderr, "[WARN] %zu sets skipped\n", bad);
+
+  const char *why = oom ? "out of memory" : n == 0 ? "no sets to pack" : NULL;
+  if (!why) {
+    qsort(sets, n, sizeof(*sets), set_cmp);
+    for (size_t i = 1; i < n && !why; i++) {
+      if (memcmp(sets[i - 1].e.hash, sets[i].e.hash, 16) == 0) {
+        fprintf(stderr, "[ERR] %s and %s are the same game\n", sets[i - 1].path, sets[i].path);
+        why = "duplicate hash";
+      }
+    }
+  }
+  if (why) {
+    fprintf(stderr, "[ERR] %s: %s\n", dir, why);
+    for (size_t i = 0; i < n; i++) free(sets[i].path);
+    free(sets);
+    return NULL;
+  }
+  *count = n;
+  return sets;
+}
+
+static int write_zeros(FILE *f, uint64_t n) {
+  static const uint8_t zeros[4096];
+  while (n) {
+    size_t k = n < sizeof(zeros) ? (size_t)n : sizeof(zeros);
+    if (fwrite(zeros, 1, k, f) != k) return 0;
+    n -= k;
+  }
+  return 1;
+}
+
+static int pack(const char *out, const char *dir, uint32_t align) {
+  size_t count = 0;
+  set_t *sets = scan(dir, &count);
+  if (!sets) return 1;
+  if (count > UINT32_MAX) {
+    fprintf(stderr, "[ERR] too many sets\n");
+    return 1;
+  }
+
+  /* header, index, then the sets in hash order */
+  mmr_achlib_header_t h;
+  memset(&h, 0, sizeof(h));
+  h.magic = MMR_ACHLIB_MAGIC;
+  h.version = MMR_ACHLIB_VERSION;
+  h.header_size = (uint32_t)sizeof(h);
+  h.entry_size = (uint32_t)sizeof(mmr_achlib_entry_t);
+  h.count = (uint32_t)count;
+  h.align = align;
+  h.index_offset = sizeof(h);
+  uint64_t at = h.index_offset + (uint64_t)count * sizeof(mmr_achlib_entry_t);
+  uint64_t text_bytes = 0;
+  for (size_t i = 0; i < count; i++) {
+    at = align_up(at, align);
+    sets[i].e.offset = at;
+    at += sets[i].e.length;
+    text_bytes += sets[i].e.length;
+  }
+  h.file_size = at;
+
+  size_t tlen = strlen(out) + 5;
+  char *tmp = (char*)malloc(tlen);
+  if (!tmp) return 1;
+  snprintf(tmp, tlen, "%s.tmp", out);
+
+  int rc = 1;
+  FILE *f = fopen(tmp, "wb");
+  if (!f) {
+    fprintf(stderr, "[ERR] %s: %s\n", tmp, strerror(errno));
+    goto done;
+  }
+
+  int ok = fwrite(&h, sizeof(h), 1, f) == 1;
+  for (size_t i = 0; ok && i < count; i++) ok = fwrite(&sets[i].e, sizeof(sets[i].e), 1, f) == 1;
+
+  uint64_t pos = h.index_offset + (uint64_t)count * sizeof(mmr_achlib_entry_t);
+  for (size_t i = 0; ok && i < count; i++) {
+    ok = write_zeros(f, sets[i].e.offset - pos);
+    size_t len = 0;
+    char *text = ok ? read_file(sets[i].path, &len) : NULL;
+    if (text && len != sets[i].e.length) {
+      fprintf(stderr, "[ERR] %s changed while packing\n", sets[i].path);
+      ok = 0;
+    }
+    ok = ok && text && fwrite(text, 1, len, f) == len;
+    free(text);
+    pos = sets[i].e.offset + sets[i].e.length;
+  }
+
+  if (fflush(f) != 0 || fsync(fileno(f)) != 0) ok = 0;
+  if (fclose(f) != 0) ok = 0;
+  if (!ok) {
+    fprintf(stderr, "[ERR] could not write %s\n", tmp);
+    unlink(tmp);
+    goto done;
+  }
+  if (rename(tmp, out) != 0) {
+    fprintf(stderr, "[ERR] rename(%s, %s): %s\n", tmp, out, strerror(errno));
+    unlink(tmp);
+    goto done;
+  }
+
+  printf("packed %zu sets into %s: %" PRIu64 " bytes (%" PRIu64 " of set text, align %u)\n",
+         count, out, h.file_size, text_bytes, align);
+  rc = 0;
+
+done:
+  free(tmp);
+  for (size_t i = 0; i < count; i++) free(sets[i].path);
+  free(sets);
+  return rc;
+}
+
+static int list(const char *path) {
+  achlib_t lib;
+  if (!achlib_open(&lib, path)) return 1;
+
+  printf("%s: %u sets, %zu bytes, align %u\n", path, lib.count, lib.map_size, lib.hdr->align);
+  printf("%-32s %12s %10s %6s %6s\n", "hash", "offset", "bytes", "ach", "lb");
+  for (uint32_t i = 0; i < lib.count; i++) {
+    const mmr_achlib_entry_t *e = &lib.index[i];
+    char hex[33];
+    for (int k = 0; k < 16; k++) snprintf(hex + 2 * k, 3, "%02x", e->hash[k]);
+    printf("%s %12" PRIu64 " %10u %6u %6u\n", hex, e->offset, e->length, e->achievements, e->lboards);
+  }
+  achlib_close(&lib);
+  return 0;
+}
+
+static int show(const char *hash, const char *path) {
+  achlib_t lib;
+  if (!achlib_open(&lib, path)) return 1;
+
+  const char *text = NULL;
+  size_t len = 0;
+  int rc = 0;
+  if (achlib_find(&lib, hash, &text, &len)) {
+    fwrite(text, 1, len, stdout);
+  } else {
+    fprintf(stderr, "[ERR] %s: no set for %s\n", path, hash);
+    rc = 1;
+  }
+  achlib_close(&lib);
+  return rc;
+}
+
+int main(int argc, char **argv) {
+  const char *out = NULL;
+  const char *show_hash = NULL;
+  int do_list = 0;
+  uint32_t align = ALIGN_DEFAULT;
+
+  int i = 1;
+  for (; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+    if (strcmp(a, "-h") == 0 || strcmp(a, "--help") == 0) {
+      usage(argv[0]);
+      return 0;
+    }
+    if (strcmp(a, "--list") == 0) { do_list = 1; continue; }
+    if (a[0] != '-') break;
+
+    if (!v) {
+      fprintf(stderr, "ERROR: %s requires a value\n", a);
+      return 2;
+    }
+
+    if (strcmp(a, "-o") == 0) {
+      out = v;
+    } else if (strcmp(a, "--show") == 0) {
+      show_hash = v;
+    } else if (strcmp(a, "--align") == 0) {
+      if (!parse_u32(v, &align) || align == 0 || align > ALIGN_MAX || (align & (align - 1u))) {
+        fprintf(stderr, "ERROR: invalid --align '%s' (a power of two up to %u)\n", v, ALIGN_MAX);
+        return 2;
+      }
+    } else {
+      fprintf(stderr, "ERROR: unknown option %s\n", a);
+      usage(argv[0]);
+      return 2;
+    }
+    i++;
+  }
+
+  if (i + 1 != argc || (!!out + !!show_hash + do_list) != 1) {
+    usage(argv[0]);
+    return 2;
+  }
+  if (do_list) return list(argv[i]);
+  if (show_hash) return show(show_hash, argv[i]);
+  return pack(out, argv[i], align);
+}
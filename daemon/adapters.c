@@ -1,17 +1,47 @@
 #include "adapters.h"
 #include "notify.h"
 
+#include <string.h>
+#include <strings.h>
+
+#include "../third_party/rcheevos/include/rc_consoles.h"
+
+/* 68K work RAM comes out of the core in bus order, big-endian words, while
+ * RetroAchievements addresses it the way emulators store it: each word
+ * byte-swapped (so a plain 16-bit read yields the 68K word). Sixteen bytes
+ * per step as a vector of 16-bit lanes (one NEON / SSE2 rotate). */
+typedef uint16_t swap16_vec_t __attribute__((vector_size(16)));
+
+static void ingest_swap16(uint8_t *p, size_t len) {
+  size_t i = 0;
+  for (; i + sizeof(swap16_vec_t) <= len; i += sizeof(swap16_vec_t)) {
+    swap16_vec_t v;
+    memcpy(&v, p + i, sizeof(v));
+    v = (swap16_vec_t)((v << 8) | (v >> 8));
+    memcpy(p + i, &v, sizeof(v));
+  }
+  for (; i + 1 < len; i += 2) {
+    uint8_t t = p[i];
+    p[i] = p[i + 1];
+    p[i + 1] = t;
+  }
+}
+
 bool adapter_get(uint32_t core_id, adapter_desc_t *out) {
   if (!out) return false;
   switch (core_id) {
     case MMR_CORE_NES:
-      *out = (adapter_desc_t){ .core_id = core_id, .primary_region = MMR_REGION_NES_CPU_RAM, .primary_size = 0x0800 };
+      *out = (adapter_desc_t){ .core_id = core_id, .primary_region = MMR_REGION_NES_CPU_RAM, .primary_size = 0x0800,
+                               .rc_console = RC_CONSOLE_NINTENDO, .rom_exts = ".nes" };
       return true;
     case MMR_CORE_SNES:
-      *out = (adapter_desc_t){ .core_id = core_id, .primary_region = MMR_REGION_SNES_WRAM, .primary_size = 0x20000 };
+      *out = (adapter_desc_t){ .core_id = core_id, .primary_region = MMR_REGION_SNES_WRAM, .primary_size = 0x20000,
+                               .rc_console = RC_CONSOLE_SUPER_NINTENDO, .rom_exts = ".sfc .smc" };
       return true;
     case MMR_CORE_GENESIS:
-      *out = (adapter_desc_t){ .core_id = core_id, .primary_region = MMR_REGION_GEN_68K_RAM, .primary_size = 0x10000 };
+      *out = (adapter_desc_t){ .core_id = core_id, .primary_region = MMR_REGION_GEN_68K_RAM, .primary_size = 0x10000,
+                               .rc_console = RC_CONSOLE_MEGA_DRIVE, .rom_exts = ".md .gen .bin",
+                               .ingest = ingest_swap16 };
       return true;
     default:
       notify(NOTIFY_ERR, "adapter_get: unsupported core_id=%u", core_id);
@@ -19,6 +49,29 @@ bool adapter_get(uint32_t core_id, adapter_desc_t *out) {
   }
 }
 
+static bool has_ext(const char *exts, const char *ext) {
+  size_t n = strlen(ext);
+  for (const char *p = exts; *p; ) {
+    size_t len = strcspn(p, " ");
+    if (len == n && strncasecmp(p, ext, n) == 0) return true;
+    p += len;
+    while (*p == ' ') p++;
+  }
+  return false;
+}
+
+bool adapter_for_rom(const char *path, adapter_desc_t *out) {
+  static const uint32_t cores[] = { MMR_CORE_NES, MMR_CORE_SNES, MMR_CORE_GENESIS };
+  const char *slash = path ? strrchr(path, '/') : NULL;
+  const char *ext = path ? strrchr(slash ? slash : path, '.') : NULL;
+  if (!ext || !out) return false;
+
+  for (size_t i = 0; i < sizeof(cores) / sizeof(cores[0]); i++) {
+    if (adapter_get(cores[i], out) && has_ext(out->rom_exts, ext)) return true;
+  }
+  return false;
+}
+
 bool adapter_translate(uint32_t core_id, uint32_t addr, uint32_t *out_offset) {
   if (!out_offset) return false;
 
@@ -1,16 +1,29 @@
 #pragma once
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "../kernel/mmr_memtap.h"
 
+// Ingest stage: turns len bytes of the primary region, as the core exposes
+// them, into the layout RetroAchievements addresses, in place. Run once on
+// each block as it is copied in (memtap.h), so every peek is a plain load.
+// Blocks start at an even offset within the region.
+typedef void (*adapter_ingest_fn)(uint8_t *p, size_t len);
+
 typedef struct {
   uint32_t core_id;
   uint32_t primary_region;  // the region we bulk-read each frame
   uint32_t primary_size;    // bytes
+  uint32_t rc_console;      // RC_CONSOLE_*, for rc_hash of the core's ROMs
+  const char *rom_exts;     // ROM file extensions, e.g. ".nes" (space separated)
+  adapter_ingest_fn ingest; // NULL when the core's layout already is RA's
 } adapter_desc_t;
 
 bool adapter_get(uint32_t core_id, adapter_desc_t *out);
 
+// The core whose ROM extensions match path's (case-insensitive); false if none.
+bool adapter_for_rom(const char *path, adapter_desc_t *out);
+
 // Translate an achievement runtime address to an offset within the primary region.
 // Returns false if address not supported in MVP mapping.
 bool adapter_translate(uint32_t core_id, uint32_t addr, uint32_t *out_offset);
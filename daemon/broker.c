@@ -0,0 +1,116 @@
+#include "broker.h"
+#include "notify.h"
+#include "util.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// /dev/shm is where shm_open() puts segments on Linux; opening it directly
+// avoids pulling in librt on older glibc.
+#define BROKER_SHM_DIR "/dev/shm"
+
+_Static_assert(sizeof(mmr_broker_header_t) == 64, "broker header layout is ABI");
+_Static_assert(sizeof(mmr_broker_slot_t) == 64, "broker slot layout is ABI");
+
+static mmr_broker_slot_t *slot_at(broker_t *br, uint32_t i) {
+  return (mmr_broker_slot_t*)(br->base + br->hdr->header_size + (size_t)i * br->hdr->slot_stride);
+}
+
+bool broker_open(broker_t *br, const char *name, uint32_t capacity) {
+  memset(br, 0, sizeof(*br));
+  br->fd = -1;
+
+  if (!name || !*name || strchr(name, '/')) {
+    notify(NOTIFY_ERR, "broker: invalid segment name '%s'", name ? name : "");
+    return false;
+  }
+  snprintf(br->path, sizeof(br->path), "%s/%s", BROKER_SHM_DIR, name);
+
+  // cache-line align each slot so a slot's seq never shares a line with the previous frame's tail
+  uint32_t stride = (uint32_t)((sizeof(mmr_broker_slot_t) + capacity + 63u) & ~63u);
+  size_t map_size = sizeof(mmr_broker_header_t) + (size_t)stride * MMR_BROKER_SLOTS;
+
+  // recreate so readers of a stale segment (old layout) are not confused
+  unlink(br->path);
+  br->fd = open(br->path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (br->fd < 0) {
+    notify(NOTIFY_ERR, "broker: open(%s) failed: %s", br->path, strerror(errno));
+    return false;
+  }
+  if (ftruncate(br->fd, (off_t)map_size) != 0) {
+    notify(NOTIFY_ERR, "broker: ftruncate(%s, %zu) failed: %s", br->path, map_size, strerror(errno));
+    broker_close(br);
+    return false;
+  }
+
+  void *p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, br->fd, 0);
+  if (p == MAP_FAILED) {
+    notify(NOTIFY_ERR, "broker: mmap(%s) failed: %s", br->path, strerror(errno));
+    broker_close(br);
+    return false;
+  }
+  br->base = (uint8_t*)p;
+  br->map_size = map_size;
+  br->hdr = (mmr_broker_header_t*)p;
+
+  // ftruncate zero-fills, so every slot starts with an even seq and size 0
+  br->hdr->version = MMR_BROKER_VERSION;
+  br->hdr->header_size = (uint32_t)sizeof(mmr_broker_header_t);
+  br->hdr->slot_count = MMR_BROKER_SLOTS;
+  br->hdr->slot_stride = stride;
+  br->hdr->capacity = capacity;
+  br->hdr->latest_slot = 0;
+  br->hdr->writer_pid = (uint32_t)getpid();
+  // magic last: a reader that sees it sees the rest of the header
+  __atomic_store_n(&br->hdr->magic, MMR_BROKER_MAGIC, __ATOMIC_RELEASE);
+  return true;
+}
+
+void broker_close(broker_t *br) {
+  if (!br) return;
+  if (br->base) munmap(br->base, br->map_size);
+  if (br->fd >= 0) {
+    close(br->fd);
+    unlink(br->path);
+  }
+  br->base = NULL;
+  br->hdr = NULL;
+  br->fd = -1;
+}
+
+void broker_publish(broker_t *br, uint64_t frame, uint32_t core_id, uint32_t region_id,
+                    const uint8_t *data, uint32_t size) {
+  if (!br || !br->hdr || !data) return;
+
+  if (size > br->hdr->capacity) {
+    if (!br->warned_oversize) {
+      notify(NOTIFY_WARN, "broker: frame of %u bytes exceeds capacity %u; not republished",
+             size, br->hdr->capacity);
+      br->warned_oversize = true;
+    }
+    return;
+  }
+
+  uint32_t idx = (br->hdr->latest_slot + 1u) % br->hdr->slot_count;
+  mmr_broker_slot_t *slot = slot_at(br, idx);
+  uint32_t seq = slot->seq;
+
+  __atomic_store_n(&slot->seq, seq + 1u, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  slot->size = size;
+  slot->frame = frame;
+  slot->mono_ns = now_ns();
+  slot->core_id = core_id;
+  slot->region_id = region_id;
+  memcpy((uint8_t*)(slot + 1), data, size);
+
+  __atomic_store_n(&slot->seq, seq + 2u, __ATOMIC_RELEASE);
+  __atomic_store_n(&br->hdr->latest_slot, idx, __ATOMIC_RELEASE);
+  __atomic_store_n(&br->hdr->published, br->hdr->published + 1u, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Snapshot broker: the daemon republishes every frame it acquires into a
+// shared-memory ring (/dev/shm/<name>) so overlays and debug tools can read
+// the same RAM without opening /dev/mmr_memtap or the mock files themselves.
+//
+// Layout (little-endian, fixed offsets; tools/broker_read.py mirrors it):
+//   mmr_broker_header_t            at offset 0
+//   mmr_broker_slot_t[slot_count]  at offset header_size, slot_stride apart
+//   frame bytes                    at slot offset + sizeof(mmr_broker_slot_t)
+//
+// Frame bytes are in the layout RetroAchievements addresses, i.e. after the
+// core's ingest stage (adapters.h), not necessarily the order the core puts
+// them on the bus. For Genesis 68K RAM that means every 16-bit word is
+// byte-swapped: the bus byte at address A is at offset A ^ 1. Version 1
+// segments carried bus order.
+//
+// Each slot is a seqlock: seq is odd while the daemon writes it. Readers take
+// latest_slot from the header, then
+//   s1 = seq (acquire); if odd, retry
+//   copy the bytes they need
+//   s2 = seq (after an acquire fence); if s1 != s2, retry
+// The ring gives a reader slot_count - 1 frames of slack before the slot it
+// is copying gets rewritten.
+
+#define MMR_BROKER_MAGIC        0x4B52424Du  // 'MBRK'
+#define MMR_BROKER_VERSION      2u   // 2: frames in RA layout
+#define MMR_BROKER_SLOTS        4u
+#define MMR_BROKER_DEFAULT_NAME "mmr-frames"
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t header_size;     // offset of slot 0
+  uint32_t slot_count;
+  uint32_t slot_stride;     // bytes from one slot header to the next
+  uint32_t capacity;        // max frame bytes per slot
+  uint32_t latest_slot;     // index of the newest complete slot
+  uint32_t writer_pid;
+  uint64_t published;       // frames published since the broker was created
+  uint8_t reserved[24];
+} mmr_broker_header_t;      // 64 bytes
+
+typedef struct {
+  uint32_t seq;             // odd = being written
+  uint32_t size;            // valid bytes in this slot
+  uint64_t frame;           // daemon frame number
+  uint64_t mono_ns;         // CLOCK_MONOTONIC when the frame was acquired
+  uint32_t core_id;
+  uint32_t region_id;
+  uint8_t reserved[32];
+} mmr_broker_slot_t;        // 64 bytes
+
+typedef struct {
+  int fd;
+  uint8_t *base;
+  size_t map_size;
+  mmr_broker_header_t *hdr;
+  char path[256];
+  bool warned_oversize;
+} broker_t;
+
+// Creates (or recreates) /dev/shm/<name> sized for frames up to capacity bytes.
+bool broker_open(broker_t *br, const char *name, uint32_t capacity);
+
+// Unmaps and unlinks the segment; readers keep their mapping until they close it.
+void broker_close(broker_t *br);
+
+// Copies one acquired frame into the next ring slot under its seqlock.
+// Frames larger than the configured capacity are dropped (warned once).
+void broker_publish(broker_t *br, uint64_t frame, uint32_t core_id, uint32_t region_id,
+                    const uint8_t *data, uint32_t size);
@@ -6,13 +6,38 @@
 #include <string.h>
 
 #include "ach_load.h"
+#include "journal.h"
+#include "memrefs.h"
+#include "profile.h"
+#include "setarena.h"
+#include "util.h"
 #include "../third_party/rcheevos/include/rc_runtime.h"
+#include "../third_party/rcheevos/include/rc_runtime_types.h"
+
+#define ENGINE_EVENT_RING 64u  /* minimum queue size; power of two */
+#define ENGINE_RP_MAX     256u
+
+typedef enum {
+  TITLE_ACHIEVEMENT = 0,
+  TITLE_LBOARD      = 1,
+} title_kind_t;
+
+typedef struct {
+  title_kind_t kind;
+  uint32_t id;
+  int format;     /* RC_FORMAT_* (leaderboards) */
+  char *title;
+  const rc_trigger_t *trigger;   /* achievements, once loaded (index_loaded) */
+} engine_title_t;
 
 /* ----- rcheevos callbacks ----- */
 
 typedef struct {
-  const uint8_t *mem;
+  engine_t *eng;
+  const uint8_t *mem;       /* full copy, or NULL when paging through fetch */
   size_t mem_len;
+  engine_fetch_fn fetch;
+  void *fetch_ud;
 } ra_ctx_t;
 
 static uint32_t read_le_safe(const uint8_t *p, size_t avail, uint32_t n) {
@@ -25,37 +50,516 @@ static uint32_t read_le_safe(const uint8_t *p, size_t avail, uint32_t n) {
 
 static uint32_t RC_CCONV ra_peek(uint32_t address, uint32_t num_bytes, void *ud) {
   const ra_ctx_t *ctx = (const ra_ctx_t*)ud;
-  if (!ctx || !ctx->mem) return 0;
+  if (!ctx || (!ctx->mem && !ctx->fetch)) return 0;
 
   /* bounds check to prevent segfaults if an achievement reads beyond snapshot */
   if ((size_t)address >= ctx->mem_len) return 0;
   size_t avail = ctx->mem_len - (size_t)address;
 
-  return read_le_safe(ctx->mem + address, avail, num_bytes);
-}
+  if (ctx->mem) return read_le_safe(ctx->mem + address, avail, num_bytes);
 
-static void RC_CCONV ra_event_handler(const rc_runtime_event_t *ev) {
-  if (!ev) return;
-
-  if (ev->type == RC_RUNTIME_EVENT_ACHIEVEMENT_TRIGGERED) {
-    /* In a real build we'd map id->title. For now just print. */
-    printf("[ACH] id=%u triggered\n", ev->id);
-    fflush(stdout);
-  }
+  const uint8_t *p = ctx->fetch(ctx->fetch_ud, address, num_bytes);
+  return p ? read_le_safe(p, avail, num_bytes) : 0;
 }
 
 /* ----- engine implementation ----- */
 
+#define FF_COND_HIT_SUM  0x01u   /* condset has AddHits/SubHits: targets met through the sum */
+#define FF_COND_MEASURED 0x02u   /* Measured: its hits are a reported value */
+
+/* Fast-forward over unchanged frames. Once memory has been identical for two
+ * frames, every memref (and its delta/prior) is at a fixed point, so a frame
+ * evaluated then is what every following identical frame would be: the same
+ * conditions true, the same hit counts advancing by one. That frame is the
+ * calibration; later identical frames only count up, and the counted hits are
+ * applied in one pass before the next real evaluation. The horizon ends the
+ * skipping one frame before any advancing condition would reach its hit
+ * target, so the frame where logic changes is always evaluated for real. */
+typedef struct {
+  bool enabled;
+
+  rc_condition_t **conds;   /* every condition the runtime and rich presence evaluate */
+  uint8_t *cflags;          /* FF_COND_* */
+  uint32_t *hits0;          /* current_hits before the calibration frame */
+  uint32_t *inc;            /* indices into conds that gain a hit per frame */
+  uint32_t cond_count;
+  uint32_t inc_count;
+
+  /* state that must not move during the calibration frame */
+  uint8_t **w8;
+  uint8_t *w8_0;
+  uint32_t w8_count;
+  uint32_t **w32;
+  uint32_t *w32_0;
+  uint32_t w32_count;
+
+  uint32_t run;             /* consecutive unchanged frames */
+  bool unchanged;           /* the frame about to be evaluated is one of them */
+  bool valid;               /* the last calibration found a steady state */
+  uint32_t shed;            /* shed flags the calibration ran under */
+  uint32_t horizon;         /* frames that may still be skipped */
+  uint32_t pending;         /* skipped frames whose hits are not applied yet */
+  uint32_t events;          /* runtime events raised this frame */
+
+  uint64_t skipped;
+  uint64_t calibrations;
+} ff_state_t;
+
 struct engine_s {
   engine_backend_t backend;
   uint32_t core_id;
 
   rc_runtime_t runtime;
+  bool use_arena;                 /* --set-arena: file sets load via set_arena_build */
+  set_arena_t arena;              /* base != NULL: the runtime's storage lives here */
+  memref_table_t memrefs;         /* runtime memrefs by address (see memrefs.h) */
+  memref_table_t rp_memrefs;      /* the rich presence script's, likewise */
+  memref_chain_cache_t chains;    /* pointer reads, shared by both tables */
 
   bool builtins_loaded;
   bool file_loaded;
+
+  journal_t *journal;             /* optional; every runtime event is appended */
+
+  uint32_t shed;                  /* ENGINE_SHED_* */
+  uint64_t shed_progress_events;
+
+  /* id -> title for event reporting, hashed by (kind, id) */
+  engine_title_t *titles;
+  size_t title_count;
+  size_t title_cap;
+  uint32_t *title_slots;          /* title index + 1; 0 = empty */
+  size_t title_slot_count;        /* 2 * title_cap */
+
+  uint32_t set_id;                /* bumped by every load (progress table) */
+
+  /* events queued by the runtime callback, drained by engine_next_event;
+   * sized by index_loaded to hold a whole frame of the loaded set */
+  engine_event_t *events;
+  uint32_t ev_cap;                /* power of two */
+  uint32_t ev_head;
+  uint32_t ev_tail;
+  uint64_t ev_dropped;
+
+  /* Rich presence is parsed with its own memrefs (not through the runtime) so
+   * that after each update we can tell whether anything it reads changed. */
+  void *rp_buffer;
+  rc_richpresence_t *rp;
+  char rp_text[ENGINE_RP_MAX];
+  bool rp_valid;            /* rp_text reflects the current inputs */
+  bool rp_inputs_prev;      /* inputs changed last frame (deltas lag one frame) */
+  uint32_t rp_hit_states;   /* trigger states of displays with hit targets */
+  bool rp_reported;         /* rp_text has been returned since it last changed */
+
+  ff_state_t ff;
+  prof_state_t prof;              /* --profile-triggers */
+
+  /* wall time of the last evaluated frame, by stage */
+  uint64_t memrefs_ns;
+  uint64_t eval_ns;
 };
 
+/* rc_runtime_event_handler_t has no user pointer; do_frame sets this. */
+static engine_t *g_frame_eng = NULL;
+
+static uint32_t title_hash(title_kind_t kind, uint32_t id) {
+  return (id * 0x9E3779B1u) ^ ((uint32_t)kind << 31);
+}
+
+static void title_index_insert(engine_t *eng, size_t i) {
+  size_t mask = eng->title_slot_count - 1u;
+  size_t slot = title_hash(eng->titles[i].kind, eng->titles[i].id) & mask;
+  while (eng->title_slots[slot]) slot = (slot + 1u) & mask;
+  eng->title_slots[slot] = (uint32_t)(i + 1u);
+}
+
+static const engine_title_t *title_lookup(const engine_t *eng, title_kind_t kind, uint32_t id) {
+  if (!eng->title_slots) {
+    /* the index could not be allocated */
+    for (size_t i = 0; i < eng->title_count; i++) {
+      if (eng->titles[i].kind == kind && eng->titles[i].id == id) return &eng->titles[i];
+    }
+    return NULL;
+  }
+
+  size_t mask = eng->title_slot_count - 1u;
+  for (size_t slot = title_hash(kind, id) & mask; eng->title_slots[slot]; slot = (slot + 1u) & mask) {
+    const engine_title_t *t = &eng->titles[eng->title_slots[slot] - 1u];
+    if (t->kind == kind && t->id == id) return t;
+  }
+  return NULL;
+}
+
+static bool title_add(engine_t *eng, title_kind_t kind, uint32_t id, const char *title, int format) {
+  if (eng->title_count == eng->title_cap) {
+    size_t ncap = eng->title_cap ? eng->title_cap * 2 : 16;
+    engine_title_t *n = (engine_title_t*)realloc(eng->titles, ncap * sizeof(*n));
+    if (!n) return false;
+    eng->titles = n;
+    eng->title_cap = ncap;
+
+    /* open addressing at most half full; rehash into twice the capacity */
+    free(eng->title_slots);
+    eng->title_slot_count = ncap * 2u;
+    eng->title_slots = (uint32_t*)calloc(eng->title_slot_count, sizeof(*eng->title_slots));
+    if (eng->title_slots) {
+      for (size_t i = 0; i < eng->title_count; i++) title_index_insert(eng, i);
+    }
+  }
+  char *copy = strdup(title ? title : "");
+  if (!copy) return false;
+  eng->titles[eng->title_count].kind = kind;
+  eng->titles[eng->title_count].id = id;
+  eng->titles[eng->title_count].format = format;
+  eng->titles[eng->title_count].title = copy;
+  eng->titles[eng->title_count].trigger = NULL;
+  if (eng->title_slots) title_index_insert(eng, eng->title_count);
+  eng->title_count++;
+  return true;
+}
+
+static void titles_clear(engine_t *eng) {
+  for (size_t i = 0; i < eng->title_count; i++) free(eng->titles[i].title);
+  eng->title_count = 0;
+  if (eng->title_slots) memset(eng->title_slots, 0, eng->title_slot_count * sizeof(*eng->title_slots));
+}
+
+static void rp_clear(engine_t *eng) {
+  memref_table_free(&eng->rp_memrefs);
+  free(eng->rp_buffer);
+  eng->rp_buffer = NULL;
+  eng->rp = NULL;
+  eng->rp_text[0] = 0;
+  eng->rp_valid = false;
+  eng->rp_reported = false;
+}
+
+/* Grows the event queue to at least cap entries, keeping what is queued. */
+static bool events_reserve(engine_t *eng, uint32_t cap) {
+  uint32_t ncap = eng->ev_cap ? eng->ev_cap : ENGINE_EVENT_RING;
+  while (ncap < cap) ncap *= 2u;
+  if (ncap == eng->ev_cap) return true;
+
+  engine_event_t *n = (engine_event_t*)malloc(ncap * sizeof(*n));
+  if (!n) return false;
+  uint32_t queued = eng->ev_head - eng->ev_tail;
+  for (uint32_t i = 0; i < queued; i++) n[i] = eng->events[(eng->ev_tail + i) & (eng->ev_cap - 1u)];
+  free(eng->events);
+  eng->events = n;
+  eng->ev_cap = ncap;
+  eng->ev_tail = 0;
+  eng->ev_head = queued;
+  return true;
+}
+
+/* The queue holds a frame's worth of events for the loaded set, so it only
+ * fills when the caller stops draining it. Unlocks and submissions are never
+ * dropped then (the queue grows); progress and leaderboard start/cancel
+ * events are, and counted. */
+static void queue_event(engine_t *eng, engine_event_type_t type, uint32_t id, int32_t value) {
+  if (eng->ev_head - eng->ev_tail >= eng->ev_cap) {
+    bool must_keep = (type == ENGINE_EVENT_ACHIEVEMENT_TRIGGERED || type == ENGINE_EVENT_LBOARD_SUBMITTED);
+    if (!must_keep || !events_reserve(eng, eng->ev_cap * 2u)) {
+      eng->ev_dropped++;
+      return;
+    }
+  }
+  engine_event_t *ev = &eng->events[eng->ev_head & (eng->ev_cap - 1u)];
+  memset(ev, 0, sizeof(*ev));
+  ev->type = type;
+  ev->id = id;
+  ev->value = value;
+  eng->ev_head++;
+}
+
+static mmr_journal_event_t journal_type(uint8_t rc_type) {
+  switch (rc_type) {
+    case RC_RUNTIME_EVENT_ACHIEVEMENT_TRIGGERED:        return MMR_JEV_ACH_TRIGGERED;
+    case RC_RUNTIME_EVENT_ACHIEVEMENT_RESET:            return MMR_JEV_ACH_RESET;
+    case RC_RUNTIME_EVENT_ACHIEVEMENT_PAUSED:           return MMR_JEV_ACH_PAUSED;
+    case RC_RUNTIME_EVENT_ACHIEVEMENT_ACTIVATED:        return MMR_JEV_ACH_ACTIVATED;
+    case RC_RUNTIME_EVENT_ACHIEVEMENT_PRIMED:           return MMR_JEV_ACH_PRIMED;
+    case RC_RUNTIME_EVENT_ACHIEVEMENT_UNPRIMED:         return MMR_JEV_ACH_UNPRIMED;
+    case RC_RUNTIME_EVENT_ACHIEVEMENT_DISABLED:         return MMR_JEV_ACH_DISABLED;
+    case RC_RUNTIME_EVENT_ACHIEVEMENT_PROGRESS_UPDATED: return MMR_JEV_ACH_PROGRESS;
+    case RC_RUNTIME_EVENT_LBOARD_STARTED:               return MMR_JEV_LB_STARTED;
+    case RC_RUNTIME_EVENT_LBOARD_CANCELED:              return MMR_JEV_LB_CANCELED;
+    case RC_RUNTIME_EVENT_LBOARD_UPDATED:               return MMR_JEV_LB_UPDATED;
+    case RC_RUNTIME_EVENT_LBOARD_TRIGGERED:             return MMR_JEV_LB_SUBMITTED;
+    case RC_RUNTIME_EVENT_LBOARD_DISABLED:              return MMR_JEV_LB_DISABLED;
+    default:                                            return (mmr_journal_event_t)0;
+  }
+}
+
+static void RC_CCONV ra_event_handler(const rc_runtime_event_t *ev) {
+  engine_t *eng = g_frame_eng;
+  if (!ev || !eng) return;
+
+  eng->ff.events++;
+
+  /* journaled even when the queue sheds it: a record is a few stores */
+  if (eng->journal) {
+    mmr_journal_event_t jt = journal_type(ev->type);
+    if (jt) journal_record(eng->journal, jt, ev->id, ev->value);
+  }
+
+  switch (ev->type) {
+    case RC_RUNTIME_EVENT_ACHIEVEMENT_TRIGGERED:
+      queue_event(eng, ENGINE_EVENT_ACHIEVEMENT_TRIGGERED, ev->id, 0);
+      break;
+    case RC_RUNTIME_EVENT_LBOARD_STARTED:
+      queue_event(eng, ENGINE_EVENT_LBOARD_STARTED, ev->id, ev->value);
+      break;
+    case RC_RUNTIME_EVENT_LBOARD_CANCELED:
+      queue_event(eng, ENGINE_EVENT_LBOARD_CANCELED, ev->id, ev->value);
+      break;
+    case RC_RUNTIME_EVENT_LBOARD_TRIGGERED:
+      queue_event(eng, ENGINE_EVENT_LBOARD_SUBMITTED, ev->id, ev->value);
+      break;
+    case RC_RUNTIME_EVENT_ACHIEVEMENT_PROGRESS_UPDATED:
+      if (eng->shed & ENGINE_SHED_PROGRESS) eng->shed_progress_events++;
+      else queue_event(eng, ENGINE_EVENT_ACHIEVEMENT_PROGRESS, ev->id, ev->value);
+      break;
+    default:
+      break;
+  }
+}
+
+/* ----- fast-forward ----- */
+
+typedef struct {
+  ff_state_t *ff;
+  bool fill;                /* false: count only */
+} ff_walk_t;
+
+static void ff_watch8(ff_walk_t *w, uint8_t *p) {
+  if (w->fill) w->ff->w8[w->ff->w8_count] = p;
+  w->ff->w8_count++;
+}
+
+static void ff_watch32(ff_walk_t *w, uint32_t *p) {
+  if (w->fill) w->ff->w32[w->ff->w32_count] = p;
+  w->ff->w32_count++;
+}
+
+static void ff_walk_condset(ff_walk_t *w, rc_condset_t *cs) {
+  uint8_t sum = 0;
+  for (const rc_condition_t *c = cs->conditions; c; c = c->next) {
+    if (c->type == RC_CONDITION_ADD_HITS || c->type == RC_CONDITION_SUB_HITS) sum = FF_COND_HIT_SUM;
+  }
+
+  ff_watch8(w, &cs->is_paused);
+  for (rc_condition_t *c = cs->conditions; c; c = c->next) {
+    if (w->fill) {
+      w->ff->conds[w->ff->cond_count] = c;
+      w->ff->cflags[w->ff->cond_count] = (uint8_t)(sum | (c->type == RC_CONDITION_MEASURED ? FF_COND_MEASURED : 0u));
+    }
+    w->ff->cond_count++;
+  }
+}
+
+static void ff_walk_trigger(ff_walk_t *w, rc_trigger_t *t) {
+  ff_watch8(w, &t->state);
+  ff_watch8(w, &t->has_hits);
+  ff_watch32(w, &t->measured_value);
+  if (t->requirement) ff_walk_condset(w, t->requirement);
+  for (rc_condset_t *cs = t->alternative; cs; cs = cs->next) ff_walk_condset(w, cs);
+}
+
+static void ff_walk_value(ff_walk_t *w, rc_value_t *v) {
+  ff_watch32(w, &v->value.value);
+  for (rc_condset_t *cs = v->conditions; cs; cs = cs->next) ff_walk_condset(w, cs);
+}
+
+static void ff_walk(engine_t *eng, ff_walk_t *w) {
+  w->ff->cond_count = 0;
+  w->ff->w8_count = 0;
+  w->ff->w32_count = 0;
+
+  for (uint32_t i = 0; i < eng->runtime.trigger_count; i++) {
+    rc_trigger_t *t = eng->runtime.triggers[i].trigger;
+    if (t) ff_walk_trigger(w, t);
+  }
+  for (uint32_t i = 0; i < eng->runtime.lboard_count; i++) {
+    rc_lboard_t *lb = eng->runtime.lboards[i].lboard;
+    if (!lb) continue;
+    ff_watch8(w, &lb->state);
+    ff_watch32(w, (uint32_t*)&eng->runtime.lboards[i].value);
+    ff_walk_trigger(w, &lb->start);
+    ff_walk_trigger(w, &lb->submit);
+    ff_walk_trigger(w, &lb->cancel);
+    ff_walk_value(w, &lb->value);
+    if (lb->progress && lb->progress != &lb->value) ff_walk_value(w, lb->progress);
+  }
+  if (eng->rp) {
+    for (rc_richpresence_display_t *d = eng->rp->first_display; d; d = d->next) ff_walk_trigger(w, &d->trigger);
+    for (rc_value_t *v = eng->rp->values; v; v = v->next) ff_walk_value(w, v);
+  }
+}
+
+static void ff_free(ff_state_t *ff) {
+  free(ff->conds);
+  free(ff->cflags);
+  free(ff->hits0);
+  free(ff->inc);
+  free(ff->w8);
+  free(ff->w8_0);
+  free(ff->w32);
+  free(ff->w32_0);
+  memset(ff, 0, sizeof(*ff));
+}
+
+/* (Re)build the index after a load; the runtime's objects may have moved. */
+static bool ff_index(engine_t *eng) {
+  ff_state_t *ff = &eng->ff;
+  uint64_t skipped = ff->skipped, calibrations = ff->calibrations;
+  ff_free(ff);
+  ff->skipped = skipped;
+  ff->calibrations = calibrations;
+
+  ff_walk_t w = { ff, false };
+  ff_walk(eng, &w);
+  uint32_t conds = ff->cond_count, w8 = ff->w8_count, w32 = ff->w32_count;
+
+  ff->conds = (rc_condition_t**)calloc(conds + 1u, sizeof(*ff->conds));
+  ff->cflags = (uint8_t*)calloc(conds + 1u, sizeof(*ff->cflags));
+  ff->hits0 = (uint32_t*)calloc(conds + 1u, sizeof(*ff->hits0));
+  ff->inc = (uint32_t*)calloc(conds + 1u, sizeof(*ff->inc));
+  ff->w8 = (uint8_t**)calloc(w8 + 1u, sizeof(*ff->w8));
+  ff->w8_0 = (uint8_t*)calloc(w8 + 1u, sizeof(*ff->w8_0));
+  ff->w32 = (uint32_t**)calloc(w32 + 1u, sizeof(*ff->w32));
+  ff->w32_0 = (uint32_t*)calloc(w32 + 1u, sizeof(*ff->w32_0));
+  if (!ff->conds || !ff->cflags || !ff->hits0 || !ff->inc ||
+      !ff->w8 || !ff->w8_0 || !ff->w32 || !ff->w32_0) {
+    ff_free(ff);
+    return false;
+  }
+
+  w.fill = true;
+  ff_walk(eng, &w);
+  ff->enabled = true;
+  return true;
+}
+
+static void ff_invalidate(ff_state_t *ff) {
+  ff->run = 0;
+  ff->unchanged = false;
+  ff->valid = false;
+  ff->pending = 0;
+  ff->horizon = 0;
+}
+
+/* Apply the hits of the frames skipped since the calibration. */
+static void ff_flush(ff_state_t *ff) {
+  if (!ff->pending) return;
+  for (uint32_t i = 0; i < ff->inc_count; i++) ff->conds[ff->inc[i]]->current_hits += ff->pending;
+  ff->pending = 0;
+}
+
+static void ff_capture(ff_state_t *ff) {
+  for (uint32_t i = 0; i < ff->cond_count; i++) ff->hits0[i] = ff->conds[i]->current_hits;
+  for (uint32_t i = 0; i < ff->w8_count; i++) ff->w8_0[i] = *ff->w8[i];
+  for (uint32_t i = 0; i < ff->w32_count; i++) ff->w32_0[i] = *ff->w32[i];
+  ff->events = 0;
+}
+
+/* After the calibration frame: steady if nothing but hit counts moved, each
+ * by at most one, and none of the moving ones feeds a sum or a reported
+ * value. */
+static void ff_calibrate(ff_state_t *ff, uint32_t shed) {
+  ff->calibrations++;
+  ff->valid = false;
+  ff->inc_count = 0;
+  if (ff->events) return;
+  for (uint32_t i = 0; i < ff->w8_count; i++) {
+    if (*ff->w8[i] != ff->w8_0[i]) return;
+  }
+  for (uint32_t i = 0; i < ff->w32_count; i++) {
+    if (*ff->w32[i] != ff->w32_0[i]) return;
+  }
+
+  uint32_t horizon = UINT32_MAX;
+  for (uint32_t i = 0; i < ff->cond_count; i++) {
+    const rc_condition_t *c = ff->conds[i];
+    if (c->current_hits == ff->hits0[i]) continue;
+    if (c->current_hits != ff->hits0[i] + 1u || ff->cflags[i]) return;
+    if (c->required_hits) {
+      uint32_t left = c->current_hits < c->required_hits ? c->required_hits - c->current_hits : 0;
+      if (left == 0) return;
+      if (left - 1u < horizon) horizon = left - 1u;
+    }
+    ff->inc[ff->inc_count++] = i;
+  }
+
+  ff->horizon = horizon;
+  ff->shed = shed;
+  ff->valid = true;
+}
+
+/* ----- rich presence change tracking ----- */
+
+/* One bit per display with hit targets: those can flip with no memref change. */
+static uint32_t rp_hit_states(const rc_richpresence_t *rp) {
+  uint32_t bits = 0, bit = 1;
+  for (const rc_richpresence_display_t *d = rp->first_display; d && bit; d = d->next) {
+    if (!d->has_required_hits) continue;
+    if (d->trigger.state == RC_TRIGGER_STATE_TRIGGERED) bits |= bit;
+    bit <<= 1;
+  }
+  return bits;
+}
+
+static bool rp_inputs_changed(engine_t *eng) {
+  bool changed = memref_table_changed(&eng->rp_memrefs);
+  for (const rc_value_t *v = eng->rp->values; v && !changed; v = v->next) {
+    if (v->value.changed) changed = true;
+  }
+
+  uint32_t hits = rp_hit_states(eng->rp);
+  if (hits != eng->rp_hit_states) changed = true;
+  eng->rp_hit_states = hits;
+
+  /* a delta operand still differs from its value the frame after a change */
+  bool lagging = eng->rp_inputs_prev;
+  eng->rp_inputs_prev = changed;
+  return changed || lagging;
+}
+
+/* eng->rp was just parsed (or failed to); false if it has nothing to show */
+static bool rp_start(engine_t *eng) {
+  if (!eng->rp || !eng->rp->first_display) return false;
+  rc_reset_richpresence(eng->rp);
+  eng->rp_inputs_prev = false;
+  eng->rp_hit_states = 0;
+  return true;
+}
+
+static bool load_richpresence(engine_t *eng, const char *script) {
+  rp_clear(eng);
+
+  int size = rc_richpresence_size(script);
+  if (size < 0) {
+    fprintf(stderr, "[WARN] rich presence script rejected (%s)\n", rc_error_str(size));
+    return false;
+  }
+
+  eng->rp_buffer = malloc((size_t)size);
+  if (!eng->rp_buffer) return false;
+
+  eng->rp = rc_parse_richpresence(eng->rp_buffer, script, NULL, 0);
+  if (!rp_start(eng)) {
+    rp_clear(eng);
+    return false;
+  }
+  return true;
+}
+
+/* the loaded set's runtime storage: one free for an arena set */
+static void runtime_free(engine_t *eng) {
+  if (eng->arena.base) set_arena_free(&eng->arena, &eng->runtime);
+  else rc_runtime_destroy(&eng->runtime);
+}
+
 bool engine_init(engine_t **out, engine_backend_t backend, uint32_t core_id) {
   if (!out) return false;
 
@@ -77,55 +581,288 @@ void engine_destroy(engine_t *eng) {
   if (!eng) return;
 
   if (eng->backend == ENGINE_BACKEND_RA) {
-    rc_runtime_destroy(&eng->runtime);
+    runtime_free(eng);
   }
 
+  rp_clear(eng);
+  titles_clear(eng);
+  free(eng->titles);
+  free(eng->title_slots);
+  free(eng->events);
+  ff_free(&eng->ff);
+  prof_free(&eng->prof);
+  memref_table_free(&eng->memrefs);
+  memref_chain_cache_free(&eng->chains);
+
   free(eng);
 }
 
-bool engine_load_ach_file(engine_t *eng, const char *path) {
-  if (!eng) return false;
-  if (eng->backend != ENGINE_BACKEND_RA) return true; /* nothing to do */
-  if (!path || !*path) return false;
+static void RC_CCONV ra_update_memrefs(rc_runtime_t *rt, rc_runtime_peek_t peek, void *ud);
 
-  mmr_ach_list_t list;
-  if (!mmr_ach_load_file(path, &list)) {
-    fprintf(stderr, "[WARN] could not load ach file: %s (fallback to builtins)\n", path);
-    return false;
+/* After a load: the memref tables, (with --fast-forward) the condition index
+ * and (with --profile-triggers) the profile entries point into the runtime's
+ * and the rich presence script's objects. */
+static bool index_loaded(engine_t *eng) {
+  static uint32_t next_set_id = 0;
+  eng->set_id = ++next_set_id;
+
+  for (uint32_t i = 0; i < eng->runtime.trigger_count; i++) {
+    engine_title_t *t = (engine_title_t*)title_lookup(eng, TITLE_ACHIEVEMENT, eng->runtime.triggers[i].id);
+    if (t) t->trigger = eng->runtime.triggers[i].trigger;
   }
 
-  if (list.count == 0) {
-    fprintf(stderr, "[WARN] ach file loaded but empty: %s (fallback to builtins)\n", path);
-    mmr_ach_free(&list);
+  struct rc_memrefs_t *rp_memrefs = memref_richpresence_pool(eng->rp);
+  if (!memref_table_build(&eng->memrefs, eng->runtime.memrefs) ||
+      !memref_table_build(&eng->rp_memrefs, rp_memrefs)) {
+    fprintf(stderr, "[ERR] out of memory indexing memrefs\n");
     return false;
   }
+  uint32_t reads = memref_chain_count(eng->runtime.memrefs) + memref_chain_count(rp_memrefs);
+  if (reads && !memref_chain_cache_alloc(&eng->chains, reads)) {
+    /* still correct without it, every pointer is just resolved per use */
+    fprintf(stderr, "[WARN] out of memory for the pointer cache; running without it\n");
+  }
+  /* a frame raises at most a progress update and an unlock per achievement
+   * and one queued event per leaderboard */
+  if (!events_reserve(eng, 2u * eng->runtime.trigger_count + eng->runtime.lboard_count + 1u)) {
+    fprintf(stderr, "[ERR] out of memory for the event queue\n");
+    return false;
+  }
+  eng->runtime.update_memrefs = ra_update_memrefs;
+  if (eng->ff.enabled && !ff_index(eng)) return false;
+  if (eng->prof.enabled && !prof_index(&eng->prof, &eng->runtime, eng->rp)) {
+    fprintf(stderr, "[WARN] out of memory for the trigger profile; profiling off\n");
+  }
+  return true;
+}
 
-  /* replace whatever is active in the runtime with the file set */
-  rc_runtime_reset(&eng->runtime);
+static void file_entry_loaded(engine_t *eng, title_kind_t kind, const mmr_ach_def_t *d) {
+  if (kind == TITLE_ACHIEVEMENT) {
+    title_add(eng, kind, d->id, d->title, RC_FORMAT_VALUE);
+    fprintf(stderr, "[INFO] loaded file achievement %u: %s\n", d->id, d->title);
+  } else {
+    title_add(eng, kind, d->id, d->title, d->format ? rc_parse_format(d->format) : RC_FORMAT_VALUE);
+    fprintf(stderr, "[INFO] loaded file leaderboard %u: %s\n", d->id, d->title);
+  }
+}
+
+static const char *kind_name(title_kind_t kind) {
+  return kind == TITLE_ACHIEVEMENT ? "achievement" : "leaderboard";
+}
+
+static void file_entry_failed(title_kind_t kind, uint32_t id, int rc) {
+  fprintf(stderr, "[WARN] failed to activate %s %u from file (%s)\n", kind_name(kind), id, rc_error_str(rc));
+}
 
+/* One activation per definition, each trigger in its own heap block. */
+static size_t load_heap(engine_t *eng, const mmr_ach_list_t *list) {
   size_t ok_count = 0;
-  for (size_t j = 0; j < list.count; j++) {
-    mmr_ach_def_t *a = &list.items[j];
+  for (size_t j = 0; j < list->count; j++) {
+    const mmr_ach_def_t *a = &list->items[j];
     int rc = rc_runtime_activate_achievement(&eng->runtime, a->id, a->memaddr, NULL, 0);
     if (rc == RC_OK) {
       ok_count++;
-      fprintf(stderr, "[INFO] loaded file achievement %u: %s\n", a->id, a->title);
+      file_entry_loaded(eng, TITLE_ACHIEVEMENT, a);
+    } else {
+      file_entry_failed(TITLE_ACHIEVEMENT, a->id, rc);
+    }
+  }
+
+  for (size_t j = 0; j < list->lboard_count; j++) {
+    const mmr_ach_def_t *lb = &list->lboards[j];
+    int rc = rc_runtime_activate_lboard(&eng->runtime, lb->id, lb->memaddr, NULL, 0);
+    if (rc == RC_OK) {
+      ok_count++;
+      file_entry_loaded(eng, TITLE_LBOARD, lb);
+    } else {
+      file_entry_failed(TITLE_LBOARD, lb->id, rc);
+    }
+  }
+
+  if (list->richpresence) {
+    if (load_richpresence(eng, list->richpresence)) {
+      ok_count++;
+      fprintf(stderr, "[INFO] loaded file rich presence script\n");
     } else {
-      fprintf(stderr, "[WARN] failed to activate achievement %u from file (%s)\n",
-              a->id, rc_error_str(rc));
+      fprintf(stderr, "[WARN] failed to load rich presence from file\n");
     }
   }
+  return ok_count;
+}
+
+#define ENTRY_SUPERSEDED 1   /* load_arena: a later definition has the same id */
+
+static int u64_cmp(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return x < y ? -1 : (x != y);
+}
+
+/* Re-activating an id replaces its trigger in the runtime; in an arena set
+ * only the last definition of each id is built. */
+static bool mark_superseded(const mmr_ach_def_t *defs, size_t count, int *rcs) {
+  if (count < 2) return true;
+  uint64_t *keys = (uint64_t*)malloc(count * sizeof(*keys));
+  if (!keys) return false;
+  for (size_t j = 0; j < count; j++) keys[j] = ((uint64_t)defs[j].id << 32) | (uint32_t)j;
+  qsort(keys, count, sizeof(*keys), u64_cmp);
+  for (size_t j = 0; j + 1 < count; j++) {
+    if ((keys[j] >> 32) == (keys[j + 1] >> 32)) rcs[(uint32_t)keys[j]] = ENTRY_SUPERSEDED;
+  }
+  free(keys);
+  return true;
+}
+
+/* --set-arena: check each definition on its own, then build the ones that
+ * parse into one allocation (setarena.h). Reports like load_heap; -1 when
+ * the arena could not be built, before anything is reported or replaced. */
+static int load_arena(engine_t *eng, const mmr_ach_list_t *list) {
+  size_t total = list->count + list->lboard_count;
+  int *rcs = (int*)calloc(total ? total : 1u, sizeof(*rcs));
+  set_arena_def_t *defs = (set_arena_def_t*)malloc((total ? total : 1u) * sizeof(*defs));
+  if (!rcs || !defs ||
+      !mark_superseded(list->items, list->count, rcs) ||
+      !mark_superseded(list->lboards, list->lboard_count, rcs + list->count)) {
+    free(rcs);
+    free(defs);
+    return -1;
+  }
+
+  uint32_t ach_count = 0, lboard_count = 0;
+  for (size_t j = 0; j < total; j++) {
+    bool is_ach = j < list->count;
+    const mmr_ach_def_t *d = is_ach ? &list->items[j] : &list->lboards[j - list->count];
+    if (rcs[j] == ENTRY_SUPERSEDED) continue;
+    if (!d->memaddr) {
+      rcs[j] = RC_INVALID_MEMORY_OPERAND;
+      continue;
+    }
+    int size = is_ach ? rc_trigger_size(d->memaddr) : rc_lboard_size(d->memaddr);
+    if (size < 0) {
+      rcs[j] = size;
+      continue;
+    }
+    defs[ach_count + lboard_count].id = d->id;
+    defs[ach_count + lboard_count].memaddr = d->memaddr;
+    if (is_ach) ach_count++;
+    else lboard_count++;
+  }
+
+  const char *script = list->richpresence;
+  int rp_size = script ? rc_richpresence_size(script) : 0;
+  if (rp_size < 0) script = NULL;
+
+  rc_runtime_t rt;
+  rc_richpresence_t *rp = NULL;
+  set_arena_t arena;
+  bool built = set_arena_build(&arena, &rt, defs, ach_count, defs + ach_count, lboard_count, script, &rp);
+  free(defs);
+  if (!built) {
+    free(rcs);
+    return -1;
+  }
+
+  runtime_free(eng);
+  eng->runtime = rt;
+  eng->arena = arena;
+
+  int ok_count = 0;
+  for (size_t j = 0; j < total; j++) {
+    bool is_ach = j < list->count;
+    title_kind_t kind = is_ach ? TITLE_ACHIEVEMENT : TITLE_LBOARD;
+    const mmr_ach_def_t *d = is_ach ? &list->items[j] : &list->lboards[j - list->count];
+    if (rcs[j] == RC_OK) {
+      ok_count++;
+      file_entry_loaded(eng, kind, d);
+    } else if (rcs[j] == ENTRY_SUPERSEDED) {
+      fprintf(stderr, "[WARN] %s %u is defined again later in the file; using the later definition\n",
+              kind_name(kind), d->id);
+    } else {
+      file_entry_failed(kind, d->id, rcs[j]);
+    }
+  }
+  free(rcs);
+
+  if (list->richpresence) {
+    eng->rp = rp;
+    if (rp_size < 0) fprintf(stderr, "[WARN] rich presence script rejected (%s)\n", rc_error_str(rp_size));
+    if (rp_start(eng)) {
+      ok_count++;
+      fprintf(stderr, "[INFO] loaded file rich presence script\n");
+    } else {
+      eng->rp = NULL;
+      fprintf(stderr, "[WARN] failed to load rich presence from file\n");
+    }
+  }
+
+  fprintf(stderr, "[INFO] set arena: %zu bytes, %u achievements, %u leaderboards, %u memrefs\n",
+          eng->arena.size, ach_count, lboard_count, eng->arena.memrefs);
+  return ok_count;
+}
+
+/* Activates a parsed set in place of whatever is active, and frees it. */
+static bool load_list(engine_t *eng, mmr_ach_list_t *list, const char *path) {
+  if (list->count == 0 && list->lboard_count == 0 && !list->richpresence) {
+    fprintf(stderr, "[WARN] ach file loaded but empty: %s (fallback to builtins)\n", path);
+    mmr_ach_free(list);
+    return false;
+  }
+
+  /* replace whatever is active in the runtime with the file set */
+  titles_clear(eng);
+  rp_clear(eng);
+
+  int loaded = eng->use_arena ? load_arena(eng, list) : -1;
+  size_t ok_count;
+  if (loaded >= 0) {
+    ok_count = (size_t)loaded;
+  } else {
+    if (eng->use_arena) fprintf(stderr, "[WARN] could not build the set arena; loading %s on the heap\n", path);
+    runtime_free(eng);
+    rc_runtime_init(&eng->runtime);
+    ok_count = load_heap(eng, list);
+  }
 
-  mmr_ach_free(&list);
+  mmr_ach_free(list);
 
   if (ok_count == 0) {
     fprintf(stderr, "[WARN] ach file had entries but none activated: %s (fallback to builtins)\n", path);
+    if (eng->arena.base) {
+      /* builtins activate into a heap runtime */
+      runtime_free(eng);
+      rc_runtime_init(&eng->runtime);
+    }
+    (void)index_loaded(eng);
     return false;
   }
 
   eng->file_loaded = true;
   eng->builtins_loaded = false;
-  return true;
+  return index_loaded(eng);
+}
+
+bool engine_load_ach_file(engine_t *eng, const char *path) {
+  if (!eng) return false;
+  if (eng->backend != ENGINE_BACKEND_RA) return true; /* nothing to do */
+  if (!path || !*path) return false;
+
+  mmr_ach_list_t list;
+  if (!mmr_ach_load_file(path, &list)) {
+    fprintf(stderr, "[WARN] could not load ach file: %s (fallback to builtins)\n", path);
+    return false;
+  }
+  return load_list(eng, &list, path);
+}
+
+bool engine_load_ach_text(engine_t *eng, const char *text, size_t len, const char *name) {
+  if (!eng) return false;
+  if (eng->backend != ENGINE_BACKEND_RA) return true;
+
+  mmr_ach_list_t list;
+  if (!mmr_ach_load_text(text, len, &list)) {
+    fprintf(stderr, "[WARN] could not load ach set: %s (fallback to builtins)\n", name);
+    return false;
+  }
+  return load_list(eng, &list, name);
 }
 
 /* built-in “SMB1-like” mock achievements for NES CPU RAM
@@ -166,11 +903,98 @@ bool engine_load_builtin(engine_t *eng) {
               ach[i].id, rc_error_str(rc));
       return false;
     }
+    title_add(eng, TITLE_ACHIEVEMENT, ach[i].id, ach[i].name, RC_FORMAT_VALUE);
     printf("[INFO] loaded builtin achievement %u: %s\n", ach[i].id, ach[i].name);
   }
 
   fflush(stdout);
-  return true;
+  return index_loaded(eng);
+}
+
+void engine_reset(engine_t *eng) {
+  if (!eng || eng->backend != ENGINE_BACKEND_RA) return;
+
+  rc_runtime_reset(&eng->runtime);
+  if (eng->rp) rc_reset_richpresence(eng->rp);
+  eng->rp_text[0] = 0;
+  eng->rp_valid = false;
+  eng->rp_reported = false;
+  eng->rp_inputs_prev = false;
+  eng->rp_hit_states = 0;
+
+  /* anything still queued belongs to the previous game */
+  eng->ev_tail = eng->ev_head;
+  ff_invalidate(&eng->ff);
+}
+
+/* Memref pass for one table; returns the time it took. */
+static uint64_t update_memrefs(engine_t *eng, const memref_table_t *t, ra_ctx_t *ctx) {
+  uint64_t t0 = now_ns();
+  if (ctx->mem) {
+    memref_table_update(t, ctx->mem, ctx->mem_len, &eng->chains, ra_peek, ctx);
+  } else {
+    memref_table_update_fetch(t, ctx->fetch, ctx->fetch_ud, ctx->mem_len, &eng->chains, ra_peek, ctx);
+  }
+  return now_ns() - t0;
+}
+
+/* rc_runtime_do_frame's memref pass (runtime.update_memrefs, see
+ * third_party/PATCHES.md): the address-sorted table in place of
+ * rc_update_memref_values. */
+static void RC_CCONV ra_update_memrefs(rc_runtime_t *rt, rc_runtime_peek_t peek, void *ud) {
+  (void)rt;
+  (void)peek;
+  ra_ctx_t *ctx = (ra_ctx_t*)ud;
+  ctx->eng->memrefs_ns += update_memrefs(ctx->eng, &ctx->eng->memrefs, ctx);
+}
+
+static void do_frame(engine_t *eng, ra_ctx_t *ctx) {
+  ff_state_t *ff = &eng->ff;
+  bool calibrate = false;
+  if (ff->enabled) {
+    ff_flush(ff);
+    if (!ff->unchanged) ff->run = 0;
+    calibrate = ff->unchanged && ff->run >= 2;
+    ff->unchanged = false;
+    ff->valid = false;
+    if (calibrate) ff_capture(ff);
+  }
+
+  prof_begin_frame(&eng->prof);
+  uint64_t t0 = now_ns();
+  memref_chain_cache_begin(&eng->chains);
+  eng->memrefs_ns = 0;
+
+  g_frame_eng = eng;
+  prof_runtime_begin(&eng->prof, &eng->runtime);
+  rc_runtime_do_frame(&eng->runtime, ra_event_handler, ra_peek, ctx, NULL);
+  prof_runtime_end();
+  g_frame_eng = NULL;
+
+  if (eng->rp && !(eng->shed & ENGINE_SHED_RICHPRESENCE)) {
+    /* rc_update_richpresence, with its memrefs through the table so pointers
+     * the achievements already followed this frame are not read again */
+    eng->memrefs_ns += update_memrefs(eng, &eng->rp_memrefs, ctx);
+    prof_mark_t mark = { 0, 0 };
+    if (eng->prof.sampling) prof_mark(&mark);
+    memref_richpresence_update(eng->rp, ra_peek, ctx);
+    if (rp_inputs_changed(eng) || !eng->rp_valid) {
+      char text[ENGINE_RP_MAX];
+      rc_get_richpresence_display_string(eng->rp, text, sizeof(text), ra_peek, (void*)ctx, NULL);
+      if (strcmp(text, eng->rp_text) != 0) {
+        memcpy(eng->rp_text, text, sizeof(text));
+        eng->rp_reported = false;
+      }
+      eng->rp_valid = true;
+    }
+    if (eng->prof.sampling && eng->prof.count > eng->prof.trigger_count + eng->prof.lboard_count) {
+      prof_account(&eng->prof.entries[eng->prof.count - 1u], &mark);
+    }
+  }
+  eng->eval_ns = now_ns() - t0 - eng->memrefs_ns;
+  if (eng->prof.sampling) eng->prof.memrefs_ns += eng->memrefs_ns;
+
+  if (calibrate) ff_calibrate(ff, eng->shed);
 }
 
 void engine_do_frame(engine_t *eng, const uint8_t *mem, size_t mem_len) {
@@ -178,8 +1002,248 @@ void engine_do_frame(engine_t *eng, const uint8_t *mem, size_t mem_len) {
   if (!mem || mem_len == 0) return;
 
   ra_ctx_t ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.eng = eng;
   ctx.mem = mem;
   ctx.mem_len = mem_len;
+  do_frame(eng, &ctx);
+}
+
+void engine_do_frame_fetch(engine_t *eng, engine_fetch_fn fetch, void *ud, size_t mem_len) {
+  if (!eng || eng->backend != ENGINE_BACKEND_RA) return;
+  if (!fetch || mem_len == 0) return;
+
+  ra_ctx_t ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.eng = eng;
+  ctx.mem_len = mem_len;
+  ctx.fetch = fetch;
+  ctx.fetch_ud = ud;
+  do_frame(eng, &ctx);
+}
+
+bool engine_has_live(const engine_t *eng) {
+  if (!eng || eng->backend != ENGINE_BACKEND_RA) return false;
+  if (eng->rp) return true;
+
+  for (uint32_t i = 0; i < eng->runtime.trigger_count; i++) {
+    const rc_trigger_t *t = eng->runtime.triggers[i].trigger;
+    if (t && t->state != RC_TRIGGER_STATE_TRIGGERED && t->state != RC_TRIGGER_STATE_DISABLED) return true;
+  }
+  for (uint32_t i = 0; i < eng->runtime.lboard_count; i++) {
+    const rc_lboard_t *lb = eng->runtime.lboards[i].lboard;
+    if (lb && lb->state != RC_LBOARD_STATE_DISABLED) return true;
+  }
+  return false;
+}
+
+bool engine_set_fast_forward(engine_t *eng, bool on) {
+  if (!eng || eng->backend != ENGINE_BACKEND_RA) return false;
+  if (!on) {
+    uint64_t skipped = eng->ff.skipped, calibrations = eng->ff.calibrations;
+    ff_free(&eng->ff);
+    eng->ff.skipped = skipped;
+    eng->ff.calibrations = calibrations;
+    return true;
+  }
+  return ff_index(eng);
+}
+
+bool engine_fast_forward(engine_t *eng) {
+  if (!eng || !eng->ff.enabled) return false;
+  ff_state_t *ff = &eng->ff;
+
+  if (ff->run < UINT32_MAX) ff->run++;
+  if (ff->valid && ff->horizon > 0 && ff->shed == eng->shed) {
+    ff->horizon--;
+    ff->pending++;
+    ff->skipped++;
+    return true;
+  }
+  /* the first unchanged frame still moves every delta; after that, or at the
+   * horizon, evaluate it for real and (re)calibrate */
+  ff->unchanged = true;
+  return false;
+}
+
+void engine_frame_changed(engine_t *eng) {
+  if (!eng) return;
+  eng->ff.run = 0;
+  eng->ff.valid = false;
+}
+
+uint64_t engine_fast_forwarded(const engine_t *eng) {
+  return eng ? eng->ff.skipped : 0;
+}
+
+void engine_set_arena(engine_t *eng, bool on) {
+  if (eng) eng->use_arena = on;
+}
+
+bool engine_set_profile(engine_t *eng, bool on) {
+  if (!eng || eng->backend != ENGINE_BACKEND_RA) return false;
+  if (!on) {
+    prof_free(&eng->prof);
+    return true;
+  }
+  return prof_index(&eng->prof, &eng->runtime, eng->rp);
+}
+
+size_t engine_profile_top(const engine_t *eng, engine_profile_row_t *rows, size_t max,
+                          engine_profile_summary_t *sum) {
+  const prof_state_t *p = eng ? &eng->prof : NULL;
+  if (sum) {
+    memset(sum, 0, sizeof(*sum));
+    if (p) {
+      sum->frames = p->frames;
+      sum->samples = p->samples;
+      sum->memrefs_ns = p->memrefs_ns;
+      for (uint32_t i = 0; i < p->count; i++) sum->entries_ns += p->entries[i].ns;
+    }
+  }
+  if (!p || !p->enabled || !rows) return 0;
+
+  uint32_t idx[ENGINE_PROFILE_TOP_MAX];
+  uint32_t n = prof_top(p, idx, max < ENGINE_PROFILE_TOP_MAX ? (uint32_t)max : ENGINE_PROFILE_TOP_MAX);
+  for (uint32_t r = 0; r < n; r++) {
+    const prof_entry_t *e = &p->entries[idx[r]];
+    engine_profile_row_t *row = &rows[r];
+    const engine_title_t *t = NULL;
+    switch (e->kind) {
+      case PROF_ACHIEVEMENT:
+        row->kind = "ach";
+        t = title_lookup(eng, TITLE_ACHIEVEMENT, e->id);
+        break;
+      case PROF_LBOARD:
+        row->kind = "lb";
+        t = title_lookup(eng, TITLE_LBOARD, e->id);
+        break;
+      default:
+        row->kind = "rp";
+        break;
+    }
+    row->id = e->id;
+    row->title = t ? t->title : (e->kind == PROF_RICHPRESENCE ? "rich presence" : "");
+    row->samples = e->samples;
+    row->total_ns = e->ns;
+    row->max_ns = e->max_ns;
+    row->conds = e->conds;
+    row->memrefs = e->memrefs;
+  }
+  return n;
+}
+
+/* hit counts toward a target, summed over the trigger's conditions */
+static uint32_t trigger_hits(const rc_trigger_t *t) {
+  uint32_t hits = 0;
+  if (!t->has_hits) return 0;
+  if (t->requirement) {
+    for (const rc_condition_t *c = t->requirement->conditions; c; c = c->next) {
+      if (c->required_hits) hits += c->current_hits;
+    }
+  }
+  for (const rc_condset_t *cs = t->alternative; cs; cs = cs->next) {
+    for (const rc_condition_t *c = cs->conditions; c; c = c->next) {
+      if (c->required_hits) hits += c->current_hits;
+    }
+  }
+  return hits;
+}
+
+uint32_t engine_progress_fill(const engine_t *eng, mmr_progress_entry_t *out, uint32_t cap, uint32_t *set_id) {
+  if (set_id) *set_id = eng ? eng->set_id : 0;
+  if (!eng || eng->backend != ENGINE_BACKEND_RA) return 0;
+
+  const rc_runtime_t *rt = &eng->runtime;
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < rt->trigger_count; i++) {
+    const rc_trigger_t *t = rt->triggers[i].trigger;
+    if (!t) continue;
+    if (n < cap) {
+      mmr_progress_entry_t *e = &out[n];
+      memset(e, 0, sizeof(*e));
+      e->id = rt->triggers[i].id;
+      e->state = t->state;
+      e->flags = t->measured_as_percent ? MMR_PROGRESS_F_PERCENT : 0u;
+      (void)memref_trigger_measured(t, &e->measured_value, &e->measured_target);
+      e->hits = trigger_hits(t);
+    }
+    n++;
+  }
+  return n;
+}
+
+void engine_frame_timing(const engine_t *eng, uint64_t *memrefs_ns, uint64_t *eval_ns) {
+  if (memrefs_ns) *memrefs_ns = eng ? eng->memrefs_ns : 0;
+  if (eval_ns) *eval_ns = eng ? eng->eval_ns : 0;
+}
+
+void engine_pointer_cache_stats(const engine_t *eng, uint64_t *lookups, uint64_t *hits) {
+  if (lookups) *lookups = eng ? eng->chains.lookups : 0;
+  if (hits) *hits = eng ? eng->chains.hits : 0;
+}
+
+void engine_set_journal(engine_t *eng, journal_t *j) {
+  if (eng) eng->journal = j;
+}
+
+void engine_set_shed(engine_t *eng, uint32_t flags) {
+  if (!eng) return;
+  /* resuming rich presence: its memrefs went stale while it was off */
+  if ((eng->shed & ENGINE_SHED_RICHPRESENCE) && !(flags & ENGINE_SHED_RICHPRESENCE)) {
+    eng->rp_valid = false;
+    eng->rp_inputs_prev = true;
+  }
+  eng->shed = flags;
+}
+
+uint64_t engine_shed_progress_events(const engine_t *eng) {
+  return eng ? eng->shed_progress_events : 0;
+}
+
+/* rc_runtime_format_achievement_measured, without its search for the id */
+static void format_measured(const rc_trigger_t *t, char *buf, size_t cap) {
+  uint32_t value, target;
+  if (!memref_trigger_measured(t, &value, &target) || target == 0) {
+    buf[0] = 0;
+    return;
+  }
+  if (value > target) value = target;
+  if (t->measured_as_percent) {
+    snprintf(buf, cap, "%u%%", (uint32_t)(((unsigned long long)value * 100u) / target));
+  } else {
+    snprintf(buf, cap, "%u/%u", value, target);
+  }
+}
+
+bool engine_next_event(engine_t *eng, engine_event_t *out) {
+  if (!eng || !out || eng->ev_tail == eng->ev_head) return false;
+
+  *out = eng->events[eng->ev_tail & (eng->ev_cap - 1u)];
+  eng->ev_tail++;
+
+  bool is_ach = (out->type == ENGINE_EVENT_ACHIEVEMENT_TRIGGERED ||
+                 out->type == ENGINE_EVENT_ACHIEVEMENT_PROGRESS);
+  const engine_title_t *t = title_lookup(eng, is_ach ? TITLE_ACHIEVEMENT : TITLE_LBOARD, out->id);
+  out->title = t ? t->title : "";
+  if (out->type == ENGINE_EVENT_ACHIEVEMENT_PROGRESS) {
+    format_measured(t ? t->trigger : NULL, out->value_str, sizeof(out->value_str));
+  } else if (!is_ach) {
+    rc_runtime_format_lboard_value(out->value_str, (int)sizeof(out->value_str), out->value,
+                                   t ? t->format : RC_FORMAT_VALUE);
+  }
+  return true;
+}
+
+uint64_t engine_dropped_events(const engine_t *eng) {
+  return eng ? eng->ev_dropped : 0;
+}
+
+const char *engine_richpresence(engine_t *eng, bool *changed) {
+  if (changed) *changed = false;
+  if (!eng || !eng->rp || !eng->rp_valid) return NULL;
 
-  rc_runtime_do_frame(&eng->runtime, ra_event_handler, ra_peek, (void*)&ctx, NULL);
+  if (changed) *changed = !eng->rp_reported;
+  eng->rp_reported = true;
+  return eng->rp_text;
 }
@@ -4,6 +4,8 @@
 #include <stdint.h>
 
 #include "../kernel/mmr_memtap.h"
+#include "journal.h"
+#include "progress.h"
 
 typedef enum {
   ENGINE_BACKEND_NONE = 0,
@@ -12,6 +14,29 @@ typedef enum {
 
 typedef struct engine_s engine_t;
 
+typedef enum {
+  ENGINE_EVENT_ACHIEVEMENT_TRIGGERED = 0,
+  ENGINE_EVENT_LBOARD_STARTED,
+  ENGINE_EVENT_LBOARD_CANCELED,
+  ENGINE_EVENT_LBOARD_SUBMITTED,
+  ENGINE_EVENT_ACHIEVEMENT_PROGRESS,   /* measured value moved; value_str is "n/target" or "n%" */
+} engine_event_type_t;
+
+/* work the governor may switch off under load (engine_set_shed) */
+#define ENGINE_SHED_RICHPRESENCE  (1u << 0)  /* skip rich presence updates */
+#define ENGINE_SHED_PROGRESS      (1u << 1)  /* drop measured-progress events */
+
+/* Queued by engine_do_frame, drained with engine_next_event (no I/O in the
+ * runtime callback). title points into engine-owned storage and stays valid
+ * until the next load. */
+typedef struct {
+  engine_event_type_t type;
+  uint32_t id;
+  int32_t value;        /* leaderboard value / measured progress; 0 otherwise */
+  char value_str[24];   /* value formatted per the leaderboard's FORMAT or measured target */
+  const char *title;
+} engine_event_t;
+
 /* init/shutdown */
 bool engine_init(engine_t **out, engine_backend_t backend, uint32_t core_id);
 void engine_destroy(engine_t *eng);
@@ -19,6 +44,111 @@ void engine_destroy(engine_t *eng);
 /* load achievements */
 bool engine_load_builtin(engine_t *eng);
 bool engine_load_ach_file(engine_t *eng, const char *path);
+/* a set already in memory (ach_load.h format, len bytes, e.g. from an
+ * --ach-lib mapping); name labels it in warnings */
+bool engine_load_ach_text(engine_t *eng, const char *text, size_t len, const char *name);
+
+/* --set-arena: build each file set in a single allocation (setarena.h).
+ * Applies to later engine_load_ach_file calls; builtins stay on the heap. */
+void engine_set_arena(engine_t *eng, bool on);
+
+/* return every trigger, leaderboard and rich presence display to its initial
+ * state (new game on the same core); loaded sets stay active */
+void engine_reset(engine_t *eng);
 
 /* per-frame evaluation */
 void engine_do_frame(engine_t *eng, const uint8_t *mem, size_t mem_len);
+
+/* Same, but memory is pulled through fetch as the runtime reads it instead
+ * of being copied up front (see snapshot.h). fetch returns num_bytes at
+ * address, or NULL (reads as 0); mem_len is the region size. */
+typedef const uint8_t *(*engine_fetch_fn)(void *ud, uint32_t address, uint32_t num_bytes);
+void engine_do_frame_fetch(engine_t *eng, engine_fetch_fn fetch, void *ud, size_t mem_len);
+
+/* true while something can still happen: an untriggered achievement, a
+ * leaderboard, or a rich presence script */
+bool engine_has_live(const engine_t *eng);
+
+/* --fast-forward: index every condition so unchanged frames can be skipped
+ * without freezing hit counts. Rebuilt by later loads; false on OOM. */
+bool engine_set_fast_forward(engine_t *eng, bool on);
+
+/* Call instead of engine_do_frame on a frame whose memory is identical to the
+ * previous one. true: the frame was absorbed (hit counts advance as a real
+ * evaluation would have advanced them); false: the caller must evaluate it
+ * with engine_do_frame(_fetch), which calibrates the next skips. Apply
+ * engine_set_shed first. */
+bool engine_fast_forward(engine_t *eng);
+
+/* the frame just evaluated turned out to differ after all (paged reads) */
+void engine_frame_changed(engine_t *eng);
+
+/* frames absorbed by engine_fast_forward */
+uint64_t engine_fast_forwarded(const engine_t *eng);
+
+/* --profile-triggers: sample what each trigger, leaderboard and the rich
+ * presence script cost to evaluate (see profile.h). Rebuilt by later loads,
+ * which start the counts over; false on OOM. */
+bool engine_set_profile(engine_t *eng, bool on);
+
+#define ENGINE_PROFILE_TOP_MAX 64u
+
+typedef struct {
+  const char *kind;     /* "ach", "lb" or "rp" */
+  uint32_t id;
+  const char *title;    /* engine-owned, valid until the next load */
+  uint64_t samples;
+  uint64_t total_ns;    /* evaluation time summed over samples */
+  uint64_t max_ns;
+  uint64_t conds;       /* conditions tested, summed over samples */
+  uint32_t memrefs;     /* distinct memrefs it reads */
+} engine_profile_row_t;
+
+typedef struct {
+  uint64_t frames;      /* evaluated while profiling */
+  uint64_t samples;
+  uint64_t entries_ns;  /* all entries, summed over samples */
+  uint64_t memrefs_ns;  /* the shared memref pass, summed over samples */
+} engine_profile_summary_t;
+
+/* The costliest entries so far, most sampled time first: up to max (capped
+ * at ENGINE_PROFILE_TOP_MAX) rows, returns how many. Does not allocate. */
+size_t engine_profile_top(const engine_t *eng, engine_profile_row_t *rows, size_t max,
+                          engine_profile_summary_t *sum);
+
+/* Fill out with the state of every loaded achievement (up to cap entries,
+ * in a fixed order per load) for the progress table; returns how many there
+ * are. *set_id changes whenever a different set is loaded. Frame thread. */
+uint32_t engine_progress_fill(const engine_t *eng, mmr_progress_entry_t *out, uint32_t cap, uint32_t *set_id);
+
+/* wall time the last engine_do_frame(_fetch) spent updating memrefs (both
+ * passes, including page fetches when paging) and evaluating triggers,
+ * leaderboards and rich presence */
+void engine_frame_timing(const engine_t *eng, uint64_t *memrefs_ns, uint64_t *eval_ns);
+
+/* AddAddress reads looked up in the per-frame pointer cache, and how many of
+ * them another chain had already resolved that frame */
+void engine_pointer_cache_stats(const engine_t *eng, uint64_t *lookups, uint64_t *hits);
+
+/* append every runtime event, queued or not (resets, pauses, priming,
+ * leaderboard updates), to j; NULL turns it off */
+void engine_set_journal(engine_t *eng, journal_t *j);
+
+/* ENGINE_SHED_* mask; applies from the next engine_do_frame */
+void engine_set_shed(engine_t *eng, uint32_t flags);
+
+/* progress events dropped while ENGINE_SHED_PROGRESS was set */
+uint64_t engine_shed_progress_events(const engine_t *eng);
+
+/* pop the oldest queued event; false when the queue is empty */
+bool engine_next_event(engine_t *eng, engine_event_t *out);
+
+/* progress and leaderboard start/cancel events lost because the queue was
+ * full; it holds a frame of the loaded set, so only when it is not drained
+ * every frame. Unlocks and submissions grow the queue instead. */
+uint64_t engine_dropped_events(const engine_t *eng);
+
+/* cached rich presence text, or NULL when no script is loaded. The string is
+ * only re-formatted on frames where one of its inputs changed; *changed is
+ * set when it differs from what the previous call returned. */
+const char *engine_richpresence(engine_t *eng, bool *changed);
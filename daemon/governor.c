@@ -0,0 +1,98 @@
+#include "governor.h"
+#include "engine.h"
+
+#include <string.h>
+
+// Hysteresis: escalate quickly on sustained overload, relax slowly.
+#define GOV_OVER_FRAMES      8u     // polls over budget before shedding more
+#define GOV_UNDER_FRAMES     120u   // polls under half budget before restoring
+#define GOV_EWMA_WEIGHT      0.2
+
+// Back-off for static snapshots / idle sets, in frame periods.
+#define GOV_STATIC_AFTER     60u    // unchanged polls before backing off
+#define GOV_STATIC_INTERVAL  4u
+#define GOV_IDLE_INTERVAL    8u
+
+void governor_init(governor_t *g, uint32_t budget_pct) {
+  memset(g, 0, sizeof(*g));
+  g->budget_pct = budget_pct;
+  g->interval = 1;
+  g->interval_reason = GOV_SKIP_STATIC;
+}
+
+uint32_t governor_next_interval(governor_t *g) {
+  if (g->budget_pct == 0) return 1;
+  if (g->interval > 1) g->skipped[g->interval_reason] += g->interval - 1u;
+  return g->interval;
+}
+
+uint32_t governor_shed_flags(const governor_t *g) {
+  uint32_t flags = 0;
+  if (g->level >= 1) flags |= ENGINE_SHED_RICHPRESENCE;
+  if (g->level >= 2) flags |= ENGINE_SHED_PROGRESS;
+  return flags;
+}
+
+double governor_utilization(const governor_t *g, uint64_t period_ns) {
+  if (period_ns == 0) return 0.0;
+  return g->cost_ewma_ns * 100.0 / (double)period_ns;
+}
+
+bool governor_end_frame(governor_t *g, uint64_t cost_ns, uint64_t period_ns,
+                        bool changed, bool live) {
+  if (g->budget_pct == 0) return false;
+
+  g->polled++;
+  g->level_frames[g->level]++;
+
+  if (g->polled == 1) g->cost_ewma_ns = (double)cost_ns;
+  else g->cost_ewma_ns += GOV_EWMA_WEIGHT * ((double)cost_ns - g->cost_ewma_ns);
+
+  uint32_t old_level = g->level;
+  double util = governor_utilization(g, period_ns);
+
+  if (util > (double)g->budget_pct) {
+    g->under_streak = 0;
+    if (++g->over_streak >= GOV_OVER_FRAMES && g->level < GOV_LEVEL_MAX) {
+      g->level++;
+      g->over_streak = 0;
+    }
+  } else if (util < (double)g->budget_pct / 2.0) {
+    g->over_streak = 0;
+    if (++g->under_streak >= GOV_UNDER_FRAMES && g->level > 0) {
+      g->level--;
+      g->under_streak = 0;
+    }
+  } else {
+    g->over_streak = 0;
+    g->under_streak = 0;
+  }
+
+  g->static_streak = changed ? 0 : g->static_streak + 1u;
+
+  // the longest applicable back-off wins; its reason gets the skipped frames
+  g->interval = 1;
+  if (g->level >= 3) {
+    g->interval = g->level - 1u;
+    g->interval_reason = GOV_SKIP_OVERLOAD;
+  }
+  if (g->static_streak >= GOV_STATIC_AFTER && g->interval < GOV_STATIC_INTERVAL) {
+    g->interval = GOV_STATIC_INTERVAL;
+    g->interval_reason = GOV_SKIP_STATIC;
+  }
+  if (!live && g->interval < GOV_IDLE_INTERVAL) {
+    g->interval = GOV_IDLE_INTERVAL;
+    g->interval_reason = GOV_SKIP_IDLE;
+  }
+
+  return g->level != old_level;
+}
+
+const char *governor_skip_reason_str(gov_skip_reason_t r) {
+  switch (r) {
+    case GOV_SKIP_STATIC:   return "static";
+    case GOV_SKIP_IDLE:     return "idle";
+    case GOV_SKIP_OVERLOAD: return "overload";
+    default: return "?";
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// CPU governor: keeps the daemon's own CPU time per frame under a budget
+// (percent of one core) so it does not starve Main_MiSTer.
+//
+// Every poll it is told what the frame cost (thread CPU time), whether the
+// snapshot changed and whether the engine still has anything live. From
+// that it picks how many frame periods to wait before the next poll and
+// which work to shed. Work is shed in this order as cost stays over budget,
+// and restored in reverse once it has been comfortably under budget:
+//   level 1: rich presence updates
+//   level 2: + measured-progress events
+//   level 3+: + evaluation cadence (poll every 2nd, 3rd, 4th frame)
+// Independently of load, it backs off while snapshots are static and when
+// nothing is live. Every frame not polled is counted under its reason.
+
+typedef enum {
+  GOV_SKIP_STATIC = 0,   // snapshot unchanged for a while
+  GOV_SKIP_IDLE,         // no live achievements/leaderboards/rich presence
+  GOV_SKIP_OVERLOAD,     // reduced cadence (level >= 3)
+  GOV_SKIP_REASONS,
+} gov_skip_reason_t;
+
+#define GOV_LEVEL_MAX 5u
+
+typedef struct {
+  uint32_t budget_pct;          // 0 = governor off (fixed cadence)
+
+  uint32_t level;               // 0 = full service, see above
+  double cost_ewma_ns;          // smoothed CPU time per polled frame
+  uint32_t over_streak;
+  uint32_t under_streak;
+  uint32_t static_streak;       // consecutive unchanged polls
+
+  uint32_t interval;            // frame periods until the next poll
+  gov_skip_reason_t interval_reason;
+
+  uint64_t polled;
+  uint64_t skipped[GOV_SKIP_REASONS];
+  uint64_t level_frames[GOV_LEVEL_MAX + 1];   // polled frames spent at each level
+} governor_t;
+
+void governor_init(governor_t *g, uint32_t budget_pct);
+
+// Frame periods to sleep before the next poll (>= 1). Frames beyond the
+// first are recorded as skipped under the current reason.
+uint32_t governor_next_interval(governor_t *g);
+
+// ENGINE_SHED_* flags for the current level.
+uint32_t governor_shed_flags(const governor_t *g);
+
+// Account one polled frame. Returns true when the shed level changed.
+bool governor_end_frame(governor_t *g, uint64_t cost_ns, uint64_t period_ns,
+                        bool changed, bool live);
+
+// Smoothed cost as a percentage of one frame period.
+double governor_utilization(const governor_t *g, uint64_t period_ns);
+
+const char *governor_skip_reason_str(gov_skip_reason_t r);
@@ -0,0 +1,587 @@
+/*
+ * mmr-iobench: measure what getting one frame of RAM out of the memtap
+ * layer costs, per backend, region size and acquisition strategy.
+ *
+ * Goes through the memsrc_ops_t vtable (memsrc_memtap.c -> memtap.c), so it
+ * exercises exactly the code the daemon runs. For every combination it
+ * reports read latency percentiles, syscalls per frame, bytes copied per
+ * frame and pages re-read per frame.
+ *
+ *   ./mmr-iobench                                   # mock files under /tmp
+ *   ./mmr-iobench --tmp /media/fat/tmp              # mock files on the SD card
+ *   sudo ./mmr-iobench --backend device --publish   # loopback, user_publish=1
+ *   ./mmr-iobench --backend device --rate 60        # live driver
+ *
+ * Strategies:
+ *   full   seek 0 + read of the whole region
+ *   dirty  memtap_read_dirty: GET_DIRTY + one seek/read per run of dirty
+ *          pages (a full read where page tracking is unavailable)
+ *   loop   what the daemon's frame loop issues: GET_INFO (core-switch
+ *          poll) followed by a dirty read
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "../kernel/mmr_memtap.h"
+#include "memsrc_memtap.h"
+#include "util.h"
+
+typedef enum {
+  STRATEGY_FULL = 0,
+  STRATEGY_DIRTY,
+  STRATEGY_LOOP,
+  STRATEGY_COUNT,
+} strategy_t;
+
+static const char *const k_strategy_names[STRATEGY_COUNT] = { "full", "dirty", "loop" };
+
+typedef enum {
+  BACKEND_MOCK = 0,
+  BACKEND_DEVICE,
+  BACKEND_COUNT,
+} backend_t;
+
+static const char *const k_backend_names[BACKEND_COUNT] = { "mock", "device" };
+
+typedef struct {
+  const char *name;
+  uint32_t core_id;
+  uint32_t region_id;
+  uint32_t size;
+  const char *mock_file;   /* must match memtap.c's mock naming */
+} bench_region_t;
+
+static const bench_region_t k_regions[] = {
+  { "nes",     MMR_CORE_NES,     MMR_REGION_NES_CPU_RAM, 0x0800,  "nes_cpu_ram.bin" },
+  { "genesis", MMR_CORE_GENESIS, MMR_REGION_GEN_68K_RAM, 0x10000, "gen_68k_ram.bin" },
+  { "snes",    MMR_CORE_SNES,    MMR_REGION_SNES_WRAM,   0x20000, "snes_wram.bin" },
+};
+#define REGION_COUNT (sizeof(k_regions) / sizeof(k_regions[0]))
+
+typedef struct {
+  const char *dev_path;
+  char mock_dir[512];
+  uint32_t frames;
+  uint32_t dirty_bytes;
+  uint32_t seed;
+  uint32_t rate;
+  int publish;
+} bench_cfg_t;
+
+typedef struct {
+  uint32_t size;       /* region bytes as exposed by the backend */
+  uint32_t frames;
+  uint64_t p50_ns, p90_ns, p99_ns, max_ns;
+  double mean_ns;
+  double syscalls;     /* per frame */
+  double bytes;        /* per frame */
+  double pages;        /* re-read per frame */
+} bench_result_t;
+
+static int parse_u32(const char *s, uint32_t *out) {
+  if (!s || !*s || !out) return 0;
+  errno = 0;
+  char *end = NULL;
+  unsigned long v = strtoul(s, &end, 10);
+  if (errno != 0) return 0;
+  if (end == s || *end != '\0') return 0;
+  if (v > 0xFFFFFFFFul) return 0;
+  *out = (uint32_t)v;
+  return 1;
+}
+
+static uint32_t xorshift32(uint32_t *s) {
+  uint32_t x = *s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *s = x;
+  return x;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+/* nearest-rank percentile of a sorted array */
+static uint64_t percentile(const uint64_t *sorted, uint32_t n, uint32_t pct) {
+  if (n == 0) return 0;
+  uint64_t rank = ((uint64_t)n * pct + 99u) / 100u;
+  if (rank == 0) rank = 1;
+  return sorted[rank - 1];
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+    "MiSTer Milestones acquisition benchmark (mmr-iobench)\n"
+    "\n"
+    "Usage:\n"
+    "  %s [--backend mock|device|both] [--region nes|snes|genesis|all]\n"
+    "     [--strategy full|dirty|loop|all] [--frames N] [--dirty-bytes N] [--seed N]\n"
+    "     [--rate HZ] [--dev PATH] [--publish] [--tmp DIR] [--csv]\n"
+    "\n"
+    "Options:\n"
+    "  --backend NAME        memtap backend(s) to measure (default: mock)\n"
+    "  --region NAME         region(s) to measure (default: all)\n"
+    "  --strategy NAME       acquisition strategy, see below (default: all)\n"
+    "  --frames N            measured frames per combination (default: 2000)\n"
+    "  --dirty-bytes N       random bytes changed per frame (default: 16)\n"
+    "  --seed N              PRNG seed for the changes (default: 1)\n"
+    "  --rate HZ             pace frames at HZ, 0 = back to back (default: 0)\n"
+    "  --dev PATH            memtap device path (default: /dev/mmr_memtap)\n"
+    "  --publish             device: drive frames with MMR_IOCTL_PUBLISH (loopback\n"
+    "                        driver loaded with user_publish=1, needs CAP_SYS_ADMIN);\n"
+    "                        otherwise the driver's own frames are read\n"
+    "  --tmp DIR             where the mock region files are created (default: /tmp)\n"
+    "  --csv                 print CSV instead of a table\n"
+    "  -h, --help            show help\n"
+    "\n"
+    "Strategies:\n"
+    "  full   seek 0 + read of the whole region\n"
+    "  dirty  GET_DIRTY + one seek/read per run of dirty pages (full read on mock)\n"
+    "  loop   GET_INFO + dirty read, as issued by the daemon's frame loop\n",
+    argv0);
+}
+
+/* ---- frame sources ---------------------------------------------------- */
+
+/* Changes the region between measured frames; never timed. */
+typedef struct {
+  backend_t backend;
+  const bench_region_t *region;
+  uint32_t size;
+  uint32_t dirty_bytes;
+  uint32_t rng;
+  int fd;            /* mock: region file (O_RDWR); device: publish fd or -1 */
+  uint8_t *shadow;   /* device --publish: frame contents */
+} mutator_t;
+
+static int mutator_open(mutator_t *m, const bench_cfg_t *cfg, backend_t backend,
+                        const bench_region_t *region, uint32_t size) {
+  memset(m, 0, sizeof(*m));
+  m->backend = backend;
+  m->region = region;
+  m->size = size;
+  m->dirty_bytes = cfg->dirty_bytes;
+  m->rng = cfg->seed;
+  m->fd = -1;
+
+  if (backend == BACKEND_MOCK) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/%s", cfg->mock_dir, region->mock_file);
+    m->fd = open(path, O_RDWR | O_CLOEXEC);
+    if (m->fd < 0) {
+      fprintf(stderr, "[ERR] open(%s) failed: %s\n", path, strerror(errno));
+      return 0;
+    }
+    return 1;
+  }
+
+  if (!cfg->publish) return 1;
+
+  m->fd = open(cfg->dev_path, O_RDWR | O_CLOEXEC);
+  if (m->fd < 0) {
+    fprintf(stderr, "[ERR] open(%s) for publishing failed: %s\n", cfg->dev_path, strerror(errno));
+    return 0;
+  }
+  m->shadow = calloc(1, size);
+  if (!m->shadow) {
+    fprintf(stderr, "[ERR] out of memory (%u bytes)\n", size);
+    close(m->fd);
+    m->fd = -1;
+    return 0;
+  }
+  return 1;
+}
+
+static void mutator_close(mutator_t *m) {
+  if (m->fd >= 0) close(m->fd);
+  free(m->shadow);
+  m->fd = -1;
+  m->shadow = NULL;
+}
+
+static int mutator_step(mutator_t *m) {
+  if (m->fd < 0) return 1;   /* device without --publish: the driver drives */
+  uint32_t size = m->size;
+
+  if (m->backend == BACKEND_MOCK) {
+    for (uint32_t i = 0; i < m->dirty_bytes; i++) {
+      uint32_t r = xorshift32(&m->rng);
+      uint8_t v = (uint8_t)(r >> 24);
+      if (pwrite(m->fd, &v, 1, (off_t)(r % size)) != 1) {
+        fprintf(stderr, "[ERR] mock pwrite failed: %s\n", strerror(errno));
+        return 0;
+      }
+    }
+    return 1;
+  }
+
+  for (uint32_t i = 0; i < m->dirty_bytes; i++) {
+    uint32_t r = xorshift32(&m->rng);
+    m->shadow[r % size] = (uint8_t)(r >> 24);
+  }
+  struct mmr_publish_req req;
+  memset(&req, 0, sizeof(req));
+  req.region_id = m->region->region_id;
+  req.size = size;
+  req.data_ptr = (uint64_t)(uintptr_t)m->shadow;
+  if (ioctl(m->fd, MMR_IOCTL_PUBLISH, &req) != 0) {
+    fprintf(stderr, "[ERR] MMR_IOCTL_PUBLISH failed: %s\n", strerror(errno));
+    return 0;
+  }
+  return 1;
+}
+
+/* ---- measurement ------------------------------------------------------ */
+
+static int acquire(memsrc_t *ms, strategy_t strategy, uint8_t *buf, uint32_t size,
+                   int32_t *out_pages) {
+  ssize_t n;
+  switch (strategy) {
+    case STRATEGY_FULL:
+      *out_pages = -1;
+      if (!memsrc_seek(ms, 0)) return 0;
+      n = memsrc_read(ms, buf, size);
+      break;
+    case STRATEGY_LOOP: {
+      struct mmr_info info;
+      if (!memsrc_get_info(ms, &info)) return 0;
+      n = memsrc_read_dirty(ms, buf, size, out_pages);
+      break;
+    }
+    case STRATEGY_DIRTY:
+    default:
+      n = memsrc_read_dirty(ms, buf, size, out_pages);
+      break;
+  }
+  return n == (ssize_t)size;
+}
+
+/* Returns 1 on success, 0 on error, -1 when the combination is unavailable. */
+static int run_one(const bench_cfg_t *cfg, backend_t backend, const bench_region_t *region,
+                   strategy_t strategy, uint64_t *lat, bench_result_t *res) {
+  memset(res, 0, sizeof(*res));
+
+  memsrc_t ms;
+  memsrc_init_memtap(&ms);
+  if (!ms.impl) {
+    fprintf(stderr, "[ERR] out of memory\n");
+    return 0;
+  }
+
+  int ok = (backend == BACKEND_MOCK)
+    ? memsrc_open_mock(&ms, cfg->mock_dir, region->core_id)
+    : memsrc_open_device(&ms, cfg->dev_path);
+  if (!ok) {
+    memsrc_close(&ms);
+    return 0;
+  }
+
+  uint32_t size = region->size;
+  if (backend == BACKEND_DEVICE) {
+    struct mmr_region_desc regions[MMR_MAX_REGIONS];
+    uint32_t count = 0;
+    size = 0;
+    if (memsrc_get_regions(&ms, regions, &count)) {
+      for (uint32_t i = 0; i < count; i++) {
+        if (regions[i].region_id == region->region_id) size = regions[i].size_bytes;
+      }
+    }
+    if (size == 0) {
+      memsrc_close(&ms);
+      return -1;
+    }
+  }
+
+  mutator_t mut;
+  uint8_t *buf = calloc(1, size);
+  if (!buf || !memsrc_select_region(&ms, region->region_id) ||
+      !mutator_open(&mut, cfg, backend, region, size)) {
+    free(buf);
+    memsrc_close(&ms);
+    return 0;
+  }
+
+  /* baseline copy so dirty tracking starts from a known frame */
+  int32_t pages = 0;
+  int rc = acquire(&ms, STRATEGY_FULL, buf, size, &pages);
+
+  const uint32_t total_pages = (size + MMR_DIRTY_PAGE_SIZE - 1u) >> MMR_DIRTY_PAGE_SHIFT;
+  const uint64_t period_ns = cfg->rate ? 1000000000ull / cfg->rate : 0;
+  uint64_t deadline = now_ns();
+  uint64_t sum_ns = 0, sum_pages = 0;
+  memsrc_io_stats_t start, end;
+  memsrc_io_stats(&ms, &start);
+  uint32_t f = 0;
+
+  for (; rc && f < cfg->frames; f++) {
+    if (!mutator_step(&mut)) {
+      rc = 0;
+      break;
+    }
+    if (period_ns) {
+      deadline += period_ns;
+      sleep_until_ns(deadline);
+    }
+
+    uint64_t t0 = now_ns();
+    if (!acquire(&ms, strategy, buf, size, &pages)) {
+      rc = 0;
+      break;
+    }
+    lat[f] = now_ns() - t0;
+    sum_ns += lat[f];
+    sum_pages += pages < 0 ? total_pages : (uint32_t)pages;
+  }
+  memsrc_io_stats(&ms, &end);
+
+  if (rc && f > 0) {
+    /* mutator syscalls go through their own fd, so io stats are reads only */
+    qsort(lat, f, sizeof(lat[0]), cmp_u64);
+    res->size = size;
+    res->frames = f;
+    res->p50_ns = percentile(lat, f, 50);
+    res->p90_ns = percentile(lat, f, 90);
+    res->p99_ns = percentile(lat, f, 99);
+    res->max_ns = lat[f - 1];
+    res->mean_ns = (double)sum_ns / f;
+    res->syscalls = (double)(end.syscalls - start.syscalls) / f;
+    res->bytes = (double)(end.bytes - start.bytes) / f;
+    res->pages = (double)sum_pages / f;
+  }
+
+  mutator_close(&mut);
+  free(buf);
+  memsrc_close(&ms);
+  return rc;
+}
+
+static void print_result(int csv, backend_t backend, const bench_region_t *region,
+                         strategy_t strategy, const bench_result_t *r) {
+  if (csv) {
+    printf("%s,%s,%u,%s,%u,%.0f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.2f,%.0f,%.2f\n",
+           k_backend_names[backend], region->name, r->size, k_strategy_names[strategy],
+           r->frames, r->mean_ns, r->p50_ns, r->p90_ns, r->p99_ns, r->max_ns,
+           r->syscalls, r->bytes, r->pages);
+    return;
+  }
+  printf("%-7s %-8s %7u %-6s %9.1f %9.1f %9.1f %9.1f %9.1f %8.2f %10.0f %7.2f\n",
+         k_backend_names[backend], region->name, r->size, k_strategy_names[strategy],
+         r->mean_ns / 1000.0, r->p50_ns / 1000.0, r->p90_ns / 1000.0,
+         r->p99_ns / 1000.0, r->max_ns / 1000.0, r->syscalls, r->bytes, r->pages);
+}
+
+/* ---- mock files ------------------------------------------------------- */
+
+static int mock_dir_create(bench_cfg_t *cfg, const char *tmp_base) {
+  snprintf(cfg->mock_dir, sizeof(cfg->mock_dir), "%s/mmr-iobench.XXXXXX", tmp_base);
+  if (!mkdtemp(cfg->mock_dir)) {
+    fprintf(stderr, "[ERR] mkdtemp(%s) failed: %s\n", cfg->mock_dir, strerror(errno));
+    cfg->mock_dir[0] = 0;
+    return 0;
+  }
+
+  uint32_t rng = cfg->seed;
+  for (size_t i = 0; i < REGION_COUNT; i++) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/%s", cfg->mock_dir, k_regions[i].mock_file);
+    uint8_t *data = malloc(k_regions[i].size);
+    if (!data) return 0;
+    for (uint32_t j = 0; j < k_regions[i].size; j++) data[j] = (uint8_t)xorshift32(&rng);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ssize_t n = fd >= 0 ? write(fd, data, k_regions[i].size) : -1;
+    if (fd >= 0) close(fd);
+    free(data);
+    if (n != (ssize_t)k_regions[i].size) {
+      fprintf(stderr, "[ERR] writing %s failed: %s\n", path, strerror(errno));
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void mock_dir_remove(const bench_cfg_t *cfg) {
+  if (!cfg->mock_dir[0]) return;
+  for (size_t i = 0; i < REGION_COUNT; i++) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/%s", cfg->mock_dir, k_regions[i].mock_file);
+    unlink(path);
+  }
+  rmdir(cfg->mock_dir);
+}
+
+int main(int argc, char **argv) {
+  bench_cfg_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.dev_path = "/dev/mmr_memtap";
+  cfg.frames = 2000;
+  cfg.dirty_bytes = 16;
+  cfg.seed = 1;
+
+  const char *tmp_base = "/tmp";
+  int backend_mask = 1 << BACKEND_MOCK;
+  int strategy_mask = (1 << STRATEGY_COUNT) - 1;
+  const char *region_str = "all";
+  int csv = 0;
+
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+    if (strcmp(a, "-h") == 0 || strcmp(a, "--help") == 0) {
+      usage(argv[0]);
+      return 0;
+    }
+    if (strcmp(a, "--publish") == 0) {
+      cfg.publish = 1;
+      continue;
+    }
+    if (strcmp(a, "--csv") == 0) {
+      csv = 1;
+      continue;
+    }
+
+    if (!v) {
+      fprintf(stderr, "ERROR: %s requires a value\n", a);
+      return 2;
+    }
+
+    if (strcmp(a, "--backend") == 0) {
+      if (strcmp(v, "mock") == 0) backend_mask = 1 << BACKEND_MOCK;
+      else if (strcmp(v, "device") == 0) backend_mask = 1 << BACKEND_DEVICE;
+      else if (strcmp(v, "both") == 0) backend_mask = (1 << BACKEND_COUNT) - 1;
+      else {
+        fprintf(stderr, "ERROR: invalid --backend '%s' (mock|device|both)\n", v);
+        return 2;
+      }
+    } else if (strcmp(a, "--strategy") == 0) {
+      if (strcmp(v, "all") == 0) {
+        strategy_mask = (1 << STRATEGY_COUNT) - 1;
+      } else {
+        strategy_mask = 0;
+        for (int s = 0; s < STRATEGY_COUNT; s++) {
+          if (strcmp(v, k_strategy_names[s]) == 0) strategy_mask = 1 << s;
+        }
+        if (!strategy_mask) {
+          fprintf(stderr, "ERROR: invalid --strategy '%s' (full|dirty|loop|all)\n", v);
+          return 2;
+        }
+      }
+    } else if (strcmp(a, "--region") == 0) {
+      region_str = v;
+    } else if (strcmp(a, "--frames") == 0) {
+      if (!parse_u32(v, &cfg.frames) || cfg.frames == 0 || cfg.frames > 10000000) {
+        fprintf(stderr, "ERROR: invalid --frames '%s' (1..10000000)\n", v);
+        return 2;
+      }
+    } else if (strcmp(a, "--dirty-bytes") == 0) {
+      if (!parse_u32(v, &cfg.dirty_bytes)) {
+        fprintf(stderr, "ERROR: invalid --dirty-bytes '%s'\n", v);
+        return 2;
+      }
+    } else if (strcmp(a, "--seed") == 0) {
+      if (!parse_u32(v, &cfg.seed) || cfg.seed == 0) {
+        fprintf(stderr, "ERROR: invalid --seed '%s' (must be non-zero)\n", v);
+        return 2;
+      }
+    } else if (strcmp(a, "--rate") == 0) {
+      if (!parse_u32(v, &cfg.rate) || cfg.rate > 100000) {
+        fprintf(stderr, "ERROR: invalid --rate '%s' (0..100000)\n", v);
+        return 2;
+      }
+    } else if (strcmp(a, "--dev") == 0) {
+      cfg.dev_path = v;
+    } else if (strcmp(a, "--tmp") == 0) {
+      tmp_base = v;
+    } else {
+      fprintf(stderr, "ERROR: unknown option '%s'\n", a);
+      usage(argv[0]);
+      return 2;
+    }
+    i++;
+  }
+
+  int region_mask = 0;
+  for (size_t r = 0; r < REGION_COUNT; r++) {
+    if (strcmp(region_str, "all") == 0 || strcmp(region_str, k_regions[r].name) == 0) {
+      region_mask |= 1 << r;
+    }
+  }
+  if (!region_mask) {
+    fprintf(stderr, "ERROR: invalid --region '%s' (nes|snes|genesis|all)\n", region_str);
+    return 2;
+  }
+
+  if ((backend_mask & (1 << BACKEND_DEVICE)) && !file_exists(cfg.dev_path)) {
+    if (backend_mask == (1 << BACKEND_DEVICE)) {
+      fprintf(stderr, "[ERR] %s not found (is the memtap driver loaded?)\n", cfg.dev_path);
+      return 1;
+    }
+    fprintf(stderr, "[WARN] %s not found; measuring the mock backend only\n", cfg.dev_path);
+    backend_mask &= ~(1 << BACKEND_DEVICE);
+  }
+
+  uint64_t *lat = malloc(sizeof(uint64_t) * cfg.frames);
+  if (!lat) {
+    fprintf(stderr, "[ERR] out of memory (%u frames)\n", cfg.frames);
+    return 1;
+  }
+
+  if ((backend_mask & (1 << BACKEND_MOCK)) && !mock_dir_create(&cfg, tmp_base)) {
+    mock_dir_remove(&cfg);
+    free(lat);
+    return 1;
+  }
+
+  if (csv) {
+    printf("backend,region,size,strategy,frames,mean_ns,p50_ns,p90_ns,p99_ns,max_ns,"
+           "syscalls_per_frame,bytes_per_frame,pages_per_frame\n");
+  } else {
+    printf("# frames=%u dirty_bytes=%u rate=%u%s\n", cfg.frames, cfg.dirty_bytes, cfg.rate,
+           cfg.rate == 0 ? " (back to back)" : "");
+    printf("%-7s %-8s %7s %-6s %9s %9s %9s %9s %9s %8s %10s %7s\n",
+           "backend", "region", "bytes", "strat", "mean_us", "p50_us", "p90_us", "p99_us",
+           "max_us", "sys/fr", "bytes/fr", "pg/fr");
+  }
+
+  int rc = 0;
+  for (int b = 0; b < BACKEND_COUNT; b++) {
+    if (!(backend_mask & (1 << b))) continue;
+    for (size_t r = 0; r < REGION_COUNT; r++) {
+      if (!(region_mask & (1 << r))) continue;
+      for (int s = 0; s < STRATEGY_COUNT; s++) {
+        if (!(strategy_mask & (1 << s))) continue;
+
+        bench_result_t res;
+        int ok = run_one(&cfg, (backend_t)b, &k_regions[r], (strategy_t)s, lat, &res);
+        if (ok < 0) {
+          fprintf(stderr, "[WARN] %s: region %s not exposed, skipped\n",
+                  k_backend_names[b], k_regions[r].name);
+          break;
+        }
+        if (!ok) {
+          fprintf(stderr, "[ERR] %s/%s/%s failed\n",
+                  k_backend_names[b], k_regions[r].name, k_strategy_names[s]);
+          rc = 1;
+          continue;
+        }
+        print_result(csv, (backend_t)b, &k_regions[r], (strategy_t)s, &res);
+        fflush(stdout);
+      }
+    }
+  }
+
+  mock_dir_remove(&cfg);
+  free(lat);
+  return rc;
+}
@@ -0,0 +1,296 @@
+#include "journal.h"
+#include "notify.h"
+#include "util.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(mmr_journal_header_t) == 64, "journal header layout is ABI");
+_Static_assert(sizeof(mmr_journal_record_t) == 32, "journal record layout is ABI");
+
+#define JOURNAL_SYNC_S       1       // MS_ASYNC writeback at most once a second
+#define JOURNAL_MIN_RECORDS  256u
+
+// rotate with this many records still free, so a burst in the frame that
+// crosses the mark is never dropped
+static uint32_t headroom(uint32_t capacity) {
+  uint32_t h = capacity / 16u;
+  return h < 64u ? 64u : h;
+}
+
+static uint64_t realtime_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// PATH -> PATH.1 -> PATH.2 ... -> PATH.keep (dropped)
+static void rotate_files(const char *path, uint32_t keep) {
+  char from[600], to[600];
+  if (keep == 0) {
+    unlink(path);
+    return;
+  }
+  for (uint32_t i = keep; i > 1; i--) {
+    snprintf(from, sizeof(from), "%s.%u", path, i - 1u);
+    snprintf(to, sizeof(to), "%s.%u", path, i);
+    if (file_exists(from)) rename(from, to);
+  }
+  snprintf(to, sizeof(to), "%s.1", path);
+  if (rename(path, to) != 0 && errno != ENOENT) {
+    notify(NOTIFY_WARN, "journal: rename(%s, %s) failed: %s", path, to, strerror(errno));
+  }
+}
+
+// The next file's name until the background thread renames it to PATH.
+static void next_path(const journal_t *j, char *out, size_t cap) {
+  snprintf(out, cap, "%s.next", j->path);
+}
+
+// Creates and maps an empty journal file. The header gets everything but its
+// start times and magic (header_start), so a reader does not take a spare
+// for a journal.
+static bool file_create(const journal_t *j, const char *path, journal_file_t *f) {
+  size_t map_size = sizeof(mmr_journal_header_t) + (size_t)j->capacity * sizeof(mmr_journal_record_t);
+
+  f->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  f->base = NULL;
+  f->map_size = 0;
+  if (f->fd < 0) {
+    notify(NOTIFY_ERR, "journal: open(%s) failed: %s", path, strerror(errno));
+    return false;
+  }
+  if (ftruncate(f->fd, (off_t)map_size) != 0) {
+    notify(NOTIFY_ERR, "journal: ftruncate(%s, %zu) failed: %s", path, map_size, strerror(errno));
+    close(f->fd);
+    f->fd = -1;
+    return false;
+  }
+  void *p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+  if (p == MAP_FAILED) {
+    notify(NOTIFY_ERR, "journal: mmap(%s) failed: %s", path, strerror(errno));
+    close(f->fd);
+    f->fd = -1;
+    return false;
+  }
+
+  f->base = (uint8_t*)p;
+  f->map_size = map_size;
+  mmr_journal_header_t *h = (mmr_journal_header_t*)p;
+  h->version = MMR_JOURNAL_VERSION;
+  h->header_size = (uint32_t)sizeof(mmr_journal_header_t);
+  h->record_size = (uint32_t)sizeof(mmr_journal_record_t);
+  h->capacity = j->capacity;
+  h->writer_pid = (uint32_t)getpid();
+  h->count = 0;
+  return true;
+}
+
+// Stamps the file's start and makes it a journal; stores only (the clocks
+// are read through the vDSO), so the frame thread can do it on a swap.
+static void header_start(mmr_journal_header_t *h) {
+  h->start_mono_ns = now_ns();
+  h->start_real_ns = realtime_ns();
+  // magic last: a reader that sees it sees the rest of the header
+  __atomic_store_n(&h->magic, MMR_JOURNAL_MAGIC, __ATOMIC_RELEASE);
+}
+
+// Flush and unmap a file, trimmed to the records it holds.
+static void file_close(journal_file_t *f) {
+  if (f->base) {
+    uint64_t n = __atomic_load_n(&((mmr_journal_header_t*)f->base)->count, __ATOMIC_ACQUIRE);
+    msync(f->base, f->map_size, MS_SYNC);
+    munmap(f->base, f->map_size);
+    if (f->fd >= 0) {
+      (void)ftruncate(f->fd, (off_t)(sizeof(mmr_journal_header_t) + n * sizeof(mmr_journal_record_t)));
+    }
+  }
+  if (f->fd >= 0) close(f->fd);
+  f->fd = -1;
+  f->base = NULL;
+  f->map_size = 0;
+}
+
+static void use_file(journal_t *j, const journal_file_t *f) {
+  j->fd = f->fd;
+  j->base = f->base;
+  j->map_size = f->map_size;
+  j->hdr = (mmr_journal_header_t*)f->base;
+  j->records = (mmr_journal_record_t*)(f->base + sizeof(mmr_journal_header_t));
+}
+
+// MS_ASYNC over the pages holding records [from, to), plus the header page
+// (count).
+static void writeback(uint8_t *base, uint64_t from, uint64_t to) {
+  long pg = sysconf(_SC_PAGESIZE);
+  size_t page = pg > 0 ? (size_t)pg : 4096u;
+  size_t lo = (sizeof(mmr_journal_header_t) + from * sizeof(mmr_journal_record_t)) & ~(page - 1u);
+  size_t hi = sizeof(mmr_journal_header_t) + to * sizeof(mmr_journal_record_t);
+  if (lo >= page) msync(base, page, MS_ASYNC);
+  msync(base + lo, hi - lo, MS_ASYNC);
+}
+
+// Background thread: closes retired files and renames them into place,
+// keeps a spare ready, and schedules writeback of the current file. It
+// drops the lock around every syscall, so journal_tick never waits on I/O.
+static void *journal_thread(void *arg) {
+  journal_t *j = (journal_t*)arg;
+  char next[600];
+  next_path(j, next, sizeof(next));
+  const uint8_t *synced_base = NULL;
+  uint64_t synced = 0;
+
+  pthread_mutex_lock(&j->lock);
+  for (;;) {
+    if (j->retired.fd >= 0) {
+      journal_file_t f = j->retired;
+      j->retired.fd = -1;
+      j->retired.base = NULL;
+      pthread_mutex_unlock(&j->lock);
+      file_close(&f);
+      rotate_files(j->path, j->keep);
+      if (rename(next, j->path) != 0) {
+        notify(NOTIFY_WARN, "journal: rename(%s, %s) failed: %s", next, j->path, strerror(errno));
+      }
+      pthread_mutex_lock(&j->lock);
+      continue;
+    }
+    if (j->stop) break;
+    if (j->spare.fd < 0 && !j->spare_failed) {
+      pthread_mutex_unlock(&j->lock);
+      journal_file_t f;
+      bool ok = file_create(j, next, &f);
+      if (!ok) notify(NOTIFY_ERR, "journal: cannot prepare the next file; events stop being recorded once %s fills", j->path);
+      pthread_mutex_lock(&j->lock);
+      if (ok) j->spare = f;
+      else __atomic_store_n(&j->spare_failed, true, __ATOMIC_RELAXED);
+      continue;
+    }
+
+    // only the current file is written to; a retired one was flushed whole
+    uint8_t *base = j->base;
+    uint64_t n = base ? __atomic_load_n(&j->hdr->count, __ATOMIC_ACQUIRE) : 0;
+    if (base != synced_base) {
+      synced_base = base;
+      synced = 0;
+    }
+    if (base && n != synced) {
+      pthread_mutex_unlock(&j->lock);
+      writeback(base, synced, n);
+      synced = n;
+      pthread_mutex_lock(&j->lock);
+    }
+
+    struct timespec until;
+    clock_gettime(CLOCK_MONOTONIC, &until);
+    until.tv_sec += JOURNAL_SYNC_S;
+    while (!j->stop && j->retired.fd < 0) {
+      if (pthread_cond_timedwait(&j->work, &j->lock, &until) == ETIMEDOUT) break;
+    }
+  }
+  pthread_mutex_unlock(&j->lock);
+  return NULL;
+}
+
+bool journal_open(journal_t *j, const char *path, size_t bytes_max, uint32_t keep) {
+  memset(j, 0, sizeof(*j));
+  j->fd = -1;
+  j->spare.fd = -1;
+  j->retired.fd = -1;
+
+  if (!path || !*path || strlen(path) >= sizeof(j->path) - 8) {
+    notify(NOTIFY_ERR, "journal: invalid path '%s'", path ? path : "");
+    return false;
+  }
+  snprintf(j->path, sizeof(j->path), "%s", path);
+
+  size_t recs = bytes_max > sizeof(mmr_journal_header_t)
+    ? (bytes_max - sizeof(mmr_journal_header_t)) / sizeof(mmr_journal_record_t) : 0;
+  if (recs < JOURNAL_MIN_RECORDS) recs = JOURNAL_MIN_RECORDS;
+  if (recs > 0x7FFFFFFFu) recs = 0x7FFFFFFFu;
+  j->capacity = (uint32_t)recs;
+  j->keep = keep;
+
+  if (file_exists(path)) rotate_files(path, keep);
+  journal_file_t f;
+  if (!file_create(j, path, &f)) return false;
+  header_start((mmr_journal_header_t*)f.base);
+  use_file(j, &f);
+
+  pthread_condattr_t ca;
+  pthread_condattr_init(&ca);
+  pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+  pthread_cond_init(&j->work, &ca);
+  pthread_condattr_destroy(&ca);
+  pthread_mutex_init(&j->lock, NULL);
+
+  int rc = pthread_create(&j->thread, NULL, journal_thread, j);
+  if (rc != 0) {
+    notify(NOTIFY_ERR, "journal: pthread_create failed: %s", strerror(rc));
+    file_close(&f);
+    pthread_cond_destroy(&j->work);
+    pthread_mutex_destroy(&j->lock);
+    j->fd = -1;
+    j->base = NULL;
+    j->hdr = NULL;
+    j->records = NULL;
+    return false;
+  }
+  return true;
+}
+
+void journal_close(journal_t *j) {
+  if (!j || !j->base) return;
+
+  pthread_mutex_lock(&j->lock);
+  j->stop = true;
+  pthread_cond_signal(&j->work);
+  pthread_mutex_unlock(&j->lock);
+  pthread_join(j->thread, NULL);   // finishes a pending rotation first
+
+  journal_file_t cur = { j->fd, j->base, j->map_size };
+  file_close(&cur);
+  if (j->spare.fd >= 0) {
+    char next[600];
+    next_path(j, next, sizeof(next));
+    munmap(j->spare.base, j->spare.map_size);
+    close(j->spare.fd);
+    unlink(next);
+  }
+  pthread_cond_destroy(&j->work);
+  pthread_mutex_destroy(&j->lock);
+  j->fd = -1;
+  j->base = NULL;
+  j->hdr = NULL;
+  j->records = NULL;
+}
+
+void journal_tick(journal_t *j) {
+  if (!j || !j->hdr) return;
+  if (j->hdr->count < (uint64_t)(j->capacity - headroom(j->capacity))) return;
+  // no spare is coming: stay off the thread's lock for the rest of the run
+  if (__atomic_load_n(&j->spare_failed, __ATOMIC_RELAXED)) return;
+
+  // Swap in the spare if the thread has one ready; until then records go
+  // into the headroom (and are dropped once that runs out too).
+  pthread_mutex_lock(&j->lock);
+  if (j->spare.fd >= 0 && j->retired.fd < 0) {
+    j->retired.fd = j->fd;
+    j->retired.base = j->base;
+    j->retired.map_size = j->map_size;
+    use_file(j, &j->spare);
+    j->spare.fd = -1;
+    j->spare.base = NULL;
+    header_start(j->hdr);
+    j->rotations++;
+    pthread_cond_signal(&j->work);
+  }
+  pthread_mutex_unlock(&j->lock);
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+// Binary event journal: every runtime event (unlocks, resets, pauses,
+// priming, leaderboard activity, core switches) appended as a fixed-size
+// record to a pre-sized, memory-mapped file.
+//
+// Layout (little-endian, fixed offsets; mmr-journal reads it):
+//   mmr_journal_header_t           at offset 0
+//   mmr_journal_record_t[capacity] at offset header_size
+//
+// Recording is a store into the mapping plus a release store of the header's
+// count, so a concurrent reader never sees a half-written record. The page
+// cache does the actual I/O. A background thread asks for writeback
+// (MS_ASYNC) every sync interval and does the file work of rotation; close
+// flushes synchronously. Each daemon run starts a fresh file (the previous
+// one is rotated to PATH.1, PATH.1 to PATH.2, ...), so within one file
+// frames and timestamps only grow and readers can binary-search them.
+//
+// Rotation never stalls the frame thread: the background thread creates the
+// next file ahead of time as PATH.next (header without magic), journal_tick
+// swaps it in when the current one is nearly full, and the thread then
+// flushes and trims the full file, shifts PATH.N and renames PATH.next to
+// PATH. Until it has, PATH is still the previous, complete file.
+
+#define MMR_JOURNAL_MAGIC    0x4C4E4A4Du  // 'MJNL'
+#define MMR_JOURNAL_VERSION  1u
+
+typedef enum {
+  MMR_JEV_SESSION_START = 1,     // id = core_id at startup
+  MMR_JEV_SESSION_END   = 2,
+  MMR_JEV_CORE_SWITCH   = 3,     // id = core_id, value = map_version
+  MMR_JEV_FRAME_GAP     = 4,     // --catch-up fell behind: id = frames behind, value = frames lost
+
+  MMR_JEV_ACH_TRIGGERED  = 16,
+  MMR_JEV_ACH_RESET      = 17,   // hit counts cleared by ResetIf
+  MMR_JEV_ACH_PAUSED     = 18,
+  MMR_JEV_ACH_ACTIVATED  = 19,
+  MMR_JEV_ACH_PRIMED     = 20,
+  MMR_JEV_ACH_UNPRIMED   = 21,
+  MMR_JEV_ACH_DISABLED   = 22,
+  MMR_JEV_ACH_PROGRESS   = 23,   // value = measured value
+
+  MMR_JEV_LB_STARTED   = 32,     // value = leaderboard value
+  MMR_JEV_LB_CANCELED  = 33,
+  MMR_JEV_LB_UPDATED   = 34,
+  MMR_JEV_LB_SUBMITTED = 35,
+  MMR_JEV_LB_DISABLED  = 36,
+} mmr_journal_event_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t header_size;     // offset of record 0
+  uint32_t record_size;
+  uint32_t capacity;        // records the file has room for
+  uint32_t writer_pid;
+  uint64_t count;           // committed records (release-stored after each append)
+  uint64_t start_mono_ns;   // CLOCK_MONOTONIC at open ...
+  uint64_t start_real_ns;   // ... and CLOCK_REALTIME at the same instant
+  uint8_t reserved[16];
+} mmr_journal_header_t;     // 64 bytes
+
+typedef struct {
+  uint64_t frame;           // daemon frame number
+  uint64_t mono_ns;         // CLOCK_MONOTONIC at the start of that frame
+  uint16_t type;            // mmr_journal_event_t
+  uint16_t core_id;
+  uint32_t id;              // achievement / leaderboard id
+  int32_t value;
+  uint32_t latency_us;      // frame publication (see journal_set_origin) to the
+                            // record, saturating; 0 = unknown, else >= 1
+} mmr_journal_record_t;     // 32 bytes
+
+typedef struct {
+  int fd;                   // -1 = none
+  uint8_t *base;
+  size_t map_size;
+} journal_file_t;
+
+typedef struct {
+  // the file being recorded into; swapped by journal_tick under lock
+  int fd;
+  uint8_t *base;
+  size_t map_size;
+  mmr_journal_header_t *hdr;
+  mmr_journal_record_t *records;
+
+  char path[512];
+  uint32_t capacity;
+  uint32_t keep;            // rotated files kept (PATH.1 .. PATH.keep)
+
+  // stamped onto every record; set once per frame by journal_begin_frame
+  uint64_t frame;
+  uint64_t mono_ns;
+  uint16_t core_id;
+  uint64_t origin_ns;       // CLOCK_MONOTONIC the frame was published (0 = unknown)
+
+  uint64_t dropped;         // records lost to a full file or a failed rotation
+  uint32_t rotations;
+
+  // background thread (rotation file work, writeback)
+  pthread_t thread;
+  pthread_mutex_t lock;     // everything below, and the current file's fields
+                            // when the thread reads them
+  pthread_cond_t work;      // a file was retired, or stop
+  journal_file_t spare;     // next file, ready to swap in (fd >= 0)
+  journal_file_t retired;   // full file the thread has not closed yet
+  bool spare_failed;        // creating it failed; not retried (atomic: read
+                            // by journal_tick without the lock)
+  bool stop;
+} journal_t;
+
+// Opens PATH as a fresh journal of bytes_max (rounded down to whole records),
+// rotating any existing file first, and starts the background thread.
+bool journal_open(journal_t *j, const char *path, size_t bytes_max, uint32_t keep);
+void journal_close(journal_t *j);
+
+static inline void journal_begin_frame(journal_t *j, uint64_t frame, uint64_t mono_ns, uint32_t core_id) {
+  j->frame = frame;
+  j->mono_ns = mono_ns;
+  j->core_id = (uint16_t)core_id;
+  j->origin_ns = 0;
+}
+
+// When the frame being evaluated was published; records of this frame then
+// carry their latency from it. Reset by journal_begin_frame.
+static inline void journal_set_origin(journal_t *j, uint64_t origin_ns) {
+  j->origin_ns = origin_ns;
+}
+
+// Appends one record. Never blocks and never makes a syscall (the latency
+// clock read is served by the vDSO); when the file is full the record is
+// counted as dropped (journal_tick rotates well before that happens).
+static inline void journal_record(journal_t *j, mmr_journal_event_t type, uint32_t id, int32_t value) {
+  if (!j) return;
+  uint64_t n = j->hdr ? j->hdr->count : 0;
+  if (!j->hdr || n >= j->capacity) {
+    j->dropped++;
+    return;
+  }
+  mmr_journal_record_t *r = &j->records[n];
+  r->frame = j->frame;
+  r->mono_ns = j->mono_ns;
+  r->type = (uint16_t)type;
+  r->core_id = j->core_id;
+  r->id = id;
+  r->value = value;
+  r->latency_us = 0;
+  if (j->origin_ns) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    uint64_t us = now > j->origin_ns ? (now - j->origin_ns) / 1000u : 0;
+    r->latency_us = us > UINT32_MAX ? UINT32_MAX : (us ? (uint32_t)us : 1u);
+  }
+  __atomic_store_n(&j->hdr->count, n + 1u, __ATOMIC_RELEASE);
+}
+
+// Once per frame, after events are recorded: when the file is nearly full,
+// swaps in the spare and hands the full one to the background thread. No
+// syscalls beyond waking that thread once per rotation.
+void journal_tick(journal_t *j);
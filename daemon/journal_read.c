@@ -0,0 +1,469 @@
+/*
+ * mmr-journal: query the binary event journal written by mmr-daemon
+ * --journal (see journal.h).
+ *
+ * Files are mapped read-only. Frames and timestamps only grow within a
+ * file, so --frames and --time ranges are found by binary search and only
+ * the matching slice is scanned.
+ *
+ *   ./mmr-journal /media/fat/mmr/logs/events.mjl
+ *   ./mmr-journal --type ach_triggered,lb_submitted events.mjl.2 events.mjl.1 events.mjl
+ *   ./mmr-journal --id 1234 --frames 1000:5000 events.mjl
+ *   ./mmr-journal --stats events.mjl
+ *   ./mmr-journal --follow events.mjl
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../kernel/mmr_memtap.h"
+#include "journal.h"
+#include "latency.h"
+#include "util.h"
+
+#define JEV_MAX 64u
+
+typedef struct {
+  mmr_journal_event_t type;
+  const char *name;
+} jev_name_t;
+
+static const jev_name_t k_names[] = {
+  { MMR_JEV_SESSION_START,  "session_start" },
+  { MMR_JEV_SESSION_END,    "session_end" },
+  { MMR_JEV_CORE_SWITCH,    "core_switch" },
+  { MMR_JEV_FRAME_GAP,      "frame_gap" },
+  { MMR_JEV_ACH_TRIGGERED,  "ach_triggered" },
+  { MMR_JEV_ACH_RESET,      "ach_reset" },
+  { MMR_JEV_ACH_PAUSED,     "ach_paused" },
+  { MMR_JEV_ACH_ACTIVATED,  "ach_activated" },
+  { MMR_JEV_ACH_PRIMED,     "ach_primed" },
+  { MMR_JEV_ACH_UNPRIMED,   "ach_unprimed" },
+  { MMR_JEV_ACH_DISABLED,   "ach_disabled" },
+  { MMR_JEV_ACH_PROGRESS,   "ach_progress" },
+  { MMR_JEV_LB_STARTED,     "lb_started" },
+  { MMR_JEV_LB_CANCELED,    "lb_canceled" },
+  { MMR_JEV_LB_UPDATED,     "lb_updated" },
+  { MMR_JEV_LB_SUBMITTED,   "lb_submitted" },
+  { MMR_JEV_LB_DISABLED,    "lb_disabled" },
+};
+#define NAME_COUNT (sizeof(k_names) / sizeof(k_names[0]))
+
+typedef struct {
+  uint64_t type_mask;       /* bit per type; 0 = all */
+  int has_id;
+  uint32_t id;
+  uint64_t frame_lo, frame_hi;
+  uint64_t real_lo_ns, real_hi_ns;
+  uint32_t tail;
+  int stats;
+  int follow;
+  int csv;
+} query_t;
+
+typedef struct {
+  const char *path;
+  int fd;
+  ino_t ino;
+  const uint8_t *base;
+  size_t size;
+  const mmr_journal_header_t *hdr;
+  const mmr_journal_record_t *records;
+} jfile_t;
+
+typedef struct {
+  uint64_t by_type[JEV_MAX];
+  uint64_t matched;
+  uint64_t first_frame, last_frame;
+  uint64_t first_real_ns, last_real_ns;
+  lat_hist_t latency;       /* records with a known latency_us */
+} stats_t;
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_signal(int sig) {
+  (void)sig;
+  g_stop = 1;
+}
+
+static const char *type_name(uint32_t type) {
+  for (size_t i = 0; i < NAME_COUNT; i++) {
+    if ((uint32_t)k_names[i].type == type) return k_names[i].name;
+  }
+  return "?";
+}
+
+static const char *core_name(uint32_t core_id) {
+  switch (core_id) {
+    case MMR_CORE_NES: return "nes";
+    case MMR_CORE_SNES: return "snes";
+    case MMR_CORE_GENESIS: return "genesis";
+    default: return "-";
+  }
+}
+
+/* "ach" / "lb" select every type with that prefix; anything else must match exactly */
+static int parse_types(const char *list, uint64_t *mask) {
+  char buf[512];
+  snprintf(buf, sizeof(buf), "%s", list);
+  for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+    int hit = 0;
+    size_t n = strlen(tok);
+    for (size_t i = 0; i < NAME_COUNT; i++) {
+      const char *name = k_names[i].name;
+      if (strcmp(name, tok) == 0 || (strncmp(name, tok, n) == 0 && name[n] == '_')) {
+        *mask |= 1ull << ((uint32_t)k_names[i].type % JEV_MAX);
+        hit = 1;
+      }
+    }
+    if (!hit) return 0;
+  }
+  return 1;
+}
+
+static int parse_u64(const char *s, uint64_t *out) {
+  if (!s || !*s) return 0;
+  errno = 0;
+  char *end = NULL;
+  unsigned long long v = strtoull(s, &end, 10);
+  if (errno != 0 || end == s || *end != '\0') return 0;
+  *out = (uint64_t)v;
+  return 1;
+}
+
+/* "A:B", "A:" or ":B" */
+static int parse_range(const char *s, uint64_t *lo, uint64_t *hi) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%s", s);
+  char *colon = strchr(buf, ':');
+  if (!colon) return 0;
+  *colon = 0;
+  *lo = 0;
+  *hi = UINT64_MAX;
+  if (buf[0] && !parse_u64(buf, lo)) return 0;
+  if (colon[1] && !parse_u64(colon + 1, hi)) return 0;
+  return *lo <= *hi;
+}
+
+static void jfile_close(jfile_t *f) {
+  if (f->base) munmap((void*)f->base, f->size);
+  if (f->fd >= 0) close(f->fd);
+  f->base = NULL;
+  f->fd = -1;
+}
+
+static int jfile_open(jfile_t *f, const char *path) {
+  memset(f, 0, sizeof(*f));
+  f->path = path;
+  f->fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (f->fd < 0) {
+    fprintf(stderr, "[ERR] open(%s) failed: %s\n", path, strerror(errno));
+    return 0;
+  }
+  struct stat st;
+  if (fstat(f->fd, &st) != 0 || (size_t)st.st_size < sizeof(mmr_journal_header_t)) {
+    fprintf(stderr, "[ERR] %s: not a journal (too short)\n", path);
+    jfile_close(f);
+    return 0;
+  }
+  f->ino = st.st_ino;
+  f->size = (size_t)st.st_size;
+  void *p = mmap(NULL, f->size, PROT_READ, MAP_SHARED, f->fd, 0);
+  if (p == MAP_FAILED) {
+    fprintf(stderr, "[ERR] mmap(%s) failed: %s\n", path, strerror(errno));
+    f->base = NULL;
+    jfile_close(f);
+    return 0;
+  }
+  f->base = (const uint8_t*)p;
+  f->hdr = (const mmr_journal_header_t*)p;
+
+  if (__atomic_load_n(&f->hdr->magic, __ATOMIC_ACQUIRE) != MMR_JOURNAL_MAGIC ||
+      f->hdr->version != MMR_JOURNAL_VERSION ||
+      f->hdr->record_size != sizeof(mmr_journal_record_t) ||
+      f->hdr->header_size < sizeof(mmr_journal_header_t) || f->hdr->header_size > f->size) {
+    fprintf(stderr, "[ERR] %s: not a version %u journal\n", path, MMR_JOURNAL_VERSION);
+    jfile_close(f);
+    return 0;
+  }
+  f->records = (const mmr_journal_record_t*)(f->base + f->hdr->header_size);
+  return 1;
+}
+
+/* committed records that are also inside the mapping */
+static uint64_t jfile_count(const jfile_t *f) {
+  uint64_t n = __atomic_load_n(&f->hdr->count, __ATOMIC_ACQUIRE);
+  uint64_t fit = (f->size - f->hdr->header_size) / sizeof(mmr_journal_record_t);
+  return n < fit ? n : fit;
+}
+
+static uint64_t real_ns(const jfile_t *f, const mmr_journal_record_t *r) {
+  return f->hdr->start_real_ns + (r->mono_ns - f->hdr->start_mono_ns);
+}
+
+/* first index in [lo, hi) whose key is >= want */
+static uint64_t lower_bound_frame(const jfile_t *f, uint64_t lo, uint64_t hi, uint64_t want) {
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2u;
+    if (f->records[mid].frame < want) lo = mid + 1u;
+    else hi = mid;
+  }
+  return lo;
+}
+
+static uint64_t lower_bound_real(const jfile_t *f, uint64_t lo, uint64_t hi, uint64_t want) {
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2u;
+    if (real_ns(f, &f->records[mid]) < want) lo = mid + 1u;
+    else hi = mid;
+  }
+  return lo;
+}
+
+static int matches(const query_t *q, const mmr_journal_record_t *r) {
+  if (q->type_mask && !(q->type_mask & (1ull << (r->type % JEV_MAX)))) return 0;
+  if (q->has_id && r->id != q->id) return 0;
+  return 1;
+}
+
+static void print_record(const query_t *q, const jfile_t *f, const mmr_journal_record_t *r) {
+  uint64_t rn = real_ns(f, r);
+  if (q->csv) {
+    printf("%" PRIu64 ",%" PRIu64 ",%s,%s,%u,%d,%u\n",
+           rn, r->frame, type_name(r->type), core_name(r->core_id), r->id, r->value, r->latency_us);
+    return;
+  }
+  time_t secs = (time_t)(rn / 1000000000ull);
+  struct tm tmv;
+  localtime_r(&secs, &tmv);
+  char ts[32];
+  strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &tmv);
+  char lat[32] = "";
+  if (r->latency_us) snprintf(lat, sizeof(lat), " latency=%uus", r->latency_us);
+  printf("%s.%03u frame=%-8" PRIu64 " %-7s %-14s id=%-8u value=%d%s\n",
+         ts, (unsigned)((rn / 1000000ull) % 1000u), r->frame, core_name(r->core_id),
+         type_name(r->type), r->id, r->value, lat);
+}
+
+static void account(stats_t *st, const jfile_t *f, const mmr_journal_record_t *r) {
+  uint64_t rn = real_ns(f, r);
+  if (st->matched == 0) {
+    st->first_frame = r->frame;
+    st->first_real_ns = rn;
+  }
+  st->last_frame = r->frame;
+  st->last_real_ns = rn;
+  st->by_type[r->type % JEV_MAX]++;
+  st->matched++;
+  if (r->latency_us) lat_add(&st->latency, (uint64_t)r->latency_us * 1000u);
+}
+
+/* Slice [*lo, *hi) of f selected by the frame/time ranges. */
+static void slice(const query_t *q, const jfile_t *f, uint64_t *lo, uint64_t *hi) {
+  uint64_t n = jfile_count(f);
+  *lo = 0;
+  *hi = n;
+  if (q->frame_lo) *lo = lower_bound_frame(f, *lo, *hi, q->frame_lo);
+  if (q->frame_hi != UINT64_MAX) *hi = lower_bound_frame(f, *lo, *hi, q->frame_hi + 1u);
+  if (q->real_lo_ns) *lo = lower_bound_real(f, *lo, *hi, q->real_lo_ns);
+  if (q->real_hi_ns != UINT64_MAX) *hi = lower_bound_real(f, *lo, *hi, q->real_hi_ns);
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+    "MiSTer Milestones journal reader (mmr-journal)\n"
+    "\n"
+    "Usage:\n"
+    "  %s [--type LIST] [--id N] [--frames A:B] [--time A:B] [--tail N]\n"
+    "     [--stats] [--follow] [--csv] FILE [FILE...]\n"
+    "\n"
+    "Options:\n"
+    "  --type LIST           comma-separated event types, or ach / lb for a whole group\n"
+    "                        (ach_triggered, ach_reset, lb_submitted, core_switch, ...)\n"
+    "  --id N                only this achievement / leaderboard id\n"
+    "  --frames A:B          frame range, either end optional (binary search)\n"
+    "  --time A:B            wall-clock range in unix seconds, either end optional\n"
+    "  --tail N              only the last N matching records\n"
+    "  --stats               per-type counts (and event latency) instead of records\n"
+    "  --follow              keep printing records as the daemon appends (last FILE)\n"
+    "  --csv                 real_ns,frame,type,core,id,value,latency_us\n"
+    "  -h, --help            show help\n"
+    "\n"
+    "Pass rotated files oldest first (PATH.2 PATH.1 PATH) to query across them.\n",
+    argv0);
+}
+
+static int run_query(const query_t *q, char **paths, int npaths) {
+  stats_t st;
+  memset(&st, 0, sizeof(st));
+
+  /* --tail: count matches first, then print from the right offset */
+  uint64_t total = 0;
+  if (q->tail) {
+    for (int i = 0; i < npaths; i++) {
+      jfile_t f;
+      if (!jfile_open(&f, paths[i])) return 1;
+      uint64_t lo, hi;
+      slice(q, &f, &lo, &hi);
+      for (uint64_t k = lo; k < hi; k++) total += matches(q, &f.records[k]);
+      jfile_close(&f);
+    }
+  }
+  uint64_t skip = (q->tail && total > q->tail) ? total - q->tail : 0;
+
+  if (q->csv && !q->stats) printf("real_ns,frame,type,core,id,value,latency_us\n");
+
+  jfile_t f;
+  memset(&f, 0, sizeof(f));
+  f.fd = -1;
+  uint64_t next = 0;
+  for (int i = 0; i < npaths; i++) {
+    if (!jfile_open(&f, paths[i])) return 1;
+    uint64_t lo, hi;
+    slice(q, &f, &lo, &hi);
+    for (uint64_t k = lo; k < hi; k++) {
+      const mmr_journal_record_t *r = &f.records[k];
+      if (!matches(q, r)) continue;
+      if (skip) {
+        skip--;
+        continue;
+      }
+      if (q->stats) account(&st, &f, r);
+      else print_record(q, &f, r);
+    }
+    next = jfile_count(&f);
+    if (i + 1 < npaths || !q->follow) jfile_close(&f);
+  }
+
+  if (q->follow) {
+    const char *path = paths[npaths - 1];
+    while (!g_stop) {
+      fflush(stdout);
+      sleep_ms(200);
+      uint64_t n = jfile_count(&f);
+      for (; next < n; next++) {
+        const mmr_journal_record_t *r = &f.records[next];
+        if (r->frame < q->frame_lo || r->frame > q->frame_hi || !matches(q, r)) continue;
+        print_record(q, &f, r);
+      }
+      /* the daemon rotated: PATH is a new file now */
+      struct stat sb;
+      if (stat(path, &sb) == 0 && sb.st_ino != f.ino) {
+        jfile_close(&f);
+        if (!jfile_open(&f, path)) return 1;
+        next = 0;
+      }
+    }
+    jfile_close(&f);
+  }
+
+  if (q->stats) {
+    printf("matched=%" PRIu64 "\n", st.matched);
+    if (st.matched) {
+      printf("frames=%" PRIu64 "..%" PRIu64 " span=%.1fs\n", st.first_frame, st.last_frame,
+             (double)(st.last_real_ns - st.first_real_ns) / 1e9);
+    }
+    for (size_t i = 0; i < NAME_COUNT; i++) {
+      uint64_t c = st.by_type[(uint32_t)k_names[i].type % JEV_MAX];
+      if (c) printf("  %-14s %" PRIu64 "\n", k_names[i].name, c);
+    }
+    if (st.latency.count) {
+      printf("latency n=%" PRIu64 " p50=%" PRIu64 "us p99=%" PRIu64 "us max=%" PRIu64 "us\n",
+             st.latency.count, lat_percentile(&st.latency, 50.0) / 1000u,
+             lat_percentile(&st.latency, 99.0) / 1000u, st.latency.max_ns / 1000u);
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  query_t q;
+  memset(&q, 0, sizeof(q));
+  q.frame_hi = UINT64_MAX;
+  q.real_hi_ns = UINT64_MAX;
+
+  int first_path = argc;
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+    if (strcmp(a, "-h") == 0 || strcmp(a, "--help") == 0) {
+      usage(argv[0]);
+      return 0;
+    }
+    if (strcmp(a, "--stats") == 0) { q.stats = 1; continue; }
+    if (strcmp(a, "--follow") == 0) { q.follow = 1; continue; }
+    if (strcmp(a, "--csv") == 0) { q.csv = 1; continue; }
+    if (a[0] != '-') {
+      first_path = i;
+      break;
+    }
+
+    if (!v) {
+      fprintf(stderr, "ERROR: %s requires a value\n", a);
+      return 2;
+    }
+
+    if (strcmp(a, "--type") == 0) {
+      if (!parse_types(v, &q.type_mask)) {
+        fprintf(stderr, "ERROR: invalid --type '%s'\n", v);
+        return 2;
+      }
+    } else if (strcmp(a, "--id") == 0) {
+      uint64_t id = 0;
+      if (!parse_u64(v, &id) || id > 0xFFFFFFFFull) {
+        fprintf(stderr, "ERROR: invalid --id '%s'\n", v);
+        return 2;
+      }
+      q.has_id = 1;
+      q.id = (uint32_t)id;
+    } else if (strcmp(a, "--frames") == 0) {
+      if (!parse_range(v, &q.frame_lo, &q.frame_hi)) {
+        fprintf(stderr, "ERROR: invalid --frames '%s' (A:B)\n", v);
+        return 2;
+      }
+    } else if (strcmp(a, "--time") == 0) {
+      uint64_t lo, hi;
+      if (!parse_range(v, &lo, &hi) || (hi != UINT64_MAX && hi > UINT64_MAX / 1000000000ull)) {
+        fprintf(stderr, "ERROR: invalid --time '%s' (unix seconds A:B)\n", v);
+        return 2;
+      }
+      q.real_lo_ns = lo * 1000000000ull;
+      q.real_hi_ns = (hi == UINT64_MAX) ? UINT64_MAX : hi * 1000000000ull;
+    } else if (strcmp(a, "--tail") == 0) {
+      uint64_t n = 0;
+      if (!parse_u64(v, &n) || n == 0 || n > 0xFFFFFFFFull) {
+        fprintf(stderr, "ERROR: invalid --tail '%s'\n", v);
+        return 2;
+      }
+      q.tail = (uint32_t)n;
+    } else {
+      fprintf(stderr, "ERROR: unknown option '%s'\n", a);
+      usage(argv[0]);
+      return 2;
+    }
+    i++;
+  }
+
+  if (first_path >= argc) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  return run_query(&q, argv + first_path, argc - first_path);
+}
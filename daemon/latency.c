@@ -0,0 +1,26 @@
+#include "latency.h"
+
+static uint64_t bucket_upper(uint32_t b) {
+  if (b < (1u << LAT_SUB_BITS)) return b;
+  uint32_t msb = b >> LAT_SUB_BITS;
+  uint32_t sub = b & ((1u << LAT_SUB_BITS) - 1u);
+  uint64_t step = 1ull << (msb - LAT_SUB_BITS);
+  return (((1ull << LAT_SUB_BITS) + sub) << (msb - LAT_SUB_BITS)) + step - 1u;
+}
+
+uint64_t lat_percentile(const lat_hist_t *h, double p) {
+  if (!h->count) return 0;
+  uint64_t rank = (uint64_t)((double)h->count * p / 100.0 + 0.5);
+  if (rank < 1) rank = 1;
+  if (rank > h->count) rank = h->count;
+
+  uint64_t seen = 0;
+  for (uint32_t b = 0; b < LAT_BUCKETS; b++) {
+    seen += h->buckets[b];
+    if (seen >= rank) {
+      uint64_t up = bucket_upper(b);
+      return up < h->max_ns ? up : h->max_ns;
+    }
+  }
+  return h->max_ns;
+}
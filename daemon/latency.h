@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+
+// Latency histograms for the frame path.
+//
+// Nanosecond samples go into log-linear buckets: four per power of two, so
+// a percentile read back is within 25% of the true value at any scale, and
+// recording is a count-leading-zeros and an increment (no allocation, safe
+// in the --realtime loop). Percentiles report the bucket's upper bound.
+
+#define LAT_SUB_BITS 2u
+#define LAT_BUCKETS  (64u << LAT_SUB_BITS)
+
+typedef struct {
+  uint64_t count;
+  uint64_t sum_ns;
+  uint64_t max_ns;
+  uint32_t buckets[LAT_BUCKETS];
+} lat_hist_t;
+
+static inline uint32_t lat_bucket(uint64_t ns) {
+  if (ns < (1u << LAT_SUB_BITS)) return (uint32_t)ns;
+  uint32_t msb = 63u - (uint32_t)__builtin_clzll(ns);
+  uint32_t sub = (uint32_t)(ns >> (msb - LAT_SUB_BITS)) & ((1u << LAT_SUB_BITS) - 1u);
+  return (msb << LAT_SUB_BITS) + sub;
+}
+
+static inline void lat_add(lat_hist_t *h, uint64_t ns) {
+  h->count++;
+  h->sum_ns += ns;
+  if (ns > h->max_ns) h->max_ns = ns;
+  h->buckets[lat_bucket(ns)]++;
+}
+
+// Upper bound of the bucket holding the p-th percentile (0 < p <= 100);
+// 0 for an empty histogram.
+uint64_t lat_percentile(const lat_hist_t *h, double p);
@@ -0,0 +1,353 @@
+/*
+ * mmr-loadgen: drive the loopback memtap driver with synthetic or recorded
+ * frames through MMR_IOCTL_PUBLISH, so the daemon can be exercised (and
+ * measured) at emulator-like rates without a running core.
+ *
+ * Load the driver with user_publish=1, then e.g.:
+ *   sudo ./mmr-loadgen --region nes --synthetic sparse --rate 60
+ *   sudo ./mmr-loadgen --region snes --trace smw.frames --loop --rate 0
+ *   sudo ./mmr-loadgen --core genesis --frames 600   # simulate a core switch
+ *
+ * A trace file is a raw concatenation of region-sized frames (what
+ * `dd`-ing the region once per frame produces).
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "../kernel/mmr_memtap.h"
+#include "util.h"
+
+typedef enum {
+  PATTERN_STATIC = 0,  /* same bytes every frame: measures the no-change path */
+  PATTERN_SPARSE,      /* a few random bytes per frame, like real game RAM */
+  PATTERN_FULL,        /* every byte changes: worst case for dirty tracking */
+} pattern_t;
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_signal(int sig) {
+  (void)sig;
+  g_stop = 1;
+}
+
+static void install_signal_handlers(void) {
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+}
+
+static uint32_t region_id_from_str(const char *s) {
+  if (!s) return MMR_REGION_NONE;
+  if (strcmp(s, "nes") == 0) return MMR_REGION_NES_CPU_RAM;
+  if (strcmp(s, "snes") == 0) return MMR_REGION_SNES_WRAM;
+  if (strcmp(s, "genesis") == 0) return MMR_REGION_GEN_68K_RAM;
+  return MMR_REGION_NONE;
+}
+
+static uint32_t core_id_from_str(const char *s) {
+  if (!s) return MMR_CORE_UNKNOWN;
+  if (strcmp(s, "nes") == 0) return MMR_CORE_NES;
+  if (strcmp(s, "snes") == 0) return MMR_CORE_SNES;
+  if (strcmp(s, "genesis") == 0) return MMR_CORE_GENESIS;
+  return MMR_CORE_UNKNOWN;
+}
+
+static int parse_u32(const char *s, uint32_t *out) {
+  if (!s || !*s || !out) return 0;
+  errno = 0;
+  char *end = NULL;
+  unsigned long v = strtoul(s, &end, 10);
+  if (errno != 0) return 0;
+  if (end == s || *end != '\0') return 0;
+  if (v > 0xFFFFFFFFul) return 0;
+  *out = (uint32_t)v;
+  return 1;
+}
+
+/* xorshift32: deterministic per --seed, cheap enough for --rate 0 */
+static uint32_t xorshift32(uint32_t *s) {
+  uint32_t x = *s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *s = x;
+  return x;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+    "MiSTer Milestones load generator (mmr-loadgen)\n"
+    "\n"
+    "Usage:\n"
+    "  %s --region nes|snes|genesis [--synthetic static|sparse|full | --trace FILE [--loop]]\n"
+    "     [--dev PATH] [--core NAME] [--rate HZ] [--frames N] [--dirty-bytes N] [--seed N]\n"
+    "\n"
+    "Options:\n"
+    "  --dev PATH            memtap device path (default: /dev/mmr_memtap)\n"
+    "  --region NAME         region to publish into: nes|snes|genesis\n"
+    "  --core NAME           switch the driver's core_id first (MMR_IOCTL_SET_CORE);\n"
+    "                        also picks that core's region when --region is omitted\n"
+    "  --synthetic NAME      generated frames (default: sparse)\n"
+    "  --trace FILE          replay raw region-sized frames from FILE\n"
+    "  --loop                restart the trace at EOF instead of stopping\n"
+    "  --rate HZ             publish rate, 0 = as fast as possible (default: 60)\n"
+    "  --frames N            stop after N frames (default: until Ctrl-C / EOF)\n"
+    "  --dirty-bytes N       bytes mutated per frame in sparse mode (default: 16)\n"
+    "  --seed N              PRNG seed for synthetic frames (default: 1)\n"
+    "  -h, --help            show help\n",
+    argv0);
+}
+
+static int get_region_size(int fd, uint32_t region_id, uint32_t *out_size) {
+  struct mmr_info info;
+  memset(&info, 0, sizeof(info));
+  if (ioctl(fd, MMR_IOCTL_GET_INFO, &info) != 0) return 0;
+  if (info.region_count == 0 || info.region_count > MMR_MAX_REGIONS) return 0;
+
+  struct mmr_region_desc regions[MMR_MAX_REGIONS];
+  memset(regions, 0, sizeof(regions));
+  if (ioctl(fd, MMR_IOCTL_GET_REGIONS, regions) != 0) return 0;
+
+  for (uint32_t i = 0; i < info.region_count; i++) {
+    if (regions[i].region_id == region_id) {
+      *out_size = regions[i].size_bytes;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Fill buf with the next trace frame; rewinds on EOF when looping. */
+static int next_trace_frame(FILE *fp, uint8_t *buf, uint32_t size, int loop) {
+  for (int attempt = 0; attempt < 2; attempt++) {
+    size_t n = fread(buf, 1, size, fp);
+    if (n == size) return 1;
+    if (!loop || n != 0) return 0;  /* truncated last frame ends the replay */
+    rewind(fp);
+  }
+  return 0;
+}
+
+static void next_synthetic_frame(pattern_t pat, uint8_t *buf, uint32_t size,
+                                 uint32_t dirty_bytes, uint32_t *rng) {
+  switch (pat) {
+    case PATTERN_STATIC:
+      break;
+    case PATTERN_SPARSE:
+      for (uint32_t i = 0; i < dirty_bytes; i++) {
+        uint32_t r = xorshift32(rng);
+        buf[r % size] = (uint8_t)(r >> 24);
+      }
+      break;
+    case PATTERN_FULL:
+      for (uint32_t i = 0; i + 4 <= size; i += 4) {
+        uint32_t r = xorshift32(rng);
+        memcpy(buf + i, &r, 4);
+      }
+      break;
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *dev_path = "/dev/mmr_memtap";
+  const char *region_str = NULL;
+  const char *core_str = NULL;
+  const char *trace_path = NULL;
+  pattern_t pattern = PATTERN_SPARSE;
+  uint32_t rate = 60;
+  uint32_t max_frames = 0;
+  uint32_t dirty_bytes = 16;
+  uint32_t seed = 1;
+  int loop = 0;
+
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+    if (strcmp(a, "-h") == 0 || strcmp(a, "--help") == 0) {
+      usage(argv[0]);
+      return 0;
+    }
+    if (strcmp(a, "--loop") == 0) {
+      loop = 1;
+      continue;
+    }
+
+    if (!v) {
+      fprintf(stderr, "ERROR: %s requires a value\n", a);
+      return 2;
+    }
+
+    if (strcmp(a, "--dev") == 0) {
+      dev_path = v;
+    } else if (strcmp(a, "--region") == 0) {
+      region_str = v;
+    } else if (strcmp(a, "--core") == 0) {
+      core_str = v;
+    } else if (strcmp(a, "--trace") == 0) {
+      trace_path = v;
+    } else if (strcmp(a, "--synthetic") == 0) {
+      if (strcmp(v, "static") == 0) pattern = PATTERN_STATIC;
+      else if (strcmp(v, "sparse") == 0) pattern = PATTERN_SPARSE;
+      else if (strcmp(v, "full") == 0) pattern = PATTERN_FULL;
+      else {
+        fprintf(stderr, "ERROR: invalid --synthetic '%s' (static|sparse|full)\n", v);
+        return 2;
+      }
+    } else if (strcmp(a, "--rate") == 0) {
+      if (!parse_u32(v, &rate) || rate > 100000) {
+        fprintf(stderr, "ERROR: invalid --rate '%s' (0..100000)\n", v);
+        return 2;
+      }
+    } else if (strcmp(a, "--frames") == 0) {
+      if (!parse_u32(v, &max_frames)) {
+        fprintf(stderr, "ERROR: invalid --frames '%s'\n", v);
+        return 2;
+      }
+    } else if (strcmp(a, "--dirty-bytes") == 0) {
+      if (!parse_u32(v, &dirty_bytes)) {
+        fprintf(stderr, "ERROR: invalid --dirty-bytes '%s'\n", v);
+        return 2;
+      }
+    } else if (strcmp(a, "--seed") == 0) {
+      if (!parse_u32(v, &seed) || seed == 0) {
+        fprintf(stderr, "ERROR: invalid --seed '%s' (must be non-zero)\n", v);
+        return 2;
+      }
+    } else {
+      fprintf(stderr, "ERROR: unknown option '%s'\n", a);
+      usage(argv[0]);
+      return 2;
+    }
+    i++;
+  }
+
+  uint32_t core_id = core_id_from_str(core_str);
+  if (core_str && core_id == MMR_CORE_UNKNOWN) {
+    fprintf(stderr, "ERROR: invalid --core '%s' (use nes|snes|genesis)\n", core_str);
+    return 2;
+  }
+  if (!region_str) region_str = core_str;
+
+  uint32_t region_id = region_id_from_str(region_str);
+  if (region_id == MMR_REGION_NONE) {
+    fprintf(stderr, "ERROR: --region nes|snes|genesis is required\n");
+    return 2;
+  }
+
+  int fd = open(dev_path, O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    fprintf(stderr, "[ERR] open(%s) failed: %s\n", dev_path, strerror(errno));
+    return 1;
+  }
+
+  if (core_id != MMR_CORE_UNKNOWN && ioctl(fd, MMR_IOCTL_SET_CORE, &core_id) != 0) {
+    fprintf(stderr, "[ERR] MMR_IOCTL_SET_CORE(%s) failed: %s\n", core_str, strerror(errno));
+    close(fd);
+    return 1;
+  }
+
+  uint32_t size = 0;
+  if (!get_region_size(fd, region_id, &size) || size == 0) {
+    fprintf(stderr, "[ERR] region %s not exposed by %s (load the driver with user_publish=1)\n",
+            region_str, dev_path);
+    close(fd);
+    return 1;
+  }
+
+  FILE *trace = NULL;
+  if (trace_path) {
+    trace = fopen(trace_path, "rb");
+    if (!trace) {
+      fprintf(stderr, "[ERR] open(%s) failed: %s\n", trace_path, strerror(errno));
+      close(fd);
+      return 1;
+    }
+  }
+
+  uint8_t *buf = calloc(1, size);
+  if (!buf) {
+    fprintf(stderr, "[ERR] out of memory (%u bytes)\n", size);
+    if (trace) fclose(trace);
+    close(fd);
+    return 1;
+  }
+
+  install_signal_handlers();
+
+  fprintf(stderr, "[INFO] mmr-loadgen: region=%s size=%u source=%s rate=%u%s\n",
+          region_str, size, trace_path ? trace_path : "synthetic", rate,
+          rate == 0 ? " (max)" : "");
+
+  const uint64_t period_ns = rate ? 1000000000ull / rate : 0;
+  const uint64_t t_start = now_ns();
+  uint64_t deadline = t_start;
+  uint64_t frames = 0;
+  uint64_t late = 0;
+  uint64_t lat_sum_ns = 0;
+  uint64_t lat_max_ns = 0;
+  uint32_t rng = seed;
+  int rc = 0;
+
+  while (!g_stop && (max_frames == 0 || frames < max_frames)) {
+    if (trace) {
+      if (!next_trace_frame(trace, buf, size, loop)) break;
+    } else {
+      next_synthetic_frame(pattern, buf, size, dirty_bytes, &rng);
+    }
+
+    struct mmr_publish_req req;
+    memset(&req, 0, sizeof(req));
+    req.region_id = region_id;
+    req.size = size;
+    req.data_ptr = (uint64_t)(uintptr_t)buf;
+
+    uint64_t t0 = now_ns();
+    if (ioctl(fd, MMR_IOCTL_PUBLISH, &req) != 0) {
+      if (errno == EINTR) continue;
+      fprintf(stderr, "[ERR] MMR_IOCTL_PUBLISH failed: %s\n", strerror(errno));
+      rc = 1;
+      break;
+    }
+    uint64_t dt = now_ns() - t0;
+    lat_sum_ns += dt;
+    if (dt > lat_max_ns) lat_max_ns = dt;
+    frames++;
+
+    if (period_ns) {
+      deadline += period_ns;
+      uint64_t now = now_ns();
+      if (now > deadline) {
+        /* fell behind: count it and re-anchor instead of bursting to catch up */
+        late++;
+        deadline = now;
+      } else {
+        sleep_until_ns(deadline);
+      }
+    }
+  }
+
+  uint64_t elapsed_ns = now_ns() - t_start;
+  double secs = (double)elapsed_ns / 1e9;
+  fprintf(stderr,
+          "[INFO] mmr-loadgen: frames=%" PRIu64 " elapsed=%.3fs rate=%.1f/s late=%" PRIu64
+          " publish_avg=%.1fus publish_max=%.1fus\n",
+          frames, secs, secs > 0 ? (double)frames / secs : 0.0, late,
+          frames ? (double)lat_sum_ns / (double)frames / 1000.0 : 0.0,
+          (double)lat_max_ns / 1000.0);
+
+  free(buf);
+  if (trace) fclose(trace);
+  close(fd);
+  return rc;
+}
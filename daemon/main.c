@@ -5,10 +5,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "../kernel/mmr_memtap.h"
+#include "achlib.h"
+#include "adapters.h"
+#include "broker.h"
 #include "engine.h"
+#include "governor.h"
+#include "journal.h"
+#include "latency.h"
 #include "memtap.h"
+#include "notify.h"
+#include "progress.h"
+#include "romhash.h"
+#include "rt.h"
+#include "snapshot.h"
 #include "util.h"
 
 #ifndef MMR_VERSION
@@ -16,18 +28,37 @@
 #endif
 
 static volatile sig_atomic_t g_stop = 0;
+static volatile sig_atomic_t g_profile_dump = 0;   /* SIGUSR1 with --profile-triggers */
+
+/* --realtime: polled frames before the allocation count is frozen (also
+ * re-armed after a core switch), and the preallocated stdout buffer */
+#define RT_WARMUP_FRAMES 120u
+
+/* consecutive frames whose memory could not be read before the daemon gives
+ * up; a single failed read only skips its frame */
+#define READ_FAIL_MAX 60u
+static char g_rt_stdout_buf[16384];
 
 static void on_signal(int sig) {
   (void)sig;
   g_stop = 1;
 }
 
-static void install_signal_handlers(void) {
+static void on_profile_signal(int sig) {
+  (void)sig;
+  g_profile_dump = 1;
+}
+
+static void install_signal_handlers(bool profile) {
   struct sigaction sa;
   memset(&sa, 0, sizeof(sa));
   sa.sa_handler = on_signal;
   sigaction(SIGINT, &sa, NULL);
   sigaction(SIGTERM, &sa, NULL);
+  if (profile) {
+    sa.sa_handler = on_profile_signal;
+    sigaction(SIGUSR1, &sa, NULL);
+  }
 }
 
 static uint32_t core_id_from_str(const char *s) {
@@ -98,8 +129,47 @@ static void usage(const char *argv0) {
     "  --backend NAME        ra|none (default: ra)\n"
     "  --fps N               evaluation rate (default: 60)\n"
     "  --only-on-change      only evaluate when snapshot changes\n"
+    "  --fast-forward        like --only-on-change, but unchanged frames still advance\n"
+    "                        hit counts and timers (applied analytically)\n"
+    "  --catch-up            evaluate every frame the driver published: after falling\n"
+    "                        behind, read the missed ones back from its frame history\n"
+    "                        and evaluate them in order (device mode; reads whole frames)\n"
+    "  --profile-triggers    sample the evaluation cost of every achievement, leaderboard\n"
+    "                        and rich presence; report the costliest at exit and on SIGUSR1\n"
+    "  --profile-top N       entries in that report (default: 10, max: 64)\n"
+    "  --paged               read RAM pages on demand as achievements touch them\n"
+    "                        (automatic for regions of 1 MiB and up; not with --broker)\n"
+    "  --realtime            mlockall, SCHED_FIFO, pinned frame thread; exit if the\n"
+    "                        frame loop allocates after warm-up\n"
+    "  --rt-cpu N            CPU for --realtime (default: last online CPU)\n"
+    "  --rt-prio N           SCHED_FIFO priority for --realtime (default: 10)\n"
+    "  --cpu-budget PCT      adapt cadence/shed work to stay under PCT%% of one core\n"
+    "                        per frame (0 = off, the default)\n"
     "  --log-every N         log every N frames (0 disables; default: 60)\n"
     "  --ach-file PATH       load achievements from a .ach file (replaces builtins)\n"
+    "  --rom PATH            identify the running game by its ROM's RetroAchievements\n"
+    "                        hash; with --ach-dir, DIR/<hash>.ach is loaded for it\n"
+    "  --ach-lib PATH        library of sets by game hash (built with mmr-achpack);\n"
+    "                        with --rom, the game's set comes from it unless\n"
+    "                        --ach-file or DIR/<hash>.ach supplies one\n"
+    "  --hash-cache PATH     keep ROM hashes in PATH, keyed by path, size and mtime, so\n"
+    "                        only new or changed ROMs are hashed\n"
+    "  --rom-dir DIR         pre-hash every ROM under DIR in the background at idle\n"
+    "                        priority (into --hash-cache)\n"
+    "  --hash-threads N      threads for --rom-dir (default: 2, max: 8)\n"
+    "  --set-arena           build each loaded set in one allocation, laid out in\n"
+    "                        evaluation order (one free per set on reload/exit)\n"
+    "  --broker NAME         republish each frame to /dev/shm/NAME for local readers\n"
+    "                        (tools/broker_read.py; e.g. --broker " MMR_BROKER_DEFAULT_NAME ")\n"
+    "  --progress NAME       publish every achievement's state and measured progress to\n"
+    "                        /dev/shm/NAME after each evaluated frame, for overlays\n"
+    "                        (tools/progress_read.py; e.g. --progress " MMR_PROGRESS_DEFAULT_NAME ")\n"
+    "  --journal PATH        append every runtime event to a binary journal at PATH\n"
+    "                        (read it with mmr-journal)\n"
+    "  --journal-size MIB    rotate the journal at this size (default: 1)\n"
+    "  --journal-keep N      rotated journals kept as PATH.1..PATH.N (default: 4)\n"
+    "  --ach-dir DIR         per-core sets DIR/nes.ach, DIR/snes.ach, DIR/genesis.ach,\n"
+    "                        all loaded at startup so core switches are instant\n"
     "  --print-config        print resolved config and exit\n"
     "  --version             print version and exit\n"
     "  -h, --help            show help\n",
@@ -116,8 +186,264 @@ static uint32_t fnv1a32(const uint8_t *p, size_t n) {
   return h;
 }
 
+/* ----- per-core slots -----
+ *
+ * Every supported core gets its engine built and its set loaded at startup.
+ * When GET_INFO reports a new core_id/map_version, switching is a region
+ * lookup, a SELECT_REGION and a pointer swap; no parsing on the hot path.
+ */
+
+static const uint32_t k_slot_cores[] = { MMR_CORE_NES, MMR_CORE_SNES, MMR_CORE_GENESIS };
+#define CORE_SLOTS (sizeof(k_slot_cores) / sizeof(k_slot_cores[0]))
+
+typedef struct {
+  uint32_t core_id;
+  engine_t *eng;
+  uint32_t region_id;   /* region plan, resolved when the core becomes active */
+  uint32_t size;
+  bool paged;           /* evaluated through the snapshot, not a full copy */
+  uint64_t ev_dropped;  /* engine_dropped_events already warned about */
+} core_slot_t;
+
+typedef enum {
+  PAGING_OFF = 0,       /* --broker needs every frame in full */
+  PAGING_AUTO,          /* regions >= SNAPSHOT_PAGED_AUTO_BYTES */
+  PAGING_ON,            /* --paged */
+} paging_t;
+
+static core_slot_t *slot_for_core(core_slot_t *slots, uint32_t core_id) {
+  for (size_t i = 0; i < CORE_SLOTS; i++) {
+    if (slots[i].core_id == core_id) return &slots[i];
+  }
+  return NULL;
+}
+
+static void destroy_slots(core_slot_t *slots) {
+  for (size_t i = 0; i < CORE_SLOTS; i++) {
+    engine_destroy(slots[i].eng);
+    slots[i].eng = NULL;
+  }
+}
+
+/* The start core's set: a file, or text mapped from --ach-lib (labelled
+ * name), or neither. */
+typedef struct {
+  const char *path;
+  const char *text;
+  size_t len;
+  const char *name;
+} start_set_t;
+
+/* start (if any) applies to start_core; ach_dir/<core>.ach to the others. */
+static bool build_slots(core_slot_t *slots, engine_backend_t backend, uint32_t start_core,
+                        const start_set_t *start, const char *ach_dir, bool set_arena) {
+  memset(slots, 0, CORE_SLOTS * sizeof(*slots));
+
+  for (size_t i = 0; i < CORE_SLOTS; i++) {
+    core_slot_t *s = &slots[i];
+    s->core_id = k_slot_cores[i];
+    s->region_id = expected_region_for_core(s->core_id);
+
+    if (!engine_init(&s->eng, backend, s->core_id)) {
+      fprintf(stderr, "ERR: engine_init(%s) failed\n", core_str_from_id(s->core_id));
+      destroy_slots(slots);
+      return false;
+    }
+    engine_set_arena(s->eng, set_arena);
+
+    /* Load achievements: file overrides builtins */
+    if (s->core_id == start_core && start->path && *start->path) {
+      (void)engine_load_ach_file(s->eng, start->path);
+    } else if (s->core_id == start_core && start->text) {
+      (void)engine_load_ach_text(s->eng, start->text, start->len, start->name);
+    } else if (ach_dir && *ach_dir) {
+      char path[1024];
+      snprintf(path, sizeof(path), "%s/%s.ach", ach_dir, core_str_from_id(s->core_id));
+      if (file_exists(path)) (void)engine_load_ach_file(s->eng, path);
+    }
+
+    if (!engine_load_builtin(s->eng)) {
+      fprintf(stderr, "ERR: engine_load_builtin failed\n");
+      destroy_slots(slots);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* --rom: the running game's hash (into hash_out, "" if unknown), from the
+ * cache or computed now. With --ach-dir, DIR/<hash>.ach is that game's own
+ * set; set_path gets it if it exists, "" otherwise. */
+static void identify_rom(const char *rom, const char *cache_path, uint32_t core_id, const char *ach_dir,
+                         char hash_out[33], char *set_path, size_t set_cap) {
+  hash_out[0] = 0;
+  set_path[0] = 0;
+
+  adapter_desc_t ad;
+  bool known = core_id != MMR_CORE_UNKNOWN ? adapter_get(core_id, &ad) : adapter_for_rom(rom, &ad);
+  if (!known) {
+    fprintf(stderr, "[WARN] rom %s: no core to hash it for\n", rom);
+    return;
+  }
+
+  romhash_t rh;
+  if (!romhash_open(&rh, cache_path)) return;
+  char hash[33];
+  bool cached = false;
+  uint64_t t0 = now_ns();
+  bool ok = romhash_identify(&rh, rom, ad.rc_console, hash, &cached);
+  uint64_t took = now_ns() - t0;
+  romhash_close(&rh);
+
+  if (!ok) {
+    fprintf(stderr, "[WARN] rom %s: could not hash it%s\n", rom, cached ? " (cached; retried once it changes)" : "");
+    return;
+  }
+  fprintf(stderr, "[INFO] rom %s: hash %s (%s in %.1f ms)\n", rom, hash, cached ? "cached" : "hashed",
+          (double)took / 1e6);
+  memcpy(hash_out, hash, sizeof(hash));
+
+  if (ach_dir && *ach_dir) {
+    snprintf(set_path, set_cap, "%s/%s.ach", ach_dir, hash);
+    if (!file_exists(set_path)) set_path[0] = 0;
+  }
+}
+
+/* Resolve the slot's region against the current map and select it. A paged
+ * slot binds the snapshot instead of sizing the frame buffer. */
+static bool activate_slot(memtap_t *mt, core_slot_t *s, paging_t paging, snapshot_t *snap,
+                          uint8_t **buf, uint32_t *buf_cap) {
+  struct mmr_region_desc regions[16];
+  uint32_t region_count = 0;
+  if (!memtap_get_regions(mt, regions, &region_count)) return false;
+
+  uint32_t size = 0;
+  for (uint32_t i = 0; i < region_count; i++) {
+    if (regions[i].region_id == s->region_id) {
+      size = regions[i].size_bytes;
+      break;
+    }
+  }
+  if (size == 0) {
+    fprintf(stderr, "[WARN] region %u not found in GET_REGIONS list\n", s->region_id);
+    return false;
+  }
+
+  /* every block read from now on is converted to RA's layout once */
+  adapter_desc_t ad;
+  mt->ingest = adapter_get(s->core_id, &ad) ? ad.ingest : NULL;
+
+  s->paged = (paging == PAGING_ON) || (paging == PAGING_AUTO && size >= SNAPSHOT_PAGED_AUTO_BYTES);
+  if (s->paged) {
+    if (!memtap_select_region(mt, s->region_id)) return false;
+    if (!snapshot_attach(snap, mt, size)) return false;
+    s->size = size;
+    return true;
+  }
+
+  if (size > *buf_cap) {
+    uint8_t *nbuf = (uint8_t*)realloc(*buf, size);
+    if (!nbuf) {
+      fprintf(stderr, "[ERR] realloc(%u) failed\n", size);
+      return false;
+    }
+    *buf = nbuf;
+    *buf_cap = size;
+  }
+  memset(*buf, 0, size);
+
+  if (!memtap_select_region(mt, s->region_id)) return false;
+  s->size = size;
+  return true;
+}
+
+/* Frame path stages, timed every frame. The origin of a frame is the
+ * driver's publish_ns for it when known, else the start of the read. */
+typedef enum {
+  LAT_ACQUIRE = 0,   /* origin -> frame copied into the buffer */
+  LAT_MEMREFS,       /* memref update (page fetches included when paged) */
+  LAT_EVALUATE,      /* triggers, leaderboards, rich presence */
+  LAT_DELIVER,       /* end of evaluation -> line written to stdout (per line) */
+  LAT_UNLOCK,        /* origin -> line written to stdout (per line) */
+  LAT_STAGES
+} lat_stage_t;
+
+static const char *const k_lat_stage_names[LAT_STAGES] = { "acquire", "memrefs", "evaluate", "deliver", "unlock" };
+static lat_hist_t g_lat[LAT_STAGES];
+
+static const uint8_t *snapshot_fetch_cb(void *ud, uint32_t address, uint32_t num_bytes) {
+  return snapshot_fetch((snapshot_t*)ud, address, num_bytes);
+}
+
+/* Queue everything the engine reported this frame, then rich presence if it
+ * changed, for the log writer, which times each line from origin and t_eval
+ * to stdout (LAT_UNLOCK, LAT_DELIVER). Returns the number of lines queued. */
+static uint32_t report_engine_output(engine_t *eng, uint64_t origin, uint64_t t_eval) {
+  engine_event_t ev;
+  uint32_t lines = 0;
+
+  while (engine_next_event(eng, &ev)) {
+    lines++;
+    switch (ev.type) {
+      case ENGINE_EVENT_ACHIEVEMENT_TRIGGERED:
+        notify_print_frame(origin, t_eval, "[ACH] id=%u triggered\n", ev.id);
+        break;
+      case ENGINE_EVENT_LBOARD_STARTED:
+        notify_print_frame(origin, t_eval, "[LB] id=%u started: %s\n", ev.id, ev.title);
+        break;
+      case ENGINE_EVENT_LBOARD_CANCELED:
+        notify_print_frame(origin, t_eval, "[LB] id=%u canceled: %s\n", ev.id, ev.title);
+        break;
+      case ENGINE_EVENT_LBOARD_SUBMITTED:
+        notify_print_frame(origin, t_eval, "[LB] id=%u submitted value=%s: %s\n", ev.id, ev.value_str, ev.title);
+        break;
+      case ENGINE_EVENT_ACHIEVEMENT_PROGRESS:
+        notify_print_frame(origin, t_eval, "[PROGRESS] id=%u %s: %s\n", ev.id, ev.value_str, ev.title);
+        break;
+    }
+  }
+
+  bool rp_changed = false;
+  const char *rp = engine_richpresence(eng, &rp_changed);
+  if (rp && rp_changed) {
+    notify_print_frame(origin, t_eval, "[RP] %s\n", rp);
+    lines++;
+  }
+  return lines;
+}
+
+/* --profile-triggers report for one core's set */
+static void report_profile(const core_slot_t *s, uint32_t top) {
+  engine_profile_row_t rows[ENGINE_PROFILE_TOP_MAX];
+  engine_profile_summary_t sum;
+  size_t n = engine_profile_top(s->eng, rows, top, &sum);
+  if (!sum.samples) return;
+
+  notify_print("[PROFILE] %s: frames=%" PRIu64 " samples=%" PRIu64 " entries=%.1fus memrefs=%.1fus (mean per sample)\n",
+               core_str_from_id(s->core_id), sum.frames, sum.samples,
+               (double)sum.entries_ns / (double)sum.samples / 1e3, (double)sum.memrefs_ns / (double)sum.samples / 1e3);
+  for (size_t i = 0; i < n; i++) {
+    const engine_profile_row_t *r = &rows[i];
+    notify_print("[PROFILE] %2zu. %-3s id=%-8u mean=%.2fus max=%.2fus share=%.1f%% conds=%.1f memrefs=%u %s\n",
+                 i + 1, r->kind, r->id, (double)r->total_ns / (double)r->samples / 1e3, (double)r->max_ns / 1e3,
+                 sum.entries_ns ? 100.0 * (double)r->total_ns / (double)sum.entries_ns : 0.0,
+                 (double)r->conds / (double)r->samples, r->memrefs, r->title);
+  }
+}
+
 int main(int argc, char **argv) {
   const char *ach_file_cli = NULL;
+  const char *ach_dir = NULL;
+  const char *ach_lib = NULL;
+  const char *broker_name = NULL;
+  const char *progress_name = NULL;
+  const char *rom_path = NULL;
+  const char *rom_dir = NULL;
+  const char *hash_cache = NULL;
+  uint32_t hash_threads = ROMHASH_THREADS_DEFAULT;
+  const char *journal_path = NULL;
+  uint32_t journal_mib = 1;
+  uint32_t journal_keep = 4;
 
   const char *dev_path = "/dev/mmr_memtap";
   const char *mock_dir = NULL;
@@ -126,7 +452,16 @@ int main(int argc, char **argv) {
 
   uint32_t fps = 60;
   uint32_t log_every = 60;
+  uint32_t cpu_budget = 0;
+  int realtime = 0;
+  rt_config_t rt_cfg = { .cpu = -1, .priority = 10 };
+  int rt_cpu_explicit = 0;
   int only_on_change = 0;
+  int fast_forward = 0;
+  int catch_up = 0;
+  int set_arena = 0;
+  uint32_t profile_top = 0;   /* 0: --profile-triggers off */
+  int paged = 0;
   int print_config = 0;
   int dev_explicit = 0;
 
@@ -142,6 +477,89 @@ int main(int argc, char **argv) {
       continue;
     }
 
+    if (strcmp(a, "--ach-dir") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: --ach-dir requires a directory\n");
+        return 2;
+      }
+      ach_dir = argv[++i];
+      continue;
+    }
+
+    if (strcmp(a, "--ach-lib") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: --ach-lib requires a path\n");
+        return 2;
+      }
+      ach_lib = argv[++i];
+      continue;
+    }
+
+    if (strcmp(a, "--rom") == 0 || strcmp(a, "--rom-dir") == 0 || strcmp(a, "--hash-cache") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: %s requires a path\n", a);
+        return 2;
+      }
+      if (strcmp(a, "--rom") == 0) rom_path = argv[++i];
+      else if (strcmp(a, "--rom-dir") == 0) rom_dir = argv[++i];
+      else hash_cache = argv[++i];
+      continue;
+    }
+
+    if (strcmp(a, "--hash-threads") == 0) {
+      if (i + 1 >= argc || !parse_u32(argv[i + 1], &hash_threads) ||
+          hash_threads < 1 || hash_threads > ROMHASH_THREADS_MAX) {
+        fprintf(stderr, "ERROR: --hash-threads requires N in 1..%u\n", ROMHASH_THREADS_MAX);
+        return 2;
+      }
+      i++;
+      continue;
+    }
+
+    if (strcmp(a, "--broker") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: --broker requires a segment name\n");
+        return 2;
+      }
+      broker_name = argv[++i];
+      continue;
+    }
+
+    if (strcmp(a, "--progress") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: --progress requires a segment name\n");
+        return 2;
+      }
+      progress_name = argv[++i];
+      continue;
+    }
+
+    if (strcmp(a, "--journal") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: --journal requires a path\n");
+        return 2;
+      }
+      journal_path = argv[++i];
+      continue;
+    }
+
+    if (strcmp(a, "--journal-size") == 0 || strcmp(a, "--journal-keep") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: %s requires a number\n", a);
+        return 2;
+      }
+      uint32_t v = 0;
+      bool is_size = (strcmp(a, "--journal-size") == 0);
+      if (!parse_u32(argv[i + 1], &v) || (is_size ? (v < 1 || v > 1024) : v > 100)) {
+        fprintf(stderr, "ERROR: invalid %s '%s' (%s)\n", a, argv[i + 1], is_size ? "1..1024" : "0..100");
+        return 2;
+      }
+      if (is_size) journal_mib = v;
+      else journal_keep = v;
+      i++;
+      continue;
+    }
+
     if (strcmp(a, "--dev") == 0) {
       if (i + 1 >= argc) {
         fprintf(stderr, "ERROR: --dev requires a path\n");
@@ -209,11 +627,93 @@ int main(int argc, char **argv) {
       continue;
     }
 
+    if (strcmp(a, "--realtime") == 0) {
+      realtime = 1;
+      continue;
+    }
+
+    if (strcmp(a, "--rt-cpu") == 0 || strcmp(a, "--rt-prio") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: %s requires a number\n", a);
+        return 2;
+      }
+      uint32_t v = 0;
+      bool is_cpu = (strcmp(a, "--rt-cpu") == 0);
+      if (!parse_u32(argv[i + 1], &v) || (is_cpu ? v > 1023 : (v < 1 || v > 99))) {
+        fprintf(stderr, "ERROR: invalid %s '%s' (%s)\n", a, argv[i + 1], is_cpu ? "0..1023" : "1..99");
+        return 2;
+      }
+      if (is_cpu) {
+        rt_cfg.cpu = (int)v;
+        rt_cpu_explicit = 1;
+      } else {
+        rt_cfg.priority = (int)v;
+      }
+      i++;
+      continue;
+    }
+
+    if (strcmp(a, "--cpu-budget") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: --cpu-budget requires a percentage\n");
+        return 2;
+      }
+      uint32_t v = 0;
+      if (!parse_u32(argv[i + 1], &v) || v > 100) {
+        fprintf(stderr, "ERROR: invalid --cpu-budget '%s' (0..100)\n", argv[i + 1]);
+        return 2;
+      }
+      cpu_budget = v;
+      i++;
+      continue;
+    }
+
     if (strcmp(a, "--only-on-change") == 0) {
       only_on_change = 1;
       continue;
     }
 
+    if (strcmp(a, "--fast-forward") == 0) {
+      only_on_change = 1;
+      fast_forward = 1;
+      continue;
+    }
+
+    if (strcmp(a, "--catch-up") == 0) {
+      catch_up = 1;
+      continue;
+    }
+
+    if (strcmp(a, "--set-arena") == 0) {
+      set_arena = 1;
+      continue;
+    }
+
+    if (strcmp(a, "--profile-triggers") == 0) {
+      if (!profile_top) profile_top = 10;
+      continue;
+    }
+
+    if (strcmp(a, "--profile-top") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: --profile-top requires a number\n");
+        return 2;
+      }
+      uint32_t v = 0;
+      if (!parse_u32(argv[i + 1], &v) || v == 0 || v > ENGINE_PROFILE_TOP_MAX) {
+        fprintf(stderr, "ERROR: invalid --profile-top '%s' (1..%u)\n", argv[i + 1], ENGINE_PROFILE_TOP_MAX);
+        return 2;
+      }
+      profile_top = v;
+      i++;
+      continue;
+    }
+
+    if (strcmp(a, "--paged") == 0) {
+      paged = 1;
+      continue;
+    }
+
     if (strcmp(a, "--print-config") == 0) {
       print_config = 1;
       continue;
@@ -244,6 +744,15 @@ int main(int argc, char **argv) {
     return 2;
   }
 
+  if (catch_up && mock_dir) {
+    fprintf(stderr, "[WARN] --catch-up ignored: mock snapshots keep no frame history\n");
+    catch_up = 0;
+  }
+  if (ach_lib && !rom_path) {
+    fprintf(stderr, "[WARN] --ach-lib ignored: sets are looked up by the --rom hash\n");
+    ach_lib = NULL;
+  }
+
   uint32_t core_id = core_id_from_str(core_str);
   if (mock_dir && core_id == MMR_CORE_UNKNOWN) {
     fprintf(stderr, "ERROR: invalid --core '%s' (use nes|snes|genesis)\n", core_str ? core_str : "");
@@ -270,13 +779,39 @@ int main(int argc, char **argv) {
     printf("  core:           %s\n", mock_dir ? (core_str ? core_str : "unknown") : "auto");
     printf("  backend:        %s\n", backend_str_from_id(backend));
     printf("  fps:            %u\n", fps);
-    printf("  only_on_change: %s\n", only_on_change ? "yes" : "no");
+    printf("  only_on_change: %s\n", only_on_change ? (fast_forward ? "yes (fast-forward)" : "yes") : "no");
+    printf("  catch_up:       %s\n", catch_up ? "yes" : "no");
+    if (profile_top) printf("  profile:        top %u\n", profile_top);
+    else printf("  profile:        no\n");
+    printf("  paged:          %s\n", broker_name ? "no (broker)" : (paged ? "yes" : "auto"));
     printf("  log_every:      %u\n", log_every);
+    printf("  cpu_budget:     %u%%\n", cpu_budget);
+    printf("  realtime:       %s\n", realtime ? "yes" : "no");
     printf("  ach_file:       %s\n", (ach_path && *ach_path) ? ach_path : "");
+    printf("  ach_dir:        %s\n", ach_dir ? ach_dir : "");
+    printf("  ach_lib:        %s\n", ach_lib ? ach_lib : "");
+    printf("  set_arena:      %s\n", set_arena ? "yes" : "no");
+    printf("  rom:            %s\n", rom_path ? rom_path : "");
+    printf("  hash_cache:     %s\n", hash_cache ? hash_cache : "");
+    if (rom_dir) printf("  rom_dir:        %s (%u threads)\n", rom_dir, hash_threads);
+    else printf("  rom_dir:        \n");
+    printf("  broker:         %s\n", broker_name ? broker_name : "");
+    printf("  progress:       %s\n", progress_name ? progress_name : "");
+    printf("  journal:        %s\n", journal_path ? journal_path : "");
+    if (journal_path) printf("  journal_size:   %u MiB, keep %u\n", journal_mib, journal_keep);
     return 0;
   }
 
-  install_signal_handlers();
+  install_signal_handlers(profile_top != 0);
+
+  if (realtime) {
+    /* must precede any stdout output; keeps stdio from allocating later */
+    setvbuf(stdout, g_rt_stdout_buf, _IOLBF, sizeof(g_rt_stdout_buf));
+    if (!rt_cpu_explicit) {
+      long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+      rt_cfg.cpu = ncpu > 0 ? (int)ncpu - 1 : -1;
+    }
+  }
 
   memtap_t mt;
   memset(&mt, 0, sizeof(mt));
@@ -299,76 +834,171 @@ int main(int argc, char **argv) {
     }
   }
 
-  engine_t *eng = NULL;
-  if (!engine_init(&eng, backend, core_id)) {
-    fprintf(stderr, "ERR: engine_init failed\n");
-    memtap_close(&mt);
-    return 1;
+  char rom_set[1024];
+  char rom_hash[33] = "";
+  if (rom_path) {
+    identify_rom(rom_path, hash_cache, core_id, ach_dir, rom_hash, rom_set, sizeof(rom_set));
+    if (rom_set[0] && !(ach_path && *ach_path)) ach_path = rom_set;
   }
 
-  /* Load achievements: file overrides builtins */
-  if (ach_path && *ach_path) {
-    (void)engine_load_ach_file(eng, ach_path);
-  }
-  if (!engine_load_builtin(eng)) {
-    fprintf(stderr, "ERR: engine_load_builtin failed\n");
-    engine_destroy(eng);
-    memtap_close(&mt);
-    return 1;
+  /* the library is mapped only while the sets are built; the one set it
+   * supplies is parsed into the engine */
+  start_set_t start_set = { .path = ach_path };
+  achlib_t lib;
+  bool lib_open = false;
+  char lib_name[600];
+  if (ach_lib && rom_hash[0] && !(ach_path && *ach_path) && achlib_open(&lib, ach_lib)) {
+    lib_open = true;
+    if (achlib_find(&lib, rom_hash, &start_set.text, &start_set.len)) {
+      snprintf(lib_name, sizeof(lib_name), "%s:%s", ach_lib, rom_hash);
+      start_set.name = lib_name;
+      fprintf(stderr, "[INFO] ach library %s: set for %s (%zu bytes of %u sets)\n", ach_lib, rom_hash,
+              start_set.len, lib.count);
+    } else {
+      fprintf(stderr, "[INFO] ach library %s: no set for %s\n", ach_lib, rom_hash);
+    }
   }
 
-  struct mmr_region_desc regions[16];
-  uint32_t region_count = 0;
-  if (!memtap_get_regions(&mt, regions, &region_count)) {
-    fprintf(stderr, "ERR: memtap_get_regions failed\n");
-    engine_destroy(eng);
+  core_slot_t slots[CORE_SLOTS];
+  bool built = build_slots(slots, backend, core_id, &start_set, ach_dir, set_arena != 0);
+  if (lib_open) achlib_close(&lib);
+  if (!built) {
     memtap_close(&mt);
     return 1;
   }
+  if (fast_forward && backend == ENGINE_BACKEND_RA) {
+    for (size_t i = 0; i < CORE_SLOTS; i++) {
+      if (!engine_set_fast_forward(slots[i].eng, true)) {
+        fprintf(stderr, "[WARN] fast-forward unavailable for %s; unchanged frames are skipped outright\n",
+                core_str_from_id(slots[i].core_id));
+      }
+    }
+  }
+  if (profile_top && backend == ENGINE_BACKEND_RA) {
+    for (size_t i = 0; i < CORE_SLOTS; i++) {
+      if (!engine_set_profile(slots[i].eng, true)) {
+        fprintf(stderr, "[WARN] trigger profile unavailable for %s\n", core_str_from_id(slots[i].core_id));
+      }
+    }
+  }
 
+  /* Device mode may start before any supported core is loaded (MiSTer menu);
+   * that is not fatal any more, the loop picks the core up when it appears. */
   uint32_t want_region = expected_region_for_core(core_id);
-  if (want_region == MMR_REGION_NONE) {
-    fprintf(stderr, "ERR: unknown core_id=%u\n", core_id);
-    engine_destroy(eng);
-    memtap_close(&mt);
-    return 1;
+  core_slot_t *slot = slot_for_core(slots, core_id);
+  uint8_t *buf = NULL;
+  uint32_t buf_cap = 0;
+  snapshot_t snap;
+  memset(&snap, 0, sizeof(snap));
+  paging_t paging = paged ? PAGING_ON : PAGING_AUTO;
+  if (broker_name) {
+    if (paged) fprintf(stderr, "[WARN] --paged ignored: --broker republishes whole frames\n");
+    paging = PAGING_OFF;
   }
-
-  uint32_t size = 0;
-  for (uint32_t i = 0; i < region_count; i++) {
-    if (regions[i].region_id == want_region) {
-      size = regions[i].size_bytes;
-      break;
+  if (realtime) {
+    /* largest supported region, so a core switch never reallocates */
+    buf_cap = 0x20000u;
+    buf = (uint8_t*)calloc(1, buf_cap);
+    if (!buf) {
+      fprintf(stderr, "ERR: calloc(%u) failed\n", buf_cap);
+      destroy_slots(slots);
+      memtap_close(&mt);
+      return 1;
     }
   }
+  if (!slot || !activate_slot(&mt, slot, paging, &snap, &buf, &buf_cap)) {
+    if (mock_dir) {
+      fprintf(stderr, "ERR: could not select region %u for core %s\n",
+              want_region, core_str_from_id(core_id));
+      free(buf);
+      snapshot_free(&snap);
+      destroy_slots(slots);
+      memtap_close(&mt);
+      return 1;
+    }
+    fprintf(stderr, "[WARN] core_id=%u(%s) not supported; waiting for a core switch\n",
+            core_id, core_str_from_id(core_id));
+    slot = NULL;
+  }
+  uint32_t size = slot ? slot->size : 0;
 
-  if (size == 0) {
-    fprintf(stderr, "ERR: region %u not found in GET_REGIONS list\n", want_region);
-    engine_destroy(eng);
-    memtap_close(&mt);
-    return 1;
+  /* what the active slot was resolved against; a change in either re-plans */
+  uint32_t cur_core = core_id;
+  uint32_t cur_map = 0;
+  {
+    struct mmr_info info;
+    memset(&info, 0, sizeof(info));
+    if (memtap_get_info(&mt, &info)) cur_map = info.map_version;
   }
 
-  if (!memtap_select_region(&mt, want_region)) {
-    fprintf(stderr, "ERR: memtap_select_region(%u) failed\n", want_region);
-    engine_destroy(eng);
-    memtap_close(&mt);
-    return 1;
+  /* sized for the largest region any supported core exposes (SNES WRAM) */
+  broker_t broker;
+  bool broker_on = false;
+  if (broker_name) {
+    broker_on = broker_open(&broker, broker_name, 0x20000u);
+    if (!broker_on) fprintf(stderr, "[WARN] broker disabled\n");
   }
 
-  uint8_t *buf = (uint8_t*)malloc(size);
-  if (!buf) {
-    fprintf(stderr, "ERR: malloc(%u) failed\n", size);
-    engine_destroy(eng);
-    memtap_close(&mt);
-    return 1;
+  progress_t progress;
+  bool progress_on = false;
+  if (progress_name) {
+    progress_on = progress_open(&progress, progress_name);
+    if (!progress_on) fprintf(stderr, "[WARN] progress table disabled\n");
+  }
+
+  journal_t journal;
+  bool journal_on = false;
+  if (journal_path) {
+    journal_on = journal_open(&journal, journal_path, (size_t)journal_mib << 20, journal_keep);
+    if (journal_on) {
+      for (size_t i = 0; i < CORE_SLOTS; i++) engine_set_journal(slots[i].eng, &journal);
+      journal_begin_frame(&journal, 0, now_ns(), core_id);
+      journal_record(&journal, MMR_JEV_SESSION_START, core_id, 0);
+    } else {
+      fprintf(stderr, "[WARN] journal disabled\n");
+    }
   }
 
   const uint32_t frame_ms = (fps ? (1000u / fps) : 16u);
+  const uint64_t period_ns = (uint64_t)frame_ms * 1000000ull;
+
+  governor_t gov;
+  governor_init(&gov, cpu_budget);
+
+  uint64_t rt_warm_at = RT_WARMUP_FRAMES;   /* frame after which allocations are fatal */
+  uint64_t rt_allocs = 0;
+  int exit_code = 0;
+  /* idle priority, but started before rt_enter so it is not pinned either */
+  romhash_t prehash;
+  bool prehash_on = false;
+  if (rom_dir) {
+    prehash_on = romhash_open(&prehash, hash_cache);
+    if (prehash_on && !romhash_prefetch(&prehash, rom_dir, hash_threads)) {
+      romhash_close(&prehash);
+      prehash_on = false;
+    }
+    if (!prehash_on) fprintf(stderr, "[WARN] library pre-hash disabled\n");
+  }
+
+  /* from here on stdout/stderr lines go through the log writer thread;
+   * started before rt_enter so it is neither pinned nor SCHED_FIFO */
+  notify_start();
+
+  if (realtime) {
+    bool rt_ok = rt_enter(&rt_cfg);
+    fprintf(stdout, "[INFO] realtime: %s cpu=%d prio=%d warmup=%u frames\n",
+            rt_ok ? "enabled" : "partially enabled", rt_cfg.cpu, rt_cfg.priority, RT_WARMUP_FRAMES);
+  }
 
   uint64_t frame = 0;
   uint64_t last_logged = 0;
   uint32_t last_hash = 0;
+  uint32_t read_failures = 0;   /* consecutive, see READ_FAIL_MAX */
+
+  /* --catch-up: seq of the last frame read for the active region (0: none
+   * since it was selected) and how many newer ones the driver still holds */
+  uint64_t cu_seq = 0, cu_behind = 0;
+  uint64_t cu_batches = 0, cu_frames = 0, cu_max_behind = 0, cu_lost = 0;
 
   fprintf(stdout,
           "[INFO] mmr-daemon started mode=%s core_id=%u(%s) region=%u size=%u fps=%u backend=%s\n",
@@ -378,42 +1008,315 @@ int main(int argc, char **argv) {
   fflush(stdout);
 
   while (!g_stop) {
-    sleep_ms(frame_ms);
+    /* while catching up the next frame is already published: no wait */
+    uint32_t interval = 0;
+    if (!cu_behind) {
+      interval = governor_next_interval(&gov);
+      sleep_ms(frame_ms * interval);
+    }
+    const uint64_t cpu0 = thread_cpu_ns();
 
-    if (!memtap_seek(&mt, 0)) {
-      fprintf(stderr, "[ERR] memtap_seek(0) failed\n");
-      break;
+    /* one GET_INFO per frame is enough to notice a core switch */
+    struct mmr_info info;
+    memset(&info, 0, sizeof(info));
+    if (memtap_get_info(&mt, &info) &&
+        (info.core_id != cur_core || info.map_version != cur_map)) {
+      uint64_t t0 = now_ns();
+      cur_core = info.core_id;
+      cur_map = info.map_version;
+      if (journal_on) {
+        journal_begin_frame(&journal, frame, t0, cur_core);
+        journal_record(&journal, MMR_JEV_CORE_SWITCH, cur_core, (int32_t)cur_map);
+      }
+
+      slot = slot_for_core(slots, cur_core);
+      if (slot && activate_slot(&mt, slot, paging, &snap, &buf, &buf_cap)) {
+        engine_reset(slot->eng);
+        size = slot->size;
+        last_hash = 0;
+        cu_seq = 0;
+        cu_behind = 0;
+        rt_warm_at = frame + RT_WARMUP_FRAMES;
+        notify_print("[INFO] core switch -> core_id=%u(%s) map_version=%u region=%u size=%u in %.3fms\n",
+                     cur_core, core_str_from_id(cur_core), cur_map, slot->region_id, size,
+                     (double)(now_ns() - t0) / 1e6);
+      } else {
+        slot = NULL;
+        notify_print("[WARN] core_id=%u(%s) map_version=%u not supported; idle until the next switch\n",
+                     cur_core, core_str_from_id(cur_core), cur_map);
+      }
     }
 
-    ssize_t n = memtap_read(&mt, buf, size);
-    if (n < 0 || (uint32_t)n != size) {
-      fprintf(stderr, "[ERR] memtap_read got %zd (expected %u)\n", n, size);
-      break;
+    if (!slot) continue;
+
+    /* device mode re-reads only the pages the driver reports changed; a paged
+     * slot reads nothing up front beyond last frame's working set */
+    int32_t dirty = -1;
+    uint64_t gap_behind = 0, gap_lost = 0;
+    const uint64_t t_read = now_ns();
+    mt.frame_ns = 0;
+    if (slot->paged) {
+      snapshot_begin_frame(&snap);
+      if (snap.error) {
+        if (++read_failures >= READ_FAIL_MAX) {
+          notify(NOTIFY_ERR, "snapshot: %u frames in a row could not be read; stopping", read_failures);
+          exit_code = 1;
+          break;
+        }
+        notify_limited(NOTIFY_WARN, "snapshot: working set read failed; frame skipped");
+        snapshot_keep_working_set(&snap);   /* so the next frame reads it again */
+        continue;
+      }
+    } else {
+      bool have = false;
+      if (catch_up && !mt.history_unsupported) {
+        /* frames the governor chose to wait out are skipped, not caught up */
+        struct mmr_frame_req fr;
+        if (memtap_read_frame(&mt, buf, size, interval > 1 ? 0 : cu_seq, &fr)) {
+          have = true;
+          if (cu_seq && interval <= 1 && fr.seq > cu_seq + 1) gap_lost = fr.seq - cu_seq - 1;
+          if (fr.seq > cu_seq) cu_seq = fr.seq;
+          uint64_t behind = fr.latest_seq > fr.seq ? fr.latest_seq - fr.seq : 0;
+          if (behind && !cu_behind) {
+            /* a new batch: this frame and the behind after it, back to back */
+            gap_behind = behind;
+            cu_batches++;
+            cu_frames += behind;
+            if (behind > cu_max_behind) cu_max_behind = behind;
+          }
+          cu_behind = behind;
+          if (gap_lost) {
+            cu_lost += gap_lost;
+            notify_limited(NOTIFY_WARN, "catch-up: %" PRIu64 " frame(s) dropped out of the driver history "
+                           "(history=%u) before they could be read", gap_lost, fr.history);
+          }
+        } else if (!mt.history_unsupported) {
+          break;
+        }
+      }
+      if (!have) {
+        ssize_t n = memtap_read_dirty(&mt, buf, size, &dirty);
+        if (n < 0 || (uint32_t)n != size) {
+          if (++read_failures >= READ_FAIL_MAX) {
+            notify(NOTIFY_ERR, "memtap_read got %zd (expected %u), %u frames in a row; stopping",
+                   n, size, read_failures);
+            exit_code = 1;
+            break;
+          }
+          notify_limited(NOTIFY_WARN, "memtap_read got %zd (expected %u); frame skipped", n, size);
+          continue;
+        }
+      }
     }
 
+    /* info.publish_ns can belong to the frame before the one read (it is
+     * from the GET_INFO above), which overstates the latency: used only
+     * without a stamp from the read itself */
+    const uint64_t t_ready = now_ns();
+    const uint64_t stamp = mt.frame_ns ? mt.frame_ns : info.publish_ns;
+    const uint64_t origin = (stamp && stamp <= t_ready) ? stamp : t_read;
+    lat_add(&g_lat[LAT_ACQUIRE], t_ready - origin);
+
     frame++;
+    if (journal_on) {
+      journal_begin_frame(&journal, frame, t_ready, cur_core);
+      if (stamp) journal_set_origin(&journal, origin);
+      if (gap_behind || gap_lost) {
+        journal_record(&journal, MMR_JEV_FRAME_GAP, (uint32_t)gap_behind, (int32_t)gap_lost);
+      }
+    }
 
-    uint32_t h = fnv1a32(buf, size);
-    int changed = (h != last_hash);
+    if (broker_on) broker_publish(&broker, frame, cur_core, slot->region_id, buf, size);
 
-    if (!only_on_change || changed) {
-      engine_do_frame(eng, buf, size);
+    int changed;
+    if (slot->paged) {
+      /* only what achievements read can be compared; nothing is known yet
+       * on the first frame after (re)attaching */
+      changed = snap.changed || snap.gen == 1;
+    } else if (dirty >= 0) {
+      changed = (dirty > 0);
+    } else {
+      uint32_t h = fnv1a32(buf, size);
+      changed = (h != last_hash);
       last_hash = h;
     }
 
+    /* with --fast-forward an unchanged frame is usually absorbed by the
+     * engine without an evaluation; when it is not, it is evaluated */
+    engine_set_shed(slot->eng, governor_shed_flags(&gov));
+    bool evaluate = !only_on_change || changed;
+    if (!evaluate && fast_forward) evaluate = !engine_fast_forward(slot->eng);
+
+    if (evaluate) {
+      if (slot->paged) {
+        engine_do_frame_fetch(slot->eng, snapshot_fetch_cb, &snap, size);
+        if (snap.error) {
+          /* pages that could not be read peeked as 0: what this
+           * evaluation raised is not reported (the journal keeps it) */
+          engine_event_t ev;
+          while (engine_next_event(slot->eng, &ev)) {}
+          if (++read_failures >= READ_FAIL_MAX) {
+            notify(NOTIFY_ERR, "snapshot: %u frames in a row could not be read; stopping", read_failures);
+            exit_code = 1;
+            break;
+          }
+          notify_limited(NOTIFY_WARN, "snapshot: page read failed mid-evaluation; frame skipped");
+          snapshot_keep_working_set(&snap);
+          continue;
+        }
+        if (snap.changed && !changed) {
+          changed = 1;
+          engine_frame_changed(slot->eng);
+        }
+      } else {
+        engine_do_frame(slot->eng, buf, size);
+      }
+      uint64_t memrefs_ns, eval_ns;
+      engine_frame_timing(slot->eng, &memrefs_ns, &eval_ns);
+      lat_add(&g_lat[LAT_MEMREFS], memrefs_ns);
+      lat_add(&g_lat[LAT_EVALUATE], eval_ns);
+
+      if (progress_on) {
+        uint32_t cap = 0, set_id = 0;
+        mmr_progress_entry_t *entries = progress_begin(&progress, &cap);
+        uint32_t n = engine_progress_fill(slot->eng, entries, cap, &set_id);
+        progress_commit(&progress, n, frame, cur_core, set_id);
+      }
+
+      (void)report_engine_output(slot->eng, origin, now_ns());
+      uint64_t ev_dropped = engine_dropped_events(slot->eng);
+      if (ev_dropped != slot->ev_dropped) {
+        notify_limited(NOTIFY_WARN, "engine: %" PRIu64 " event(s) dropped from a full queue",
+                       ev_dropped - slot->ev_dropped);
+        slot->ev_dropped = ev_dropped;
+      }
+    } else if (slot->paged) {
+      snapshot_keep_working_set(&snap);
+    }
+    read_failures = 0;
+
+    if (journal_on) journal_tick(&journal);
+
+    if (g_profile_dump) {
+      g_profile_dump = 0;
+      report_profile(slot, profile_top);
+    }
+
+    if (governor_end_frame(&gov, thread_cpu_ns() - cpu0, period_ns, changed, engine_has_live(slot->eng))) {
+      notify_print("[INFO] governor level=%u (util=%.1f%% budget=%u%%)\n",
+                   gov.level, governor_utilization(&gov, period_ns), cpu_budget);
+    }
+
+    if (realtime) {
+      if (frame == rt_warm_at) {
+        rt_allocs = rt_alloc_count();
+      } else if (frame > rt_warm_at && rt_alloc_count() != rt_allocs) {
+        notify(NOTIFY_ERR, "realtime: %" PRIu64 " heap allocation(s) in the frame loop after warm-up (frame %" PRIu64 ")",
+               rt_alloc_count() - rt_allocs, frame);
+        exit_code = 3;
+        break;
+      }
+    }
+
     if (log_every && (frame - last_logged) >= (uint64_t)log_every) {
-      fprintf(stdout, "[INFO] frame=%" PRIu64 " size=%u changed=%s hash=0x%08x\n",
-              frame, size, changed ? "yes" : "no", h);
-      fflush(stdout);
+      char line[256];
+      int len;
+      if (slot->paged) {
+        len = snprintf(line, sizeof(line), "[INFO] frame=%" PRIu64 " size=%u changed=%s paged=%u/%u reads=%u",
+                       frame, size, changed ? "yes" : "no", snap.frame_pages, snap.page_count, snap.frame_reads);
+      } else {
+        len = snprintf(line, sizeof(line), "[INFO] frame=%" PRIu64 " size=%u changed=%s dirty_pages=%d hash=0x%08x",
+                       frame, size, changed ? "yes" : "no", dirty, fnv1a32(buf, size));
+      }
+      if (cpu_budget && len > 0 && (size_t)len < sizeof(line)) {
+        snprintf(line + len, sizeof(line) - (size_t)len, " gov_level=%u interval=%u util=%.1f%%",
+                 gov.level, gov.interval, governor_utilization(&gov, period_ns));
+      }
+      notify_print("%s\n", line);
       last_logged = frame;
     }
   }
 
-  fprintf(stdout, "[INFO] mmr-daemon stopping (signal)\n");
+  notify_stop();
+  notify_delivery_latency(&g_lat[LAT_DELIVER], &g_lat[LAT_UNLOCK]);
+  fprintf(stdout, "[INFO] mmr-daemon stopping (%s)\n", exit_code ? "error" : "signal");
+  if (realtime) {
+    fprintf(stdout, "[INFO] realtime: heap allocations total=%" PRIu64 " after warm-up=%" PRIu64 "\n",
+            rt_alloc_count(), frame > rt_warm_at ? rt_alloc_count() - rt_allocs : 0);
+  }
+  if (cpu_budget) {
+    uint64_t shed_progress = 0;
+    for (size_t i = 0; i < CORE_SLOTS; i++) shed_progress += engine_shed_progress_events(slots[i].eng);
+    fprintf(stdout, "[INFO] governor: polled=%" PRIu64 " skipped %s=%" PRIu64 " %s=%" PRIu64 " %s=%" PRIu64
+            " rp_shed_frames=%" PRIu64 " progress_events_shed=%" PRIu64 "\n",
+            gov.polled,
+            governor_skip_reason_str(GOV_SKIP_STATIC), gov.skipped[GOV_SKIP_STATIC],
+            governor_skip_reason_str(GOV_SKIP_IDLE), gov.skipped[GOV_SKIP_IDLE],
+            governor_skip_reason_str(GOV_SKIP_OVERLOAD), gov.skipped[GOV_SKIP_OVERLOAD],
+            gov.polled - gov.level_frames[0], shed_progress);
+  }
   fflush(stdout);
 
+  if (fast_forward) {
+    uint64_t ff_frames = 0;
+    for (size_t i = 0; i < CORE_SLOTS; i++) ff_frames += engine_fast_forwarded(slots[i].eng);
+    fprintf(stdout, "[INFO] fast-forward: %" PRIu64 " of %" PRIu64 " frames absorbed without evaluation\n",
+            ff_frames, frame);
+  }
+  {
+    uint64_t lookups = 0, hits = 0;
+    for (size_t i = 0; i < CORE_SLOTS; i++) {
+      uint64_t l, h;
+      engine_pointer_cache_stats(slots[i].eng, &l, &h);
+      lookups += l;
+      hits += h;
+    }
+    if (lookups) {
+      fprintf(stdout, "[INFO] pointer cache: lookups=%" PRIu64 " hits=%" PRIu64 " (%.1f%%)\n",
+              lookups, hits, 100.0 * (double)hits / (double)lookups);
+    }
+  }
+  {
+    uint64_t ev_dropped = 0;
+    for (size_t i = 0; i < CORE_SLOTS; i++) ev_dropped += engine_dropped_events(slots[i].eng);
+    if (ev_dropped) fprintf(stdout, "[INFO] engine: %" PRIu64 " event(s) dropped from a full queue\n", ev_dropped);
+  }
+  if (mt.torn_rereads) {
+    fprintf(stdout, "[INFO] memtap: %" PRIu64 " dirty-page copy(ies) redone in full after a mid-copy publish\n",
+            mt.torn_rereads);
+  }
+  if (catch_up) {
+    fprintf(stdout, "[INFO] catch-up: batches=%" PRIu64 " frames=%" PRIu64 " max_behind=%" PRIu64
+            " lost=%" PRIu64 "%s\n", cu_batches, cu_frames, cu_max_behind, cu_lost,
+            mt.history_unsupported ? " (driver has no frame history)" : "");
+  }
+  if (profile_top) {
+    for (size_t i = 0; i < CORE_SLOTS; i++) report_profile(&slots[i], profile_top);
+  }
+  for (int i = 0; i < LAT_STAGES; i++) {
+    const lat_hist_t *h = &g_lat[i];
+    if (!h->count) continue;
+    fprintf(stdout, "[INFO] latency %-8s n=%" PRIu64 " p50=%.1fus p99=%.1fus max=%.1fus\n",
+            k_lat_stage_names[i], h->count, (double)lat_percentile(h, 50.0) / 1e3,
+            (double)lat_percentile(h, 99.0) / 1e3, (double)h->max_ns / 1e3);
+  }
+  if (snap.total_reads) {
+    fprintf(stdout, "[INFO] snapshot: pages_read=%" PRIu64 " reads=%" PRIu64 " (%.2f pages/frame)\n",
+            snap.total_pages, snap.total_reads, frame ? (double)snap.total_pages / (double)frame : 0.0);
+  }
+  if (journal_on) {
+    journal_set_origin(&journal, 0);   /* not a frame event */
+    journal_record(&journal, MMR_JEV_SESSION_END, 0, exit_code);
+    fprintf(stdout, "[INFO] journal: %s records=%" PRIu64 " rotations=%u dropped=%" PRIu64 "\n",
+            journal.path, journal.hdr ? journal.hdr->count : 0, journal.rotations, journal.dropped);
+    journal_close(&journal);
+  }
+  if (broker_on) broker_close(&broker);
+  if (progress_on) progress_close(&progress);
+  if (prehash_on) romhash_close(&prehash);   /* waits for a ROM being hashed */
   free(buf);
-  engine_destroy(eng);
+  snapshot_free(&snap);
+  destroy_slots(slots);
   memtap_close(&mt);
-  return 0;
+  return exit_code;
 }
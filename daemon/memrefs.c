@@ -0,0 +1,293 @@
+#include "memrefs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../third_party/rcheevos/include/rc_runtime_types.h"
+#include "../third_party/rcheevos/src/rcheevos/rc_internal.h"
+
+#define WINDOW_BYTES 8u
+#define PREFETCH_RUNS 4u   /* runs ahead of the one being decoded */
+
+static int slot_cmp(const void *a, const void *b) {
+  const memref_slot_t *x = (const memref_slot_t*)a;
+  const memref_slot_t *y = (const memref_slot_t*)b;
+  if (x->address != y->address) return x->address < y->address ? -1 : 1;
+  if (x->bytes != y->bytes) return x->bytes < y->bytes ? -1 : 1;
+  /* keep the build deterministic */
+  return (uintptr_t)x->value < (uintptr_t)y->value ? -1 : (x->value != y->value);
+}
+
+static uint8_t read_width(uint8_t size) {
+  switch (rc_memref_shared_size(size)) {
+    case RC_MEMSIZE_8_BITS:  return 1;
+    case RC_MEMSIZE_16_BITS: return 2;
+    default:                 return 4;
+  }
+}
+
+void memref_table_free(memref_table_t *t) {
+  free(t->slots);
+  free(t->runs);
+  memset(t, 0, sizeof(*t));
+}
+
+bool memref_table_build(memref_table_t *t, struct rc_memrefs_t *memrefs) {
+  memref_table_free(t);
+  t->memrefs = memrefs;
+  if (!memrefs) return true;
+
+  uint32_t n = 0;
+  for (rc_memref_list_t *l = &memrefs->memrefs; l; l = l->next) {
+    for (uint16_t i = 0; i < l->count; i++) {
+      if (l->items[i].value.type != RC_VALUE_TYPE_NONE) n++;
+    }
+  }
+  if (n == 0) return true;
+
+  t->slots = (memref_slot_t*)calloc(n, sizeof(*t->slots));
+  t->runs = (memref_run_t*)calloc(n, sizeof(*t->runs));
+  if (!t->slots || !t->runs) {
+    memref_table_free(t);
+    return false;
+  }
+
+  for (rc_memref_list_t *l = &memrefs->memrefs; l; l = l->next) {
+    for (uint16_t i = 0; i < l->count; i++) {
+      rc_memref_t *m = &l->items[i];
+      if (m->value.type == RC_VALUE_TYPE_NONE) continue;
+      memref_slot_t *s = &t->slots[t->slot_count++];
+      s->value = &m->value;
+      s->address = m->address;
+      s->mask = rc_memref_mask(m->value.size);
+      s->bytes = read_width(m->value.size);
+    }
+  }
+  qsort(t->slots, t->slot_count, sizeof(*t->slots), slot_cmp);
+
+  /* greedy runs: a slot joins the open run while it ends inside its window */
+  memref_run_t *run = NULL;
+  for (uint32_t i = 0; i < t->slot_count; i++) {
+    memref_slot_t *s = &t->slots[i];
+    uint64_t end = (uint64_t)s->address + s->bytes;
+    if (!run || end > (uint64_t)run->address + WINDOW_BYTES || run->count == UINT16_MAX) {
+      run = &t->runs[t->run_count++];
+      run->address = s->address;
+      run->first = i;
+      run->count = 0;
+      run->span = 0;
+    }
+    s->shift = (uint8_t)((s->address - run->address) * 8u);
+    if (end - run->address > run->span) run->span = (uint8_t)(end - run->address);
+    run->count++;
+  }
+  return true;
+}
+
+static inline uint64_t load_le(const uint8_t *p, uint32_t n) {
+  uint64_t v = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  if (n == WINDOW_BYTES) {
+    memcpy(&v, p, WINDOW_BYTES);
+    return v;
+  }
+#endif
+  for (uint32_t i = 0; i < n; i++) v |= (uint64_t)p[i] << (8u * i);
+  return v;
+}
+
+/* Decode one run from the bytes at p (span bytes, or NULL: reads as 0), with
+ * the same bounds rule as the engine's peek: a read that does not fit in the
+ * region is 0 as a whole. */
+static inline void decode_run(const memref_table_t *t, const memref_run_t *r, const uint8_t *p,
+                              uint32_t avail) {
+  uint64_t win = p ? load_le(p, avail < r->span ? avail : (avail >= WINDOW_BYTES ? WINDOW_BYTES : r->span)) : 0;
+  const memref_slot_t *s = &t->slots[r->first];
+  const memref_slot_t *end = s + r->count;
+  for (; s < end; s++) {
+    uint32_t v = 0;
+    if ((uint32_t)(s->address - r->address) + s->bytes <= avail) v = (uint32_t)(win >> s->shift) & s->mask;
+    rc_update_memref_value(s->value, v);
+  }
+}
+
+/* ---- pointer chains ---- */
+
+#define CHAIN_PROBE 4u   /* slots tried before a read goes uncached */
+
+uint32_t memref_chain_count(const struct rc_memrefs_t *memrefs) {
+  uint32_t n = 0;
+  if (!memrefs) return 0;
+  for (const rc_modified_memref_list_t *l = &memrefs->modified_memrefs; l; l = l->next) {
+    for (uint16_t i = 0; i < l->count; i++) {
+      if (l->items[i].modifier_type == RC_OPERATOR_INDIRECT_READ) n++;
+    }
+  }
+  return n;
+}
+
+bool memref_chain_cache_alloc(memref_chain_cache_t *c, uint32_t reads) {
+  uint32_t want = 16;
+  while (want < reads * 2u && want < (1u << 20)) want <<= 1;
+  if (c->entries && c->mask + 1u >= want) return true;
+
+  memref_chain_entry_t *e = (memref_chain_entry_t*)calloc(want, sizeof(*e));
+  if (!e) {
+    memref_chain_cache_free(c);
+    return false;
+  }
+  free(c->entries);
+  c->entries = e;
+  c->mask = want - 1u;
+  c->gen = 1;   /* calloc'd entries carry gen 0: all stale */
+  return true;
+}
+
+void memref_chain_cache_free(memref_chain_cache_t *c) {
+  free(c->entries);
+  c->entries = NULL;
+  c->mask = 0;
+  c->gen = 0;
+}
+
+void memref_chain_cache_begin(memref_chain_cache_t *c) {
+  if (!c || !c->entries) return;
+  if (++c->gen == 0) {
+    /* wrapped: entries from 2^32 frames ago would look current */
+    memset(c->entries, 0, (size_t)(c->mask + 1u) * sizeof(*c->entries));
+    c->gen = 1;
+  }
+}
+
+static uint32_t chain_read(memref_chain_cache_t *c, uint32_t address, uint8_t size,
+                           memref_peek_fn peek, void *ud) {
+  if (!c || !c->entries) return rc_peek_value(address, size, (rc_peek_t)peek, ud);
+
+  c->lookups++;
+  uint32_t h = (address * 0x9E3779B1u) ^ size;
+  memref_chain_entry_t *free_slot = NULL;
+  for (uint32_t i = 0; i < CHAIN_PROBE; i++) {
+    memref_chain_entry_t *e = &c->entries[(h + i) & c->mask];
+    if (e->gen != c->gen) {
+      free_slot = e;
+      break;
+    }
+    if (e->address == address && e->size == size) {
+      c->hits++;
+      return e->value;
+    }
+  }
+
+  uint32_t v = rc_peek_value(address, size, (rc_peek_t)peek, ud);
+  if (free_slot) {
+    free_slot->gen = c->gen;
+    free_slot->address = address;
+    free_slot->size = size;
+    free_slot->value = v;
+  }
+  return v;
+}
+
+/* rc_get_modified_memref_value, with the pointer read going through the cache */
+static uint32_t modified_value(const rc_modified_memref_t *m, memref_chain_cache_t *cache,
+                               memref_peek_fn peek, void *ud) {
+  if (m->modifier_type != RC_OPERATOR_INDIRECT_READ) {
+    return rc_get_modified_memref_value(m, (rc_peek_t)peek, ud);
+  }
+
+  rc_typed_value_t value, modifier;
+  rc_evaluate_operand(&value, &m->parent, NULL);
+  rc_evaluate_operand(&modifier, &m->modifier, NULL);
+  rc_typed_value_add(&value, &modifier);
+  rc_typed_value_convert(&value, RC_VALUE_TYPE_UNSIGNED);
+  return chain_read(cache, value.value.u32, m->memref.value.size, peek, ud);
+}
+
+static void update_modified(const memref_table_t *t, memref_chain_cache_t *cache,
+                            memref_peek_fn peek, void *ud) {
+  rc_modified_memref_list_t *l = &t->memrefs->modified_memrefs;
+  if (!l->count) return;
+  for (; l; l = l->next) {
+    for (uint16_t i = 0; i < l->count; i++) {
+      rc_modified_memref_t *m = &l->items[i];
+      rc_update_memref_value(&m->memref.value, modified_value(m, cache, peek, ud));
+    }
+  }
+}
+
+/* ---- frame update ---- */
+
+void memref_table_update(const memref_table_t *t, const uint8_t *mem, size_t mem_len,
+                         memref_chain_cache_t *cache, memref_peek_fn peek, void *ud) {
+  if (!t->memrefs) return;
+
+  for (uint32_t i = 0; i < t->run_count; i++) {
+    const memref_run_t *r = &t->runs[i];
+    if (i + PREFETCH_RUNS < t->run_count && t->runs[i + PREFETCH_RUNS].address < mem_len) {
+      __builtin_prefetch(mem + t->runs[i + PREFETCH_RUNS].address);
+    }
+    if ((size_t)r->address >= mem_len) {
+      decode_run(t, r, NULL, 0);
+      continue;
+    }
+    size_t avail = mem_len - r->address;
+    decode_run(t, r, mem + r->address, avail > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)avail);
+  }
+  update_modified(t, cache, peek, ud);
+}
+
+void memref_table_update_fetch(const memref_table_t *t, memref_fetch_fn fetch, void *fetch_ud,
+                               size_t mem_len, memref_chain_cache_t *cache,
+                               memref_peek_fn peek, void *ud) {
+  if (!t->memrefs) return;
+
+  for (uint32_t i = 0; i < t->run_count; i++) {
+    const memref_run_t *r = &t->runs[i];
+    if ((size_t)r->address >= mem_len) {
+      decode_run(t, r, NULL, 0);
+      continue;
+    }
+    size_t avail = mem_len - r->address;
+    uint32_t span = avail < r->span ? (uint32_t)avail : r->span;
+    const uint8_t *p = fetch(fetch_ud, r->address, span);
+    decode_run(t, r, p, p ? span : 0);
+  }
+  update_modified(t, cache, peek, ud);
+}
+
+bool memref_table_changed(const memref_table_t *t) {
+  if (!t->memrefs) return false;
+  for (const rc_memref_list_t *l = &t->memrefs->memrefs; l; l = l->next) {
+    for (uint16_t i = 0; i < l->count; i++) {
+      if (l->items[i].value.changed) return true;
+    }
+  }
+  for (const rc_modified_memref_list_t *l = &t->memrefs->modified_memrefs; l; l = l->next) {
+    for (uint16_t i = 0; i < l->count; i++) {
+      if (l->items[i].memref.value.changed) return true;
+    }
+  }
+  return false;
+}
+
+/* ---- rich presence ---- */
+
+struct rc_memrefs_t *memref_richpresence_pool(rc_richpresence_t *rp) {
+  return rp ? rc_richpresence_get_memrefs(rp) : NULL;
+}
+
+void memref_richpresence_update(rc_richpresence_t *rp, memref_peek_fn peek, void *ud) {
+  rc_update_values(rp->values, (rc_peek_t)peek, ud);
+  rc_update_richpresence_internal(rp, (rc_peek_t)peek, ud);
+}
+
+/* ---- trigger state ---- */
+
+bool memref_trigger_measured(const rc_trigger_t *t, uint32_t *value, uint32_t *target) {
+  *value = 0;
+  *target = 0;
+  if (!t || !rc_trigger_state_active(t->state)) return false;
+  *value = t->measured_value == RC_MEASURED_UNKNOWN ? 0 : t->measured_value;
+  *target = t->measured_target;
+  return true;
+}
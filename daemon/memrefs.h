@@ -0,0 +1,123 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Address-sorted view of a runtime's memrefs, for the engine's frame driver.
+//
+// rcheevos keeps memrefs in allocation order across chained blocks of 8 and
+// updates each with its own peek, so 0xH07ED and 0xH07EE are two reads from
+// wherever the blocks happen to live. The table built here is sorted by
+// address and cut into runs of memrefs that fit in one 8-byte window: a
+// frame update does one wide load per run (one fetch per run when paging)
+// and derives every memref in it with a shift and its size mask, walking
+// the snapshot front to back. Values, deltas and priors land in the
+// memrefs themselves, exactly as rc_update_memref_values would leave them.
+//
+// Modified memrefs (AddAddress pointers, AddSource/SubSource chains, ...)
+// are computed from the plain ones, so they are updated afterwards, in
+// their original order. Those that dereference a pointer go through a
+// memref_chain_cache_t when one is passed; the rest through the runtime.
+//
+// Built against rcheevos internals (rc_internal.h), as setarena.c is: besides
+// the table it holds the few accessors below that the public headers do not
+// offer. The runtime calls the table through its update_memrefs hook
+// (third_party/PATCHES.md).
+
+#include "../third_party/rcheevos/include/rc_runtime.h"
+
+struct rc_memrefs_t;
+struct rc_memref_value_t;
+
+typedef const uint8_t *(*memref_fetch_fn)(void *ud, uint32_t address, uint32_t num_bytes);
+typedef uint32_t (*memref_peek_fn)(uint32_t address, uint32_t num_bytes, void *ud);
+
+typedef struct {
+  struct rc_memref_value_t *value;
+  uint32_t address;
+  uint32_t mask;            // rc_memref_mask(size): the bits the memref keeps
+  uint8_t shift;            // bit offset of address within the run's window
+  uint8_t bytes;            // bytes read (the size's shared read width)
+} memref_slot_t;
+
+typedef struct {
+  uint32_t address;         // first byte of the window
+  uint32_t first;           // first slot
+  uint16_t count;
+  uint8_t span;             // bytes the run's slots cover (1..8)
+} memref_run_t;
+
+typedef struct {
+  struct rc_memrefs_t *memrefs;
+  memref_slot_t *slots;
+  memref_run_t *runs;
+  uint32_t slot_count;
+  uint32_t run_count;
+} memref_table_t;
+
+// Pointer reads resolved this frame, keyed by final address and size.
+//
+// Within one memref pool rcheevos already shares a chain's links, but a
+// trigger set and the rich presence script parse into separate pools, and
+// different chains often land on the same object (two offsets from one
+// base, the same pointer read through AddAddress and through a value). An
+// entry is valid only while its gen equals the cache's, so starting a frame
+// is one increment; lookups and hits are the engine's metrics.
+typedef struct {
+  uint32_t gen;
+  uint32_t address;
+  uint32_t value;
+  uint8_t size;             // RC_MEMSIZE_*
+} memref_chain_entry_t;
+
+typedef struct {
+  memref_chain_entry_t *entries;
+  uint32_t mask;            // entry count - 1 (a power of two)
+  uint32_t gen;
+  uint64_t lookups;
+  uint64_t hits;
+} memref_chain_cache_t;
+
+// Size for the pointer reads in memrefs (NULL: none); call once per pool
+// the cache will serve and memref_chain_cache_alloc after the last.
+uint32_t memref_chain_count(const struct rc_memrefs_t *memrefs);
+// Room for at least reads entries (kept if already large enough); false on
+// OOM, leaving the cache off (a NULL cache resolves every read).
+bool memref_chain_cache_alloc(memref_chain_cache_t *c, uint32_t reads);
+void memref_chain_cache_free(memref_chain_cache_t *c);
+// Invalidate every entry: call before the first update of a frame.
+void memref_chain_cache_begin(memref_chain_cache_t *c);
+
+// (Re)build from memrefs after triggers are activated; NULL memrefs gives an
+// empty table. false on OOM (the table is left empty).
+bool memref_table_build(memref_table_t *t, struct rc_memrefs_t *memrefs);
+void memref_table_free(memref_table_t *t);
+
+// Update every memref from a full copy of the region ...
+// cache may be NULL.
+void memref_table_update(const memref_table_t *t, const uint8_t *mem, size_t mem_len,
+                         memref_chain_cache_t *cache, memref_peek_fn peek, void *ud);
+
+// ... or from pages pulled through fetch (one call per run).
+void memref_table_update_fetch(const memref_table_t *t, memref_fetch_fn fetch, void *fetch_ud,
+                               size_t mem_len, memref_chain_cache_t *cache,
+                               memref_peek_fn peek, void *ud);
+
+// true if any memref in t's pool (plain or modified) changed value in the
+// last update
+bool memref_table_changed(const memref_table_t *t);
+
+// ----- rich presence -----
+
+// The script's own memref pool (for a table of its own).
+struct rc_memrefs_t *memref_richpresence_pool(rc_richpresence_t *rp);
+
+// rc_update_richpresence without its memref pass: the script's values and
+// display conditions, after memref_table_update has run over its pool.
+void memref_richpresence_update(rc_richpresence_t *rp, memref_peek_fn peek, void *ud);
+
+// ----- trigger state -----
+
+// The measured progress the runtime would report: false (and 0/0) unless
+// the trigger is active; an unknown value reads as 0.
+bool memref_trigger_measured(const rc_trigger_t *t, uint32_t *value, uint32_t *target);
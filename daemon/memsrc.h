@@ -7,6 +7,12 @@
 
 typedef struct memsrc memsrc_t;
 
+/* cumulative since open; a benchmark diffs two samples around a frame */
+typedef struct {
+  uint64_t syscalls;
+  uint64_t bytes;     /* copied into caller buffers */
+} memsrc_io_stats_t;
+
 typedef struct {
   bool   (*open_device)(memsrc_t *ms, const char *devnode);
   bool   (*open_mock)(memsrc_t *ms, const char *mock_dir, uint32_t core_id);
@@ -18,8 +24,12 @@ typedef struct {
   bool   (*select_region)(memsrc_t *ms, uint32_t region_id);
   bool   (*seek)(memsrc_t *ms, uint32_t offset);
   ssize_t(*read)(memsrc_t *ms, void *buf, size_t len);
+  ssize_t(*read_dirty)(memsrc_t *ms, void *buf, size_t len, int32_t *out_dirty_pages);
+  bool   (*read_frame)(memsrc_t *ms, void *buf, size_t len, uint64_t after_seq, struct mmr_frame_req *out);
 
   bool   (*wait_frame)(memsrc_t *ms, uint64_t last_frame, uint32_t timeout_ms);
+
+  void   (*io_stats)(memsrc_t *ms, memsrc_io_stats_t *out);
 } memsrc_ops_t;
 
 struct memsrc {
@@ -38,5 +48,9 @@ static inline bool memsrc_get_regions(memsrc_t *ms, struct mmr_region_desc *out1
 static inline bool memsrc_select_region(memsrc_t *ms, uint32_t region_id) { return ms->ops->select_region(ms, region_id); }
 static inline bool memsrc_seek(memsrc_t *ms, uint32_t offset) { return ms->ops->seek(ms, offset); }
 static inline ssize_t memsrc_read(memsrc_t *ms, void *buf, size_t len) { return ms->ops->read(ms, buf, len); }
+static inline ssize_t memsrc_read_dirty(memsrc_t *ms, void *buf, size_t len, int32_t *out_dirty_pages) { return ms->ops->read_dirty(ms, buf, len, out_dirty_pages); }
+static inline bool memsrc_read_frame(memsrc_t *ms, void *buf, size_t len, uint64_t after_seq, struct mmr_frame_req *out) { return ms->ops->read_frame(ms, buf, len, after_seq, out); }
 
 static inline bool memsrc_wait_frame(memsrc_t *ms, uint64_t last_frame, uint32_t timeout_ms) { return ms->ops->wait_frame(ms, last_frame, timeout_ms); }
+
+static inline void memsrc_io_stats(memsrc_t *ms, memsrc_io_stats_t *out) { ms->ops->io_stats(ms, out); }
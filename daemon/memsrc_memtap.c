@@ -51,11 +51,27 @@ static ssize_t ms_read(memsrc_t *ms, void *buf, size_t len) {
   return memtap_read(&impl->mt, buf, len);
 }
 
+static ssize_t ms_read_dirty(memsrc_t *ms, void *buf, size_t len, int32_t *out_dirty_pages) {
+  memsrc_memtap_impl_t *impl = (memsrc_memtap_impl_t*)ms->impl;
+  return memtap_read_dirty(&impl->mt, buf, len, out_dirty_pages);
+}
+
+static bool ms_read_frame(memsrc_t *ms, void *buf, size_t len, uint64_t after_seq, struct mmr_frame_req *out) {
+  memsrc_memtap_impl_t *impl = (memsrc_memtap_impl_t*)ms->impl;
+  return memtap_read_frame(&impl->mt, buf, len, after_seq, out);
+}
+
 static bool ms_wait_frame(memsrc_t *ms, uint64_t last_frame, uint32_t timeout_ms) {
   memsrc_memtap_impl_t *impl = (memsrc_memtap_impl_t*)ms->impl;
   return memtap_wait_frame(&impl->mt, last_frame, timeout_ms);
 }
 
+static void ms_io_stats(memsrc_t *ms, memsrc_io_stats_t *out) {
+  memsrc_memtap_impl_t *impl = (memsrc_memtap_impl_t*)ms->impl;
+  out->syscalls = impl->mt.io_syscalls;
+  out->bytes = impl->mt.io_bytes;
+}
+
 static const memsrc_ops_t g_ops = {
   .open_device   = ms_open_device,
   .open_mock     = ms_open_mock,
@@ -65,7 +81,10 @@ static const memsrc_ops_t g_ops = {
   .select_region = ms_select_region,
   .seek          = ms_seek,
   .read          = ms_read,
+  .read_dirty    = ms_read_dirty,
+  .read_frame    = ms_read_frame,
   .wait_frame    = ms_wait_frame,
+  .io_stats      = ms_io_stats,
 };
 
 void memsrc_init_memtap(memsrc_t *ms) {
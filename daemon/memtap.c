@@ -5,6 +5,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
@@ -31,6 +32,7 @@ bool memtap_open_device(memtap_t *mt, const char *devnode) {
   memset(mt, 0, sizeof(*mt));
   mt->backend = MEMTAP_BACKEND_DEVICE;
   mt->fd = open(devnode, O_RDONLY);
+  mt->io_syscalls++;
   if (mt->fd < 0) {
     notify(NOTIFY_ERR, "open(%s) failed: %s", devnode, strerror(errno));
     return false;
@@ -40,31 +42,61 @@ bool memtap_open_device(memtap_t *mt, const char *devnode) {
   return true;
 }
 
+static bool mock_set_core(memtap_t *mt, uint32_t core_id) {
+  uint32_t region_id;
+  switch (core_id) {
+    case MMR_CORE_NES:     region_id = MMR_REGION_NES_CPU_RAM; break;
+    case MMR_CORE_SNES:    region_id = MMR_REGION_SNES_WRAM; break;
+    case MMR_CORE_GENESIS: region_id = MMR_REGION_GEN_68K_RAM; break;
+    default:
+      notify(NOTIFY_ERR, "mock core_id %u not supported", core_id);
+      return false;
+  }
+
+  // Populate a minimal region list based on core_id
+  memset(mt->mock_regions, 0, sizeof(mt->mock_regions));
+  mt->mock_regions[0] = (struct mmr_region_desc){
+    .region_id = region_id, .flags = MMR_RF_SNAPSHOT, .size_bytes = default_region_size(region_id)
+  };
+  mt->mock_region_count = 1;
+  mt->mock_core_id = core_id;
+  mt->mock_map_version++;
+  return true;
+}
+
+// Picks up <mock_dir>/core if present; a missing or unparsable file keeps the current core.
+static void mock_poll_core(memtap_t *mt) {
+  char path[600];
+  snprintf(path, sizeof(path), "%s/core", mt->mock_dir);
+  // plain open/read: this runs every frame and must not allocate (stdio would)
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  mt->io_syscalls++;
+  if (fd < 0) return;
+
+  char name[32] = {0};
+  ssize_t n = read(fd, name, sizeof(name) - 1);
+  close(fd);
+  mt->io_syscalls += 2;
+  if (n <= 0) return;
+  name[strcspn(name, " \t\r\n")] = 0;
+
+  uint32_t core_id = MMR_CORE_UNKNOWN;
+  if (strcmp(name, "nes") == 0) core_id = MMR_CORE_NES;
+  else if (strcmp(name, "snes") == 0) core_id = MMR_CORE_SNES;
+  else if (strcmp(name, "genesis") == 0) core_id = MMR_CORE_GENESIS;
+
+  if (core_id != MMR_CORE_UNKNOWN && core_id != mt->mock_core_id) {
+    (void)mock_set_core(mt, core_id);
+  }
+}
+
 bool memtap_open_mock(memtap_t *mt, const char *mock_dir, uint32_t core_id) {
   memset(mt, 0, sizeof(*mt));
   mt->backend = MEMTAP_BACKEND_MOCK;
   mt->fd = -1;
-  mt->mock_core_id = core_id;
   snprintf(mt->mock_dir, sizeof(mt->mock_dir), "%s", mock_dir);
 
-  // Populate a minimal region list based on core_id
-  mt->mock_region_count = 0;
-  if (core_id == MMR_CORE_NES) {
-    mt->mock_regions[mt->mock_region_count++] = (struct mmr_region_desc){
-      .region_id = MMR_REGION_NES_CPU_RAM, .flags = MMR_RF_SNAPSHOT, .size_bytes = default_region_size(MMR_REGION_NES_CPU_RAM)
-    };
-  } else if (core_id == MMR_CORE_SNES) {
-    mt->mock_regions[mt->mock_region_count++] = (struct mmr_region_desc){
-      .region_id = MMR_REGION_SNES_WRAM, .flags = MMR_RF_SNAPSHOT, .size_bytes = default_region_size(MMR_REGION_SNES_WRAM)
-    };
-  } else if (core_id == MMR_CORE_GENESIS) {
-    mt->mock_regions[mt->mock_region_count++] = (struct mmr_region_desc){
-      .region_id = MMR_REGION_GEN_68K_RAM, .flags = MMR_RF_SNAPSHOT, .size_bytes = default_region_size(MMR_REGION_GEN_68K_RAM)
-    };
-  } else {
-    notify(NOTIFY_ERR, "mock core_id %u not supported", core_id);
-    return false;
-  }
+  if (!mock_set_core(mt, core_id)) return false;
 
   mt->selected_region = mt->mock_regions[0].region_id;
   mt->seek_offset = 0;
@@ -78,25 +110,37 @@ void memtap_close(memtap_t *mt) {
     close(mt->fd);
   }
   mt->fd = -1;
+  free(mt->dirty_bitmap);
+  mt->dirty_bitmap = NULL;
+  mt->dirty_bitmap_bytes = 0;
 }
 
 bool memtap_get_info(memtap_t *mt, struct mmr_info *out) {
   if (!mt || !out) return false;
 
   if (mt->backend == MEMTAP_BACKEND_DEVICE) {
+    mt->io_syscalls++;
     if (ioctl(mt->fd, MMR_IOCTL_GET_INFO, out) != 0) {
-      notify(NOTIFY_ERR, "ioctl(GET_INFO) failed: %s", strerror(errno));
+      /* the request size is part of the ioctl number, so an ABI 1 driver
+       * does not recognise this one at all */
+      if (errno == ENOTTY) {
+        notify(NOTIFY_ERR, "ioctl(GET_INFO) failed: %s (driver older than ABI %d?)", strerror(errno), MMR_ABI_VERSION);
+      } else {
+        notify(NOTIFY_ERR, "ioctl(GET_INFO) failed: %s", strerror(errno));
+      }
       return false;
     }
     return true;
   }
 
   // mock
+  mock_poll_core(mt);
   out->abi_version = MMR_ABI_VERSION;
   out->core_id = mt->mock_core_id;
-  out->map_version = 1;
+  out->map_version = mt->mock_map_version;
   out->region_count = mt->mock_region_count;
   out->frame_counter = mt->mock_frame_counter;
+  out->publish_ns = 0;   /* snapshot files carry no publish time */
   return true;
 }
 
@@ -105,6 +149,7 @@ bool memtap_get_regions(memtap_t *mt, struct mmr_region_desc *out16, uint32_t *o
 
   if (mt->backend == MEMTAP_BACKEND_DEVICE) {
     struct mmr_region_desc tmp[16] = {0};
+    mt->io_syscalls++;
     if (ioctl(mt->fd, MMR_IOCTL_GET_REGIONS, tmp) != 0) {
       notify(NOTIFY_ERR, "ioctl(GET_REGIONS) failed: %s", strerror(errno));
       return false;
@@ -129,12 +174,14 @@ bool memtap_select_region(memtap_t *mt, uint32_t region_id) {
   if (!mt) return false;
 
   if (mt->backend == MEMTAP_BACKEND_DEVICE) {
+    mt->io_syscalls++;
     if (ioctl(mt->fd, MMR_IOCTL_SELECT_REGION, &region_id) != 0) {
       notify(NOTIFY_ERR, "ioctl(SELECT_REGION=%u) failed: %s", region_id, strerror(errno));
       return false;
     }
     mt->selected_region = region_id;
     mt->seek_offset = 0;
+    mt->dirty_frame = 0;
     return true;
   }
 
@@ -155,8 +202,9 @@ bool memtap_seek(memtap_t *mt, uint32_t offset) {
 
   if (mt->backend == MEMTAP_BACKEND_DEVICE) {
     struct mmr_seek_req req = {.offset = offset, .reserved = 0};
+    mt->io_syscalls++;
     if (ioctl(mt->fd, MMR_IOCTL_SEEK, &req) != 0) {
-      notify(NOTIFY_ERR, "ioctl(SEEK=%u) failed: %s", offset, strerror(errno));
+      notify_limited(NOTIFY_ERR, "ioctl(SEEK=%u) failed: %s", offset, strerror(errno));
       return false;
     }
     mt->seek_offset = offset;
@@ -174,13 +222,15 @@ ssize_t memtap_read(memtap_t *mt, void *buf, size_t len) {
   if (mt->backend == MEMTAP_BACKEND_DEVICE) {
     // assume kernel keeps file position for region/seek; plain read()
     ssize_t r = read(mt->fd, buf, len);
-    if (r < 0) notify(NOTIFY_ERR, "read() failed: %s", strerror(errno));
+    mt->io_syscalls++;
+    if (r < 0) notify_limited(NOTIFY_ERR, "read() failed: %s", strerror(errno));
+    else mt->io_bytes += (uint64_t)r;
     return r;
   }
 
   const char *fname = mock_file_for_region(mt->selected_region);
   if (!fname) {
-    notify(NOTIFY_ERR, "mock: no file mapping for region %u", mt->selected_region);
+    notify_limited(NOTIFY_ERR, "mock: no file mapping for region %u", mt->selected_region);
     return -1;
   }
 
@@ -188,29 +238,64 @@ ssize_t memtap_read(memtap_t *mt, void *buf, size_t len) {
   snprintf(path, sizeof(path), "%s/%s", mt->mock_dir, fname);
 
   int fd = open(path, O_RDONLY);
+  mt->io_syscalls++;
   if (fd < 0) {
-    notify(NOTIFY_ERR, "mock: open(%s) failed: %s", path, strerror(errno));
+    notify_limited(NOTIFY_ERR, "mock: open(%s) failed: %s", path, strerror(errno));
     return -1;
   }
 
+  mt->io_syscalls += 2;   // lseek + the close on either path
   if (lseek(fd, (off_t)mt->seek_offset, SEEK_SET) < 0) {
-    notify(NOTIFY_ERR, "mock: lseek(%u) failed: %s", mt->seek_offset, strerror(errno));
+    notify_limited(NOTIFY_ERR, "mock: lseek(%u) failed: %s", mt->seek_offset, strerror(errno));
     close(fd);
     return -1;
   }
 
   ssize_t r = read(fd, buf, len);
-  if (r < 0) notify(NOTIFY_ERR, "mock: read failed: %s", strerror(errno));
+  mt->io_syscalls++;
+  if (r < 0) notify_limited(NOTIFY_ERR, "mock: read failed: %s", strerror(errno));
+  else mt->io_bytes += (uint64_t)r;
   close(fd);
   return r;
 }
 
+bool memtap_read_frame(memtap_t *mt, void *buf, size_t len, uint64_t after_seq, struct mmr_frame_req *out) {
+  if (!mt || !buf || !out) return false;
+
+  // mock snapshots are files rewritten in place: there is no history to read
+  if (mt->backend != MEMTAP_BACKEND_DEVICE || mt->history_unsupported) {
+    mt->history_unsupported = true;
+    return false;
+  }
+
+  memset(out, 0, sizeof(*out));
+  out->after_seq = after_seq;
+  out->data_ptr = (uint64_t)(uintptr_t)buf;
+  out->size = (uint32_t)len;
+
+  mt->io_syscalls++;
+  if (ioctl(mt->fd, MMR_IOCTL_READ_FRAME, out) != 0) {
+    if (errno == ENOTTY) {
+      notify(NOTIFY_INFO, "READ_FRAME not supported by driver; missed frames cannot be caught up");
+      mt->history_unsupported = true;
+      return false;
+    }
+    notify_limited(NOTIFY_ERR, "ioctl(READ_FRAME) failed: %s", strerror(errno));
+    return false;
+  }
+  mt->io_bytes += (uint64_t)len;
+  mt->frame_ns = out->publish_ns;
+  if (mt->ingest) mt->ingest((uint8_t*)buf, len);
+  return true;
+}
+
 bool memtap_wait_frame(memtap_t *mt, uint64_t last_frame, uint32_t timeout_ms) {
   if (!mt) return false;
 
   if (mt->backend == MEMTAP_BACKEND_DEVICE) {
+    mt->io_syscalls++;
     if (ioctl(mt->fd, MMR_IOCTL_WAIT_FRAME, &last_frame) != 0) {
-      notify(NOTIFY_ERR, "ioctl(WAIT_FRAME) failed: %s", strerror(errno));
+      notify_limited(NOTIFY_ERR, "ioctl(WAIT_FRAME) failed: %s", strerror(errno));
       return false;
     }
     return true;
@@ -222,3 +307,115 @@ bool memtap_wait_frame(memtap_t *mt, uint64_t last_frame, uint32_t timeout_ms) {
   mt->mock_frame_counter++;
   return true;
 }
+
+static inline bool bitmap_test(const uint8_t *bits, uint32_t i) {
+  return (bits[i >> 3] >> (i & 7u)) & 1u;
+}
+
+static ssize_t read_full(memtap_t *mt, void *buf, size_t len, int32_t *out_dirty_pages) {
+  *out_dirty_pages = -1;
+  mt->frame_ns = 0;
+  if (!memtap_seek(mt, 0)) return -1;
+  ssize_t r = memtap_read(mt, buf, len);
+  if (r > 0 && mt->ingest) mt->ingest((uint8_t*)buf, (size_t)r);
+  return r;
+}
+
+ssize_t memtap_read_dirty(memtap_t *mt, void *buf, size_t len, int32_t *out_dirty_pages) {
+  if (!mt || !buf || !out_dirty_pages) return -1;
+
+  if (mt->backend != MEMTAP_BACKEND_DEVICE || mt->dirty_unsupported) {
+    return read_full(mt, buf, len, out_dirty_pages);
+  }
+
+  uint32_t pages = (uint32_t)((len + MMR_DIRTY_PAGE_SIZE - 1) >> MMR_DIRTY_PAGE_SHIFT);
+  uint32_t nbytes = (pages + 7u) / 8u;
+  if (mt->dirty_bitmap_bytes < nbytes) {
+    uint8_t *nb = (uint8_t*)realloc(mt->dirty_bitmap, nbytes);
+    if (!nb) return read_full(mt, buf, len, out_dirty_pages);
+    mt->dirty_bitmap = nb;
+    mt->dirty_bitmap_bytes = nbytes;
+  }
+
+  struct mmr_dirty_req req;
+  memset(&req, 0, sizeof(req));
+  req.since_frame = mt->dirty_frame;
+  req.bitmap_ptr = (uint64_t)(uintptr_t)mt->dirty_bitmap;
+  req.bitmap_bytes = mt->dirty_bitmap_bytes;
+
+  mt->io_syscalls++;
+  if (ioctl(mt->fd, MMR_IOCTL_GET_DIRTY, &req) != 0) {
+    if (errno == ENOTTY) {
+      notify(NOTIFY_INFO, "GET_DIRTY not supported by driver; using full-region reads");
+      mt->dirty_unsupported = true;
+      return read_full(mt, buf, len, out_dirty_pages);
+    }
+    // EINVAL: no region selected right now (a core switch in progress);
+    // tracking resumes on the next call
+    if (errno == EINVAL) {
+      notify_limited(NOTIFY_WARN, "ioctl(GET_DIRTY) failed: %s; reading in full", strerror(errno));
+      mt->dirty_frame = 0;
+      return read_full(mt, buf, len, out_dirty_pages);
+    }
+    notify_limited(NOTIFY_ERR, "ioctl(GET_DIRTY) failed: %s", strerror(errno));
+    return -1;
+  }
+
+  if (req.page_count < pages) pages = req.page_count;
+
+  // coalesce runs of dirty pages into one seek+read each
+  uint8_t *dst = (uint8_t*)buf;
+  int32_t dirty = 0;
+  uint32_t p = 0;
+  while (p < pages) {
+    if (!bitmap_test(mt->dirty_bitmap, p)) {
+      p++;
+      continue;
+    }
+    uint32_t q = p + 1;
+    while (q < pages && bitmap_test(mt->dirty_bitmap, q)) q++;
+
+    size_t off = (size_t)p << MMR_DIRTY_PAGE_SHIFT;
+    size_t end = (size_t)q << MMR_DIRTY_PAGE_SHIFT;
+    if (end > len) end = len;
+
+    if (!memtap_seek(mt, (uint32_t)off)) return -1;
+    ssize_t r = memtap_read(mt, dst + off, end - off);
+    if (r < 0 || (size_t)r != end - off) {
+      notify_limited(NOTIFY_ERR, "dirty read at 0x%zx got %zd (expected %zu)", off, r, end - off);
+      return -1;
+    }
+    // clean pages were converted when they were last read
+    if (mt->ingest) mt->ingest(dst + off, end - off);
+
+    dirty += (int32_t)(q - p);
+    p = q;
+  }
+
+  // Each read() copies from the snapshot current at the time, so runs read
+  // across a publish would mix two frames. Ask the driver again which frame
+  // is current (the bitmap is no longer needed); if it moved, replace the
+  // copy with one full read, which comes from a single snapshot.
+  if (dirty) {
+    struct mmr_dirty_req chk = req;
+    chk.since_frame = req.frame_counter;
+    mt->io_syscalls++;
+    if (ioctl(mt->fd, MMR_IOCTL_GET_DIRTY, &chk) != 0) {
+      notify_limited(NOTIFY_ERR, "ioctl(GET_DIRTY) failed: %s", strerror(errno));
+      return -1;
+    }
+    if (chk.frame_counter != req.frame_counter) {
+      mt->torn_rereads++;
+      ssize_t r = read_full(mt, buf, len, out_dirty_pages);
+      // the full read is of chk.frame_counter or later: pages published
+      // after it are reported again, at worst once more than needed
+      if (r >= 0) mt->dirty_frame = chk.frame_counter;
+      return r;
+    }
+  }
+
+  mt->dirty_frame = req.frame_counter;
+  mt->frame_ns = req.publish_ns;
+  *out_dirty_pages = dirty;
+  return (ssize_t)len;
+}
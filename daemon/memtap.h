@@ -17,15 +17,40 @@ typedef struct {
   uint32_t selected_region;
   uint32_t seek_offset;
 
+  // device mode: dirty-page tracking (GET_DIRTY)
+  uint8_t *dirty_bitmap;
+  uint32_t dirty_bitmap_bytes;
+  uint64_t dirty_frame;       // frame of the last tracked copy (0 = none yet)
+  bool dirty_unsupported;     // driver lacks GET_DIRTY; always read in full
+  bool history_unsupported;   // driver lacks READ_FRAME (and mock mode)
+
+  // publish_ns of the frame the last read_dirty/read_frame copied (0 when
+  // unknown: full-read fallback, mock mode)
+  uint64_t frame_ns;
+
+  // ingest stage of the selected region's core (an adapter_ingest_fn, see
+  // adapters.h), applied to every block read_dirty/read_frame copy into the
+  // caller's buffer; memtap_read itself returns the bytes as they are
+  void (*ingest)(uint8_t *p, size_t len);
+
+  // I/O accounting, both modes (reported by mmr-iobench): syscalls issued
+  // and bytes copied out by read()
+  uint64_t io_syscalls;
+  uint64_t io_bytes;
+  uint64_t torn_rereads;      // read_dirty copies redone in full (publish mid-copy)
+
   // mock mode
   char mock_dir[512];
   uint32_t mock_core_id;
+  uint32_t mock_map_version;    // bumped when <mock_dir>/core names a new core
   uint64_t mock_frame_counter;
   uint32_t mock_region_count;
   struct mmr_region_desc mock_regions[16];
 } memtap_t;
 
 bool memtap_open_device(memtap_t *mt, const char *devnode);
+// Mock mode starts on core_id. Writing nes|snes|genesis to <mock_dir>/core
+// switches cores the way the driver's SET_CORE does (seen via get_info).
 bool memtap_open_mock(memtap_t *mt, const char *mock_dir, uint32_t core_id);
 
 void memtap_close(memtap_t *mt);
@@ -38,4 +63,19 @@ bool memtap_seek(memtap_t *mt, uint32_t offset);
 
 ssize_t memtap_read(memtap_t *mt, void *buf, size_t len);
 
+// Refresh buf, which holds the selected region as of an earlier call, by
+// re-reading only the pages the driver reports changed. Falls back to a full
+// read (seek 0 + read) when page tracking is unavailable, e.g. in mock mode.
+// *out_dirty_pages is the number of pages re-read, or -1 after a full read
+// (the caller then has to detect changes itself). The result is always one
+// published frame: when a frame is published while the runs are read, the
+// copy is redone with a single full read.
+ssize_t memtap_read_dirty(memtap_t *mt, void *buf, size_t len, int32_t *out_dirty_pages);
+
+// Copy the oldest frame of the selected region newer than after_seq (the
+// latest when none is) into buf, with its seq and how far the driver is
+// ahead in *out; see struct mmr_frame_req. Returns false on error, and on a
+// driver without READ_FRAME, which also sets history_unsupported.
+bool memtap_read_frame(memtap_t *mt, void *buf, size_t len, uint64_t after_seq, struct mmr_frame_req *out);
+
 bool memtap_wait_frame(memtap_t *mt, uint64_t last_frame, uint32_t timeout_ms);
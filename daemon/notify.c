@@ -1,10 +1,76 @@
 #include "notify.h"
-#include <stdio.h>
+
+#include <errno.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
 #include <time.h>
+#include <unistd.h>
+
+#define WRITER_IDLE_MAX_NS 1000000000ull   // safety net; producers wake the writer
+#define WRITER_BATCH        8192u
+#define OUT_WAIT_NS         1000000ull      // a blocked notify_print re-checks this often
+
+enum { STREAM_ERR = 0, STREAM_OUT = 1 };
+
+typedef struct {
+  uint32_t seq;             // == position + 1 once published, position + slots once drained
+  uint8_t level;
+  uint8_t stream;
+  uint16_t len;
+  uint64_t real_ns;
+  uint64_t origin_ns;       // notify_print_frame: CLOCK_MONOTONIC stamps, else 0
+  uint64_t eval_ns;
+  char text[NOTIFY_LINE_MAX];
+} slot_t;
+
+/* Multi-producer, single-consumer ring. The stderr ring drops a message when
+ * it is full; the stdout ring makes the producer wait for the writer. */
+typedef struct {
+  slot_t *slots;
+  uint32_t mask;
+  bool lossless;
+  uint32_t head;            // next position to claim (producers, CAS)
+  uint32_t tail;            // next position to drain (writer only)
+} ring_t;
+
+static slot_t g_err_slots[NOTIFY_RING_SLOTS];
+static slot_t g_out_slots[NOTIFY_OUT_SLOTS];
+static ring_t g_err = { g_err_slots, NOTIFY_RING_SLOTS - 1u, false, 0, 0 };
+static ring_t g_out = { g_out_slots, NOTIFY_OUT_SLOTS - 1u, true, 0, 0 };
+static uint64_t g_dropped;  // stderr messages lost to a full ring
+static uint64_t g_stalls;   // stdout lines that had to wait for a slot
+
+/* futex words: g_wake is bumped to wake an idle writer, g_drained after each
+ * drain pass for producers blocked on a full stdout ring */
+static uint32_t g_wake;
+static uint32_t g_writer_idle;
+static uint32_t g_drained;
+static uint32_t g_blocked;
+
+static bool g_async;        // producers enqueue instead of writing
+static bool g_stopping;
+static bool g_running;
+static pthread_t g_writer;
+
+/* writer-only state (and the caller's while logging is synchronous) */
+static char g_batch[2][WRITER_BATCH];
+static size_t g_batch_len[2];
+static time_t g_ts_sec = -1;
+static char g_ts_text[32];
+static lat_hist_t g_lat_deliver;
+static lat_hist_t g_lat_unlock;
+
+_Static_assert((NOTIFY_RING_SLOTS & (NOTIFY_RING_SLOTS - 1u)) == 0, "ring size must be a power of two");
+_Static_assert((NOTIFY_OUT_SLOTS & (NOTIFY_OUT_SLOTS - 1u)) == 0, "ring size must be a power of two");
 
 static const char* lvl_str(notify_level_t lvl) {
   switch (lvl) {
+    case NOTIFY_DEBUG: return "DEBUG";
     case NOTIFY_INFO: return "INFO";
     case NOTIFY_WARN: return "WARN";
     case NOTIFY_ERR:  return "ERR";
@@ -12,17 +78,347 @@ static const char* lvl_str(notify_level_t lvl) {
   }
 }
 
-void notify(notify_level_t lvl, const char *fmt, ...) {
-  time_t t = time(NULL);
+static uint64_t clock_ns(clockid_t id) {
+  struct timespec ts;
+  clock_gettime(id, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void format_time(time_t t, char *buf, size_t cap) {
   struct tm tmv;
   localtime_r(&t, &tmv);
-  char buf[32];
-  strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tmv);
+  strftime(buf, cap, "%Y-%m-%d %H:%M:%S", &tmv);
+}
+
+static void futex_wait(uint32_t *addr, uint32_t val, uint64_t timeout_ns) {
+  struct timespec ts = { (time_t)(timeout_ns / 1000000000ull), (long)(timeout_ns % 1000000000ull) };
+  (void)syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, &ts, NULL, 0);
+}
+
+static void futex_wake(uint32_t *addr, int n) {
+  (void)syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+/* Only costs a syscall when the writer is actually asleep. The fence pairs
+ * with the writer's between setting g_writer_idle and re-checking the rings. */
+static void wake_writer(void) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&g_writer_idle, __ATOMIC_RELAXED)) {
+    __atomic_add_fetch(&g_wake, 1u, __ATOMIC_RELEASE);
+    futex_wake(&g_wake, 1);
+  }
+}
+
+/* ---- producer side ---- */
+
+static void ring_push(ring_t *r, int stream, notify_level_t lvl, uint64_t origin_ns, uint64_t eval_ns,
+                      const char *fmt, va_list ap) {
+  uint32_t pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+  slot_t *s;
+  bool stalled = false;
+  for (;;) {
+    s = &r->slots[pos & r->mask];
+    int32_t diff = (int32_t)(__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) - pos);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&r->head, &pos, pos + 1u, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+    } else if (diff < 0 && !r->lossless) {
+      /* the writer has not drained this slot from the previous lap */
+      __atomic_add_fetch(&g_dropped, 1, __ATOMIC_RELAXED);
+      wake_writer();
+      return;
+    } else if (diff < 0) {
+      /* stdout lines are never dropped: wait for the writer to free the slot */
+      if (!stalled) __atomic_add_fetch(&g_stalls, 1, __ATOMIC_RELAXED);
+      stalled = true;
+      uint32_t drained = __atomic_load_n(&g_drained, __ATOMIC_ACQUIRE);
+      __atomic_add_fetch(&g_blocked, 1u, __ATOMIC_SEQ_CST);
+      if ((int32_t)(__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) - pos) < 0) {
+        __atomic_add_fetch(&g_wake, 1u, __ATOMIC_RELEASE);
+        futex_wake(&g_wake, 1);
+        futex_wait(&g_drained, drained, OUT_WAIT_NS);
+      }
+      __atomic_sub_fetch(&g_blocked, 1u, __ATOMIC_SEQ_CST);
+      pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    } else {
+      pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    }
+  }
 
-  fprintf(stderr, "[%s] %s: ", buf, lvl_str(lvl));
+  int n = vsnprintf(s->text, sizeof(s->text), fmt, ap);
+  s->len = (uint16_t)(n < 0 ? 0 : ((size_t)n >= sizeof(s->text) ? sizeof(s->text) - 1u : (size_t)n));
+  s->level = (uint8_t)lvl;
+  s->stream = (uint8_t)stream;
+  s->real_ns = clock_ns(CLOCK_REALTIME);
+  s->origin_ns = origin_ns;
+  s->eval_ns = eval_ns;
+  __atomic_store_n(&s->seq, pos + 1u, __ATOMIC_RELEASE);
+  wake_writer();
+}
+
+/* A frame's output line has reached stdout (write(2) returned). */
+static void record_delivery(uint64_t origin_ns, uint64_t eval_ns) {
+  if (!origin_ns) return;
+  uint64_t now = clock_ns(CLOCK_MONOTONIC);
+  lat_add(&g_lat_deliver, now > eval_ns ? now - eval_ns : 0);
+  lat_add(&g_lat_unlock, now > origin_ns ? now - origin_ns : 0);
+}
+
+void notify_emit(notify_level_t lvl, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  if (__atomic_load_n(&g_async, __ATOMIC_ACQUIRE)) {
+    ring_push(&g_err, STREAM_ERR, lvl, 0, 0, fmt, ap);
+  } else {
+    char buf[32];
+    format_time(time(NULL), buf, sizeof(buf));
+    fprintf(stderr, "[%s] %s: ", buf, lvl_str(lvl));
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+  }
+  va_end(ap);
+}
+
+static void print_v(uint64_t origin_ns, uint64_t eval_ns, const char *fmt, va_list ap) {
+  if (__atomic_load_n(&g_async, __ATOMIC_ACQUIRE)) {
+    ring_push(&g_out, STREAM_OUT, NOTIFY_INFO, origin_ns, eval_ns, fmt, ap);
+  } else {
+    vfprintf(stdout, fmt, ap);
+    fflush(stdout);
+    record_delivery(origin_ns, eval_ns);
+  }
+}
+
+void notify_print(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  print_v(0, 0, fmt, ap);
+  va_end(ap);
+}
+
+void notify_print_frame(uint64_t origin_ns, uint64_t eval_ns, const char *fmt, ...) {
   va_list ap;
   va_start(ap, fmt);
-  vfprintf(stderr, fmt, ap);
+  print_v(origin_ns, eval_ns, fmt, ap);
   va_end(ap);
-  fputc('\n', stderr);
+}
+
+bool notify_limit_pass(notify_limit_t *rl, notify_level_t lvl, const char *file, int line) {
+  uint64_t now = clock_ns(CLOCK_MONOTONIC);
+  if (rl->window_start_ns == 0 || now - rl->window_start_ns >= NOTIFY_LIMIT_WINDOW_NS) {
+    if (rl->suppressed) {
+      notify_emit(lvl, "%u similar message(s) suppressed (%s:%d)", rl->suppressed, file, line);
+    }
+    rl->window_start_ns = now;
+    rl->passed = 0;
+    rl->suppressed = 0;
+  }
+  if (rl->passed < NOTIFY_LIMIT_BURST) {
+    rl->passed++;
+    return true;
+  }
+  rl->suppressed++;
+  return false;
+}
+
+uint64_t notify_dropped(void) {
+  return __atomic_load_n(&g_dropped, __ATOMIC_RELAXED);
+}
+
+uint64_t notify_stalls(void) {
+  return __atomic_load_n(&g_stalls, __ATOMIC_RELAXED);
+}
+
+void notify_delivery_latency(lat_hist_t *deliver, lat_hist_t *unlock) {
+  if (deliver) *deliver = g_lat_deliver;
+  if (unlock) *unlock = g_lat_unlock;
+}
+
+/* ---- writer side ---- */
+
+static void write_all(int fd, const char *p, size_t n) {
+  while (n > 0) {
+    ssize_t w = write(fd, p, n);
+    if (w < 0) {
+      if (errno == EINTR) continue;
+      return;   /* nowhere left to report it */
+    }
+    p += w;
+    n -= (size_t)w;
+  }
+}
+
+static void batch_flush(int stream) {
+  if (g_batch_len[stream]) {
+    write_all(stream == STREAM_OUT ? STDOUT_FILENO : STDERR_FILENO, g_batch[stream], g_batch_len[stream]);
+    g_batch_len[stream] = 0;
+  }
+}
+
+static void batch_append(int stream, const char *p, size_t n) {
+  if (g_batch_len[stream] + n > WRITER_BATCH) batch_flush(stream);
+  memcpy(g_batch[stream] + g_batch_len[stream], p, n);
+  g_batch_len[stream] += n;
+}
+
+static void append_stderr_line(uint64_t real_ns, notify_level_t lvl, const char *text, size_t len) {
+  time_t sec = (time_t)(real_ns / 1000000000ull);
+  if (sec != g_ts_sec) {
+    format_time(sec, g_ts_text, sizeof(g_ts_text));
+    g_ts_sec = sec;
+  }
+  char prefix[48];
+  int n = snprintf(prefix, sizeof(prefix), "[%s] %s: ", g_ts_text, lvl_str(lvl));
+  batch_append(STREAM_ERR, prefix, (size_t)n);
+  batch_append(STREAM_ERR, text, len);
+  batch_append(STREAM_ERR, "\n", 1);
+}
+
+static bool ring_ready(const ring_t *r) {
+  const slot_t *s = &r->slots[r->tail & r->mask];
+  return __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) == r->tail + 1u;
+}
+
+/* Moves published slots into the batch; a stdout slot's delivery stamps go
+ * to stamps[] (up to cap) to be recorded once the batch is written. */
+static size_t drain_ring(ring_t *r, uint64_t (*stamps)[2], size_t cap, size_t *nstamps) {
+  size_t n = 0;
+  while (ring_ready(r)) {
+    slot_t *s = &r->slots[r->tail & r->mask];
+
+    if (s->stream == STREAM_OUT) {
+      if (g_batch_len[STREAM_OUT] + s->len + 1u > WRITER_BATCH) {
+        batch_flush(STREAM_OUT);
+        for (size_t i = 0; i < *nstamps; i++) record_delivery(stamps[i][0], stamps[i][1]);
+        *nstamps = 0;
+      }
+      batch_append(STREAM_OUT, s->text, s->len);
+      /* a line cut at NOTIFY_LINE_MAX still ends the line */
+      if (s->len == NOTIFY_LINE_MAX - 1u && s->text[s->len - 1u] != '\n') batch_append(STREAM_OUT, "\n", 1);
+      if (s->origin_ns && *nstamps < cap) {
+        stamps[*nstamps][0] = s->origin_ns;
+        stamps[*nstamps][1] = s->eval_ns;
+        (*nstamps)++;
+      }
+    } else {
+      append_stderr_line(s->real_ns, (notify_level_t)s->level, s->text, s->len);
+    }
+
+    __atomic_store_n(&s->seq, r->tail + r->mask + 1u, __ATOMIC_RELEASE);
+    r->tail++;
+    n++;
+  }
+  return n;
+}
+
+static size_t drain(void) {
+  /* a batch holds at most WRITER_BATCH / 2 lines (each at least "x\n") */
+  static uint64_t stamps[WRITER_BATCH / 2u][2];
+  size_t nstamps = 0;
+
+  size_t n = drain_ring(&g_out, stamps, WRITER_BATCH / 2u, &nstamps);
+  n += drain_ring(&g_err, stamps, 0, &nstamps);
+  batch_flush(STREAM_OUT);
+  for (size_t i = 0; i < nstamps; i++) record_delivery(stamps[i][0], stamps[i][1]);
+  batch_flush(STREAM_ERR);
+
+  if (n) {
+    /* release producers waiting on a full stdout ring */
+    __atomic_add_fetch(&g_drained, 1u, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&g_blocked, __ATOMIC_RELAXED)) futex_wake(&g_drained, INT32_MAX);
+  }
+  return n;
+}
+
+static void report_drops(uint64_t *reported, uint64_t *stalls_reported) {
+  char line[96];
+  uint64_t d = notify_dropped();
+  if (d != *reported) {
+    int n = snprintf(line, sizeof(line), "log: %llu message(s) dropped (ring full)",
+                     (unsigned long long)(d - *reported));
+    append_stderr_line(clock_ns(CLOCK_REALTIME), NOTIFY_WARN, line, (size_t)n);
+    *reported = d;
+  }
+  uint64_t st = notify_stalls();
+  if (st != *stalls_reported) {
+    int n = snprintf(line, sizeof(line), "log: %llu stdout line(s) waited for the writer (ring full)",
+                     (unsigned long long)(st - *stalls_reported));
+    append_stderr_line(clock_ns(CLOCK_REALTIME), NOTIFY_WARN, line, (size_t)n);
+    *stalls_reported = st;
+  }
+  batch_flush(STREAM_ERR);
+}
+
+static bool rings_empty(void) {
+  return !ring_ready(&g_out) && !ring_ready(&g_err);
+}
+
+static void *writer_main(void *arg) {
+  (void)arg;
+  uint64_t reported = 0, stalls_reported = 0;
+
+  for (;;) {
+    if (drain()) {
+      report_drops(&reported, &stalls_reported);
+      continue;
+    }
+    report_drops(&reported, &stalls_reported);
+    if (__atomic_load_n(&g_stopping, __ATOMIC_ACQUIRE) &&
+        __atomic_load_n(&g_out.head, __ATOMIC_ACQUIRE) == g_out.tail &&
+        __atomic_load_n(&g_err.head, __ATOMIC_ACQUIRE) == g_err.tail) {
+      break;
+    }
+
+    /* sleep until a producer publishes; the fence pairs with wake_writer's */
+    uint32_t w = __atomic_load_n(&g_wake, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&g_writer_idle, 1u, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (rings_empty() && !__atomic_load_n(&g_stopping, __ATOMIC_ACQUIRE)) {
+      futex_wait(&g_wake, w, WRITER_IDLE_MAX_NS);
+    }
+    __atomic_store_n(&g_writer_idle, 0u, __ATOMIC_RELAXED);
+  }
+  return NULL;
+}
+
+bool notify_start(void) {
+  if (g_running) return true;
+
+  ring_t *rings[] = { &g_err, &g_out };
+  for (size_t r = 0; r < 2; r++) {
+    for (uint32_t i = 0; i <= rings[r]->mask; i++) rings[r]->slots[i].seq = i;
+    rings[r]->head = 0;
+    rings[r]->tail = 0;
+  }
+  g_stopping = false;
+
+  /* load the zone now, not on the writer's first message (tzset may allocate) */
+  tzset();
+  fflush(stdout);
+  fflush(stderr);
+
+  /* signals stay with the frame thread */
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  int rc = pthread_create(&g_writer, NULL, writer_main, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (rc != 0) {
+    notify_emit(NOTIFY_WARN, "log: writer thread not started (%s); logging synchronously", strerror(rc));
+    return false;
+  }
+
+  g_running = true;
+  __atomic_store_n(&g_async, true, __ATOMIC_RELEASE);
+  return true;
+}
+
+void notify_stop(void) {
+  if (!g_running) return;
+  __atomic_store_n(&g_async, false, __ATOMIC_RELEASE);
+  __atomic_store_n(&g_stopping, true, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&g_wake, 1u, __ATOMIC_RELEASE);
+  futex_wake(&g_wake, 1);
+  pthread_join(g_writer, NULL);
+  g_running = false;
 }
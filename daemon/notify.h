@@ -1,10 +1,90 @@
 #pragma once
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "latency.h"
+
+// Daemon logging.
+//
+// notify() writes "[time] LEVEL: message" to stderr; notify_print() writes a
+// line to stdout verbatim (the [ACH]/[INFO] lines scripts parse). Until
+// notify_start() they write synchronously. After it, both only format the
+// message into a slot of a fixed lock-free ring (multi-producer, one
+// consumer) together with a CLOCK_REALTIME stamp, and wake a background
+// writer thread (a futex, only when it is asleep), which turns the time into
+// text and hands batches to write(2). A caller never allocates.
+//
+// stderr and stdout have separate rings. The stderr ring is lossy: when it
+// is full the message is dropped and the writer reports how many were. The
+// stdout ring carries the lines scripts parse and never loses one: when it
+// is full the caller waits for the writer to drain it (reported as stalls).
+//
+// Levels below NOTIFY_MIN_LEVEL compile to nothing (the arguments are not
+// evaluated), e.g. make CFLAGS+=-DNOTIFY_MIN_LEVEL=0 to keep debug output.
+
 typedef enum {
-  NOTIFY_INFO = 0,
-  NOTIFY_WARN = 1,
-  NOTIFY_ERR  = 2,
+  NOTIFY_DEBUG = 0,
+  NOTIFY_INFO  = 1,
+  NOTIFY_WARN  = 2,
+  NOTIFY_ERR   = 3,
 } notify_level_t;
 
-void notify(notify_level_t lvl, const char *fmt, ...);
+#ifndef NOTIFY_MIN_LEVEL
+#define NOTIFY_MIN_LEVEL 1
+#endif
+
+#define NOTIFY_LINE_MAX     240u   // message bytes per ring slot (longer is cut)
+#define NOTIFY_RING_SLOTS   256u   // stderr; power of two
+#define NOTIFY_OUT_SLOTS    1024u  // stdout; power of two
+
+// Per-callsite limit for notify_limited(): this many messages per window,
+// then a count of the ones suppressed when the window rolls over.
+#define NOTIFY_LIMIT_BURST     5u
+#define NOTIFY_LIMIT_WINDOW_NS 1000000000ull
+
+typedef struct {
+  uint64_t window_start_ns;
+  uint32_t passed;
+  uint32_t suppressed;
+} notify_limit_t;
+
+void notify_emit(notify_level_t lvl, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void notify_print(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+// notify_print for a frame's output. origin_ns (the frame's origin) and
+// eval_ns (end of its evaluation) are CLOCK_MONOTONIC; once write(2) has
+// taken the line, the writer records how long after each that was (see
+// notify_delivery_latency). origin_ns == 0 records nothing.
+void notify_print_frame(uint64_t origin_ns, uint64_t eval_ns, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+bool notify_limit_pass(notify_limit_t *rl, notify_level_t lvl, const char *file, int line);
+
+#define notify(lvl, ...)                                      \
+  do {                                                        \
+    if ((int)(lvl) >= NOTIFY_MIN_LEVEL) notify_emit((lvl), __VA_ARGS__); \
+  } while (0)
+
+// For messages that can repeat every frame (read errors and the like).
+#define notify_limited(lvl, ...)                              \
+  do {                                                        \
+    static notify_limit_t notify_rl_;                         \
+    if ((int)(lvl) >= NOTIFY_MIN_LEVEL &&                     \
+        notify_limit_pass(&notify_rl_, (lvl), __FILE__, __LINE__)) \
+      notify_emit((lvl), __VA_ARGS__);                        \
+  } while (0)
+
+// Start / stop the writer thread. notify_stop() drains the ring first; both
+// are no-ops when already in that state. notify_start() returns false (and
+// logging stays synchronous) if the thread cannot be created.
+bool notify_start(void);
+void notify_stop(void);
+
+// stderr messages dropped because the ring was full.
+uint64_t notify_dropped(void);
+
+// stdout lines whose caller had to wait for a free slot.
+uint64_t notify_stalls(void);
+
+// Delivery latency of notify_print_frame lines, end of evaluation and frame
+// origin to written: copies of the writer's histograms, complete after
+// notify_stop().
+void notify_delivery_latency(lat_hist_t *deliver, lat_hist_t *unlock);
@@ -0,0 +1,229 @@
+#include "profile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../third_party/rcheevos/include/rc_runtime.h"
+#include "../third_party/rcheevos/include/rc_runtime_types.h"
+
+uint64_t prof_cond_tests = 0;
+
+/* rc_eval_state_t is internal to rcheevos; the wrap only passes it on */
+int __real_rc_test_condition(rc_condition_t *self, void *eval_state);
+int __wrap_rc_test_condition(rc_condition_t *self, void *eval_state);
+
+int __wrap_rc_test_condition(rc_condition_t *self, void *eval_state) {
+  prof_cond_tests++;
+  return __real_rc_test_condition(self, eval_state);
+}
+
+/* ---- per-entry timing inside rc_runtime_do_frame ---- */
+
+/* The runtime evaluates its triggers, then its leaderboards, each from the
+ * last index down, skipping entries it does not run. The cursors follow it
+ * so each call is matched to its entry without a search. */
+static prof_state_t *g_run;
+static const rc_runtime_t *g_run_rt;
+static uint32_t g_next_trigger;
+static uint32_t g_next_lboard;
+
+void prof_runtime_begin(prof_state_t *p, const rc_runtime_t *rt) {
+  g_run = NULL;
+  if (!p->sampling || p->trigger_count != rt->trigger_count || p->lboard_count != rt->lboard_count) return;
+  g_run = p;
+  g_run_rt = rt;
+  g_next_trigger = rt->trigger_count;
+  g_next_lboard = rt->lboard_count;
+}
+
+void prof_runtime_end(void) {
+  g_run = NULL;
+}
+
+int __real_rc_evaluate_trigger(rc_trigger_t *trigger, rc_peek_t peek, void *ud, void *unused_L);
+int __wrap_rc_evaluate_trigger(rc_trigger_t *trigger, rc_peek_t peek, void *ud, void *unused_L);
+
+int __wrap_rc_evaluate_trigger(rc_trigger_t *trigger, rc_peek_t peek, void *ud, void *unused_L) {
+  if (!g_run) return __real_rc_evaluate_trigger(trigger, peek, ud, unused_L);
+
+  uint32_t i = g_next_trigger;
+  while (i > 0 && g_run_rt->triggers[i - 1].trigger != trigger) i--;
+  if (i == 0) return __real_rc_evaluate_trigger(trigger, peek, ud, unused_L);
+  g_next_trigger = i - 1;
+
+  prof_mark_t m;
+  prof_mark(&m);
+  int state = __real_rc_evaluate_trigger(trigger, peek, ud, unused_L);
+  prof_account(&g_run->entries[i - 1], &m);
+  return state;
+}
+
+int __real_rc_evaluate_lboard(rc_lboard_t *lboard, int32_t *value, rc_peek_t peek, void *peek_ud, void *unused_L);
+int __wrap_rc_evaluate_lboard(rc_lboard_t *lboard, int32_t *value, rc_peek_t peek, void *peek_ud, void *unused_L);
+
+int __wrap_rc_evaluate_lboard(rc_lboard_t *lboard, int32_t *value, rc_peek_t peek, void *peek_ud, void *unused_L) {
+  if (!g_run) return __real_rc_evaluate_lboard(lboard, value, peek, peek_ud, unused_L);
+
+  uint32_t i = g_next_lboard;
+  while (i > 0 && g_run_rt->lboards[i - 1].lboard != lboard) i--;
+  if (i == 0) return __real_rc_evaluate_lboard(lboard, value, peek, peek_ud, unused_L);
+  g_next_lboard = i - 1;
+
+  prof_mark_t m;
+  prof_mark(&m);
+  int state = __real_rc_evaluate_lboard(lboard, value, peek, peek_ud, unused_L);
+  prof_account(&g_run->entries[g_run->trigger_count + i - 1], &m);
+  return state;
+}
+
+/* ---- memref footprint ---- */
+
+typedef struct {
+  const void **refs;
+  uint32_t count;
+  uint32_t cap;
+  bool oom;
+} ref_set_t;
+
+static void ref_add(ref_set_t *s, const rc_operand_t *op) {
+  if (!rc_operand_is_memref(op) || !op->value.memref) return;
+  if (s->count == s->cap) {
+    uint32_t cap = s->cap ? s->cap * 2u : 64u;
+    const void **r = (const void**)realloc((void*)s->refs, (size_t)cap * sizeof(*r));
+    if (!r) {
+      s->oom = true;
+      return;
+    }
+    s->refs = r;
+    s->cap = cap;
+  }
+  s->refs[s->count++] = op->value.memref;
+}
+
+static void ref_condsets(ref_set_t *s, const rc_condset_t *cs) {
+  for (; cs; cs = cs->next) {
+    for (const rc_condition_t *c = cs->conditions; c; c = c->next) {
+      ref_add(s, &c->operand1);
+      ref_add(s, &c->operand2);
+    }
+  }
+}
+
+static void ref_trigger(ref_set_t *s, const rc_trigger_t *t) {
+  ref_condsets(s, t->requirement);
+  ref_condsets(s, t->alternative);
+}
+
+static int ptr_cmp(const void *a, const void *b) {
+  uintptr_t x = (uintptr_t)*(const void *const *)a, y = (uintptr_t)*(const void *const *)b;
+  return x < y ? -1 : (x != y);
+}
+
+/* distinct entries collected since the set was last emptied */
+static uint32_t ref_distinct(ref_set_t *s) {
+  if (s->count == 0) return 0;
+  qsort((void*)s->refs, s->count, sizeof(*s->refs), ptr_cmp);
+  uint32_t n = 1;
+  for (uint32_t i = 1; i < s->count; i++) n += (s->refs[i] != s->refs[i - 1]);
+  s->count = 0;
+  return n;
+}
+
+/* ---- entries ---- */
+
+void prof_free(prof_state_t *p) {
+  free(p->entries);
+  memset(p, 0, sizeof(*p));
+}
+
+bool prof_index(prof_state_t *p, const rc_runtime_t *rt, const rc_richpresence_t *rp) {
+  uint32_t rng = p->rng;
+  prof_free(p);
+
+  uint32_t count = rt->trigger_count + rt->lboard_count + (rp ? 1u : 0u);
+  p->entries = (prof_entry_t*)calloc(count ? count : 1u, sizeof(*p->entries));
+  if (!p->entries) return false;
+
+  ref_set_t refs;
+  memset(&refs, 0, sizeof(refs));
+
+  for (uint32_t i = 0; i < rt->trigger_count; i++) {
+    prof_entry_t *e = &p->entries[p->count++];
+    e->kind = PROF_ACHIEVEMENT;
+    e->id = rt->triggers[i].id;
+    if (rt->triggers[i].trigger) ref_trigger(&refs, rt->triggers[i].trigger);
+    e->memrefs = ref_distinct(&refs);
+  }
+  for (uint32_t i = 0; i < rt->lboard_count; i++) {
+    prof_entry_t *e = &p->entries[p->count++];
+    const rc_lboard_t *lb = rt->lboards[i].lboard;
+    e->kind = PROF_LBOARD;
+    e->id = rt->lboards[i].id;
+    if (lb) {
+      ref_trigger(&refs, &lb->start);
+      ref_trigger(&refs, &lb->submit);
+      ref_trigger(&refs, &lb->cancel);
+      ref_condsets(&refs, lb->value.conditions);
+      if (lb->progress && lb->progress != &lb->value) ref_condsets(&refs, lb->progress->conditions);
+    }
+    e->memrefs = ref_distinct(&refs);
+  }
+  if (rp) {
+    prof_entry_t *e = &p->entries[p->count++];
+    e->kind = PROF_RICHPRESENCE;
+    for (const rc_richpresence_display_t *d = rp->first_display; d; d = d->next) ref_trigger(&refs, &d->trigger);
+    for (const rc_value_t *v = rp->values; v; v = v->next) ref_condsets(&refs, v->conditions);
+    e->memrefs = ref_distinct(&refs);
+  }
+  free((void*)refs.refs);
+  if (refs.oom) {
+    prof_free(p);
+    return false;
+  }
+
+  p->trigger_count = rt->trigger_count;
+  p->lboard_count = rt->lboard_count;
+  p->rng = rng ? rng : 0x2545F491u;
+  p->countdown = 1;
+  p->enabled = true;
+  return true;
+}
+
+void prof_begin_frame(prof_state_t *p) {
+  p->sampling = false;
+  if (!p->enabled) return;
+  p->frames++;
+  if (--p->countdown) return;
+
+  /* xorshift32: the next gap is uniform in [PERIOD/2, 3*PERIOD/2) */
+  p->rng ^= p->rng << 13;
+  p->rng ^= p->rng >> 17;
+  p->rng ^= p->rng << 5;
+  p->countdown = PROF_PERIOD / 2u + p->rng % PROF_PERIOD;
+  p->sampling = true;
+  p->samples++;
+}
+
+uint32_t prof_top(const prof_state_t *p, uint32_t *out, uint32_t n) {
+  /* ranked by sampled time, then by index; each row is the best entry
+   * ranked after the previous one */
+  uint32_t written = 0;
+  while (written < n) {
+    const prof_entry_t *prev = written ? &p->entries[out[written - 1]] : NULL;
+    uint32_t prev_idx = written ? out[written - 1] : 0;
+    bool found = false;
+    uint32_t best = 0;
+    for (uint32_t i = 0; i < p->count; i++) {
+      const prof_entry_t *e = &p->entries[i];
+      if (!e->samples) continue;
+      if (prev && (e->ns > prev->ns || (e->ns == prev->ns && i <= prev_idx))) continue;
+      if (!found || e->ns > p->entries[best].ns) {
+        best = i;
+        found = true;
+      }
+    }
+    if (!found) break;
+    out[written++] = best;
+  }
+  return written;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util.h"
+
+// Sampled per-entry cost profile for --profile-triggers.
+//
+// About one evaluated frame in PROF_PERIOD is a sample (the gap is jittered
+// so a game's own periodic work does not line up with it). On a sample the
+// engine times every trigger, leaderboard and the rich presence script on
+// its own and counts the conditions each one actually tested; every other
+// frame costs one decrement. Memrefs are updated in one shared pass before
+// any entry runs (memrefs.h), so that time is kept per frame, and an entry's
+// memory footprint is reported as the distinct memrefs its conditions read.
+//
+// Condition tests are counted by wrapping rcheevos' rc_test_condition at
+// link time (-Wl,--wrap=rc_test_condition, as rt.c does for malloc). The
+// engine runs the upstream rc_runtime_do_frame, so triggers and leaderboards
+// are timed the same way, by wrapping rc_evaluate_trigger and
+// rc_evaluate_lboard while prof_runtime_begin/_end bracket the call.
+
+#define PROF_PERIOD 16u
+
+typedef enum {
+  PROF_ACHIEVEMENT  = 0,
+  PROF_LBOARD       = 1,
+  PROF_RICHPRESENCE = 2,
+} prof_kind_t;
+
+typedef struct {
+  uint32_t id;
+  uint8_t kind;             // prof_kind_t
+  uint32_t memrefs;         // distinct memrefs its conditions read
+  uint64_t samples;
+  uint64_t ns;              // summed over samples
+  uint64_t max_ns;
+  uint64_t conds;           // conditions tested, summed over samples
+} prof_entry_t;
+
+typedef struct {
+  bool enabled;
+  bool sampling;            // the frame being evaluated is a sample
+
+  // runtime triggers in runtime order, then leaderboards, then (when a
+  // script is loaded) rich presence
+  prof_entry_t *entries;
+  uint32_t count;
+  uint32_t trigger_count;
+  uint32_t lboard_count;
+
+  uint32_t countdown;       // evaluated frames until the next sample
+  uint32_t rng;
+
+  uint64_t frames;          // evaluated frames seen while enabled
+  uint64_t samples;
+  uint64_t memrefs_ns;      // shared memref pass, summed over samples
+} prof_state_t;
+
+// conditions tested so far, by anyone (see the wrap above)
+extern uint64_t prof_cond_tests;
+
+struct rc_runtime_t;
+struct rc_richpresence_t;
+
+// (Re)build the entry list for what is loaded; counters start over. false
+// on OOM, leaving profiling off.
+bool prof_index(prof_state_t *p, const struct rc_runtime_t *rt, const struct rc_richpresence_t *rp);
+void prof_free(prof_state_t *p);
+
+// Once per evaluated frame, before the memref pass: decides p->sampling.
+void prof_begin_frame(prof_state_t *p);
+
+// Around rc_runtime_do_frame: on a sample, times each trigger and
+// leaderboard the runtime evaluates into its entry. Does nothing when the
+// runtime no longer matches the index.
+void prof_runtime_begin(prof_state_t *p, const struct rc_runtime_t *rt);
+void prof_runtime_end(void);
+
+typedef struct {
+  uint64_t ns;
+  uint64_t conds;
+} prof_mark_t;
+
+static inline void prof_mark(prof_mark_t *m) {
+  m->conds = prof_cond_tests;
+  m->ns = now_ns();
+}
+
+static inline void prof_account(prof_entry_t *e, const prof_mark_t *m) {
+  uint64_t ns = now_ns() - m->ns;
+  e->samples++;
+  e->ns += ns;
+  if (ns > e->max_ns) e->max_ns = ns;
+  e->conds += prof_cond_tests - m->conds;
+}
+
+// Indices of the (up to) n entries with the most sampled time, costliest
+// first; returns how many were written. Allocation-free (a selection pass
+// per row), so it can run from the frame loop.
+uint32_t prof_top(const prof_state_t *p, uint32_t *out, uint32_t n);
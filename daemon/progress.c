@@ -0,0 +1,148 @@
+#include "progress.h"
+#include "notify.h"
+#include "util.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PROGRESS_SHM_DIR "/dev/shm"
+
+_Static_assert(sizeof(mmr_progress_header_t) == 64, "progress header layout is ABI");
+_Static_assert(sizeof(mmr_progress_buffer_t) == 64, "progress buffer layout is ABI");
+_Static_assert(sizeof(mmr_progress_entry_t) == 24, "progress entry layout is ABI");
+
+static mmr_progress_buffer_t *buffer_at(progress_t *pg, uint32_t b) {
+  return (mmr_progress_buffer_t*)(pg->base + pg->hdr->header_size + (size_t)b * pg->hdr->buffer_stride);
+}
+
+static uint32_t *index_of(mmr_progress_buffer_t *buf) {
+  return (uint32_t*)(buf + 1);
+}
+
+static mmr_progress_entry_t *entries_of(progress_t *pg, mmr_progress_buffer_t *buf) {
+  return (mmr_progress_entry_t*)(index_of(buf) + pg->hdr->index_size);
+}
+
+bool progress_open(progress_t *pg, const char *name) {
+  memset(pg, 0, sizeof(*pg));
+  pg->fd = -1;
+
+  if (!name || !*name || strchr(name, '/')) {
+    notify(NOTIFY_ERR, "progress: invalid segment name '%s'", name ? name : "");
+    return false;
+  }
+  snprintf(pg->path, sizeof(pg->path), "%s/%s", PROGRESS_SHM_DIR, name);
+
+  // at most half full, so a miss ends after a short probe
+  uint32_t index_size = 1;
+  while (index_size < MMR_PROGRESS_CAPACITY * 2u) index_size <<= 1;
+  size_t body = sizeof(mmr_progress_buffer_t) + (size_t)index_size * sizeof(uint32_t) +
+                (size_t)MMR_PROGRESS_CAPACITY * sizeof(mmr_progress_entry_t);
+  uint32_t stride = (uint32_t)((body + 63u) & ~(size_t)63u);
+  size_t map_size = sizeof(mmr_progress_header_t) + (size_t)stride * MMR_PROGRESS_BUFFERS;
+
+  unlink(pg->path);
+  pg->fd = open(pg->path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (pg->fd < 0) {
+    notify(NOTIFY_ERR, "progress: open(%s) failed: %s", pg->path, strerror(errno));
+    return false;
+  }
+  if (ftruncate(pg->fd, (off_t)map_size) != 0) {
+    notify(NOTIFY_ERR, "progress: ftruncate(%s, %zu) failed: %s", pg->path, map_size, strerror(errno));
+    progress_close(pg);
+    return false;
+  }
+
+  void *p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, pg->fd, 0);
+  if (p == MAP_FAILED) {
+    notify(NOTIFY_ERR, "progress: mmap(%s) failed: %s", pg->path, strerror(errno));
+    progress_close(pg);
+    return false;
+  }
+  pg->base = (uint8_t*)p;
+  pg->map_size = map_size;
+  pg->hdr = (mmr_progress_header_t*)p;
+
+  // zero-filled: both buffers are empty (count 0, even seq)
+  pg->hdr->version = MMR_PROGRESS_VERSION;
+  pg->hdr->header_size = (uint32_t)sizeof(mmr_progress_header_t);
+  pg->hdr->buffer_count = MMR_PROGRESS_BUFFERS;
+  pg->hdr->buffer_stride = stride;
+  pg->hdr->capacity = MMR_PROGRESS_CAPACITY;
+  pg->hdr->index_size = index_size;
+  pg->hdr->latest_buffer = 0;
+  pg->hdr->writer_pid = (uint32_t)getpid();
+  __atomic_store_n(&pg->hdr->magic, MMR_PROGRESS_MAGIC, __ATOMIC_RELEASE);
+  return true;
+}
+
+void progress_close(progress_t *pg) {
+  if (!pg) return;
+  if (pg->base) munmap(pg->base, pg->map_size);
+  if (pg->fd >= 0) {
+    close(pg->fd);
+    unlink(pg->path);
+  }
+  pg->base = NULL;
+  pg->hdr = NULL;
+  pg->writing = NULL;
+  pg->fd = -1;
+}
+
+mmr_progress_entry_t *progress_begin(progress_t *pg, uint32_t *capacity) {
+  if (!pg || !pg->hdr) return NULL;
+
+  mmr_progress_buffer_t *buf = buffer_at(pg, (pg->hdr->latest_buffer + 1u) % pg->hdr->buffer_count);
+  __atomic_store_n(&buf->seq, buf->seq + 1u, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  pg->writing = buf;
+  if (capacity) *capacity = pg->hdr->capacity;
+  return entries_of(pg, buf);
+}
+
+static void build_index(progress_t *pg, mmr_progress_buffer_t *buf, uint32_t count) {
+  uint32_t *index = index_of(buf);
+  const mmr_progress_entry_t *entries = entries_of(pg, buf);
+  uint32_t mask = pg->hdr->index_size - 1u;
+
+  memset(index, 0, (size_t)pg->hdr->index_size * sizeof(*index));
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t slot = mmr_progress_hash(entries[i].id, pg->hdr->index_size);
+    while (index[slot]) slot = (slot + 1u) & mask;
+    index[slot] = i + 1u;
+  }
+}
+
+void progress_commit(progress_t *pg, uint32_t count, uint64_t frame, uint32_t core_id, uint32_t set_id) {
+  if (!pg || !pg->writing) return;
+  mmr_progress_buffer_t *buf = pg->writing;
+  pg->writing = NULL;
+
+  if (count > pg->hdr->capacity) {
+    if (!pg->warned_overflow) {
+      notify(NOTIFY_WARN, "progress: set has %u achievements, table holds %u; the rest are not published",
+             count, pg->hdr->capacity);
+      pg->warned_overflow = true;
+    }
+    count = pg->hdr->capacity;
+  }
+
+  // same set as this buffer last held: same ids in the same order
+  if (buf->set_id != set_id || buf->core_id != core_id || buf->count != count) build_index(pg, buf, count);
+
+  buf->count = count;
+  buf->frame = frame;
+  buf->mono_ns = now_ns();
+  buf->core_id = core_id;
+  buf->set_id = set_id;
+
+  uint32_t b = (uint32_t)(((uint8_t*)buf - pg->base - pg->hdr->header_size) / pg->hdr->buffer_stride);
+  __atomic_store_n(&buf->seq, buf->seq + 1u, __ATOMIC_RELEASE);
+  __atomic_store_n(&pg->hdr->latest_buffer, b, __ATOMIC_RELEASE);
+  __atomic_store_n(&pg->hdr->published, pg->hdr->published + 1u, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Achievement progress table: after every evaluated frame the daemon
+// publishes each active achievement's state, measured progress and hit
+// count into a shared-memory segment (/dev/shm/<name>), so overlays can ask
+// "how far along is achievement N" without calling into the runtime (which
+// only the frame thread may touch) and without a linear search for the id.
+//
+// Layout (little-endian, fixed offsets; tools/progress_read.py mirrors it):
+//   mmr_progress_header_t             at offset 0
+//   buffer b (0 or 1)                 at header_size + b * buffer_stride:
+//     mmr_progress_buffer_t
+//     uint32_t index[index_size]      open addressing on the id, linear
+//                                     probing; entry position + 1, 0 = empty
+//     mmr_progress_entry_t[capacity]
+//
+// The two buffers are double-buffered seqlocks: the daemon writes the one
+// latest_buffer does not name (seq odd meanwhile), then flips latest_buffer.
+// A reader takes latest_buffer, checks seq is even, looks the id up
+// (mmr_progress_lookup below), then re-checks seq and retries on a change.
+// The index is only rebuilt when the loaded set changes (set_id).
+
+#define MMR_PROGRESS_MAGIC        0x4752504Du  // 'MPRG'
+#define MMR_PROGRESS_VERSION      1u
+#define MMR_PROGRESS_BUFFERS      2u
+#define MMR_PROGRESS_CAPACITY     4096u        // achievements per set
+#define MMR_PROGRESS_DEFAULT_NAME "mmr-progress"
+
+#define MMR_PROGRESS_F_PERCENT    0x01u        // measured is shown as a percentage
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t header_size;     // offset of buffer 0
+  uint32_t buffer_count;
+  uint32_t buffer_stride;
+  uint32_t capacity;        // entries per buffer
+  uint32_t index_size;      // index slots per buffer (a power of two)
+  uint32_t latest_buffer;   // index of the newest complete buffer
+  uint32_t writer_pid;
+  uint32_t reserved0;
+  uint64_t published;       // tables published since the segment was created
+  uint8_t reserved[16];
+} mmr_progress_header_t;    // 64 bytes
+
+typedef struct {
+  uint32_t seq;             // odd = being written
+  uint32_t count;           // valid entries
+  uint64_t frame;           // daemon frame number the states are from
+  uint64_t mono_ns;         // CLOCK_MONOTONIC when published
+  uint32_t core_id;
+  uint32_t set_id;          // changes whenever a different set is loaded
+  uint8_t reserved[32];
+} mmr_progress_buffer_t;    // 64 bytes
+
+typedef struct {
+  uint32_t id;
+  uint8_t state;            // RC_TRIGGER_STATE_* (waiting, active, primed, triggered, ...)
+  uint8_t flags;            // MMR_PROGRESS_F_*
+  uint16_t reserved;
+  uint32_t measured_value;  // 0 / 0 unless active (as rc_runtime_get_achievement_measured)
+  uint32_t measured_target; // 0 = not measured
+  uint32_t hits;            // hit counts of conditions with a hit target, summed
+  uint32_t reserved2;
+} mmr_progress_entry_t;     // 24 bytes
+
+static inline uint32_t mmr_progress_hash(uint32_t id, uint32_t index_size) {
+  return (id * 0x9E3779B1u) & (index_size - 1u);
+}
+
+// Reader side, on a mapping of the whole segment: copies achievement id's
+// entry into *out (and the frame it is from into *frame, if not NULL).
+// false when the id is not in the published set.
+static inline bool mmr_progress_lookup(const void *base, uint32_t id, mmr_progress_entry_t *out, uint64_t *frame) {
+  const mmr_progress_header_t *h = (const mmr_progress_header_t*)base;
+  if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != MMR_PROGRESS_MAGIC) return false;
+
+  for (int attempt = 0; attempt < 1000; attempt++) {
+    uint32_t b = __atomic_load_n(&h->latest_buffer, __ATOMIC_ACQUIRE);
+    const uint8_t *p = (const uint8_t*)base + h->header_size + (size_t)b * h->buffer_stride;
+    const mmr_progress_buffer_t *buf = (const mmr_progress_buffer_t*)p;
+    const uint32_t *index = (const uint32_t*)(buf + 1);
+    const mmr_progress_entry_t *entries = (const mmr_progress_entry_t*)(index + h->index_size);
+
+    uint32_t s1 = __atomic_load_n(&buf->seq, __ATOMIC_ACQUIRE);
+    if (s1 & 1u) continue;
+
+    bool found = false;
+    uint32_t count = buf->count;
+    uint32_t slot = mmr_progress_hash(id, h->index_size);
+    for (uint32_t n = 0; n < h->index_size; n++) {
+      uint32_t e = index[slot];
+      if (e == 0 || e > count) break;
+      if (entries[e - 1u].id == id) {
+        *out = entries[e - 1u];
+        found = true;
+        break;
+      }
+      slot = (slot + 1u) & (h->index_size - 1u);
+    }
+    uint64_t f = buf->frame;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&buf->seq, __ATOMIC_RELAXED) != s1) continue;
+    if (frame) *frame = f;
+    return found;
+  }
+  return false;
+}
+
+// ---- daemon side ----
+
+typedef struct {
+  int fd;
+  uint8_t *base;
+  size_t map_size;
+  mmr_progress_header_t *hdr;
+  char path[256];
+  mmr_progress_buffer_t *writing;   // between progress_begin and progress_commit
+  bool warned_overflow;
+} progress_t;
+
+// Creates (or recreates) /dev/shm/<name>.
+bool progress_open(progress_t *pg, const char *name);
+
+// Unmaps and unlinks the segment; readers keep their mapping until they close it.
+void progress_close(progress_t *pg);
+
+// Entries of the buffer readers are not using, for the caller to fill with
+// up to capacity entries (*capacity); the buffer reads as torn until
+// progress_commit.
+mmr_progress_entry_t *progress_begin(progress_t *pg, uint32_t *capacity);
+
+// Publishes count entries filled since progress_begin. Entries past capacity
+// are dropped (warned once).
+void progress_commit(progress_t *pg, uint32_t count, uint64_t frame, uint32_t core_id, uint32_t set_id);
@@ -0,0 +1,363 @@
+#define _GNU_SOURCE
+#include "romhash.h"
+#include "adapters.h"
+#include "notify.h"
+#include "rt.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../third_party/rcheevos/include/rc_hash.h"
+
+#define SCAN_MAX_DEPTH 16
+
+/* linux/ioprio.h, which not every libc ships */
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_IDLE  3
+#define IOPRIO_CLASS_SHIFT 13
+
+/* ---- table (callers hold rh->lock) ---- */
+
+static uint32_t path_hash(const char *s) {
+  uint32_t h = 2166136261u;
+  for (; *s; s++) h = (h ^ (uint8_t)*s) * 16777619u;
+  return h;
+}
+
+static void index_insert(romhash_t *rh, size_t i) {
+  size_t mask = rh->slot_count - 1u;
+  size_t slot = path_hash(rh->entries[i].path) & mask;
+  while (rh->slots[slot]) slot = (slot + 1u) & mask;
+  rh->slots[slot] = (uint32_t)(i + 1u);
+}
+
+static romhash_entry_t *find(romhash_t *rh, const char *path) {
+  if (!rh->slots) return NULL;
+  size_t mask = rh->slot_count - 1u;
+  for (size_t slot = path_hash(path) & mask; rh->slots[slot]; slot = (slot + 1u) & mask) {
+    romhash_entry_t *e = &rh->entries[rh->slots[slot] - 1u];
+    if (strcmp(e->path, path) == 0) return e;
+  }
+  return NULL;
+}
+
+static bool fresh(const romhash_entry_t *e, const struct stat *st, uint32_t console) {
+  return e && e->console == console && e->size == (uint64_t)st->st_size &&
+         e->mtime_ns == (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+static bool put(romhash_t *rh, const char *path, uint64_t size, int64_t mtime_ns, uint32_t console, const char *hash) {
+  romhash_entry_t *e = find(rh, path);
+  if (!e) {
+    if (rh->count == rh->cap) {
+      /* open addressing at most half full; rehash into twice the capacity */
+      size_t ncap = rh->cap ? rh->cap * 2u : 64u;
+      uint32_t *slots = (uint32_t*)calloc(ncap * 2u, sizeof(*slots));
+      romhash_entry_t *n = slots ? (romhash_entry_t*)realloc(rh->entries, ncap * sizeof(*n)) : NULL;
+      if (!n) {
+        free(slots);
+        return false;
+      }
+      rh->entries = n;
+      rh->cap = ncap;
+      free(rh->slots);
+      rh->slots = slots;
+      rh->slot_count = ncap * 2u;
+      for (size_t i = 0; i < rh->count; i++) index_insert(rh, i);
+    }
+    char *p = strdup(path);
+    if (!p) return false;
+    e = &rh->entries[rh->count];
+    e->path = p;
+    index_insert(rh, rh->count++);
+  }
+  e->size = size;
+  e->mtime_ns = mtime_ns;
+  e->console = console;
+  memcpy(e->hash, hash, 33);
+  rh->dirty = true;
+  return true;
+}
+
+/* a file rc_hash rejected is kept with an empty hash, "-" on disk, so it is
+ * not read again until its size or mtime change */
+#define FAILED_HASH "-"
+
+static bool valid_hash(const char *h) {
+  if (strcmp(h, FAILED_HASH) == 0) return true;
+  if (strlen(h) != 32) return false;
+  for (; *h; h++) {
+    if (!((*h >= '0' && *h <= '9') || (*h >= 'a' && *h <= 'f'))) return false;
+  }
+  return true;
+}
+
+static void load(romhash_t *rh) {
+  FILE *f = fopen(rh->cache_path, "r");
+  if (!f) {
+    if (errno != ENOENT) notify(NOTIFY_WARN, "romhash: %s: %s", rh->cache_path, strerror(errno));
+    return;
+  }
+
+  char *line = NULL;
+  size_t line_cap = 0;
+  ssize_t len;
+  size_t dropped = 0;
+  while ((len = getline(&line, &line_cap, f)) > 0) {
+    if (line[len - 1] == '\n') line[--len] = 0;
+    char hash[33];
+    unsigned console;
+    unsigned long long size;
+    long long mtime_ns;
+    int path_at = 0;
+    if (sscanf(line, "%32s %u %llu %lld %n", hash, &console, &size, &mtime_ns, &path_at) != 4 ||
+        !path_at || !line[path_at] || !valid_hash(hash) ||
+        !put(rh, line + path_at, size, mtime_ns, console, strcmp(hash, FAILED_HASH) ? hash : "")) {
+      dropped++;
+    }
+  }
+  free(line);
+  fclose(f);
+
+  if (dropped) notify(NOTIFY_WARN, "romhash: %s: dropped %zu unreadable entries", rh->cache_path, dropped);
+  rh->dirty = dropped != 0;
+}
+
+bool romhash_open(romhash_t *rh, const char *cache_path) {
+  memset(rh, 0, sizeof(*rh));
+  if (cache_path && *cache_path) {
+    if (strlen(cache_path) + 5u > sizeof(rh->cache_path)) {
+      notify(NOTIFY_ERR, "romhash: cache path too long: %s", cache_path);
+      return false;
+    }
+    snprintf(rh->cache_path, sizeof(rh->cache_path), "%s", cache_path);
+  }
+  pthread_mutex_init(&rh->lock, NULL);
+  pthread_cond_init(&rh->work, NULL);
+  if (rh->cache_path[0]) load(rh);
+  return true;
+}
+
+bool romhash_save(romhash_t *rh) {
+  pthread_mutex_lock(&rh->lock);
+  if (!rh->cache_path[0] || !rh->dirty) {
+    pthread_mutex_unlock(&rh->lock);
+    return true;
+  }
+
+  char tmp[sizeof(rh->cache_path) + 4];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", rh->cache_path);
+  bool ok = false;
+  FILE *f = fopen(tmp, "w");
+  if (f) {
+    for (size_t i = 0; i < rh->count; i++) {
+      const romhash_entry_t *e = &rh->entries[i];
+      if (strchr(e->path, '\n')) continue;   /* cannot be stored */
+      fprintf(f, "%s %u %" PRIu64 " %" PRId64 " %s\n", e->hash[0] ? e->hash : FAILED_HASH, e->console,
+              e->size, e->mtime_ns, e->path);
+    }
+    ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = (fclose(f) == 0) && ok;
+    ok = ok && rename(tmp, rh->cache_path) == 0;
+  }
+  if (ok) {
+    rh->dirty = false;
+  } else {
+    notify(NOTIFY_WARN, "romhash: could not write %s: %s", rh->cache_path, strerror(errno));
+    unlink(tmp);
+  }
+  pthread_mutex_unlock(&rh->lock);
+  return ok;
+}
+
+bool romhash_identify(romhash_t *rh, const char *path, uint32_t console, char hash[33], bool *cached) {
+  struct stat st;
+  if (!path || stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return false;
+
+  pthread_mutex_lock(&rh->lock);
+  const romhash_entry_t *e = find(rh, path);
+  bool hit = fresh(e, &st, console);
+  if (hit) memcpy(hash, e->hash, 33);
+  pthread_mutex_unlock(&rh->lock);
+  if (cached) *cached = hit;
+  if (hit) return hash[0] != 0;
+
+  /* a failure is cached too: unhashable files are the costliest to retry */
+  bool ok = rc_hash_generate_from_file(hash, console, path) != 0;
+  if (!ok) hash[0] = 0;
+
+  pthread_mutex_lock(&rh->lock);
+  (void)put(rh, path, (uint64_t)st.st_size, (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec,
+            console, ok ? hash : "");
+  pthread_mutex_unlock(&rh->lock);
+  return ok;
+}
+
+/* ---- background pool ---- */
+
+/* Best effort: idle CPU class and nice 19 (the frame thread and anything
+ * interactive always win), idle I/O class (the SD card serves us last). */
+static void lower_priority(void) {
+  struct sched_param sp;
+  memset(&sp, 0, sizeof(sp));
+  (void)pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+  (void)setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+  (void)syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+}
+
+static void enqueue(romhash_t *rh, const char *path) {
+  adapter_desc_t ad;
+  struct stat st;
+  if (!adapter_for_rom(path, &ad) || stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return;
+
+  pthread_mutex_lock(&rh->lock);
+  if (!fresh(find(rh, path), &st, ad.rc_console)) {
+    if (rh->queue_count == rh->queue_cap) {
+      size_t ncap = rh->queue_cap ? rh->queue_cap * 2u : 256u;
+      char **q = (char**)realloc(rh->queue, ncap * sizeof(*q));
+      if (q) {
+        rh->queue = q;
+        rh->queue_cap = ncap;
+      }
+    }
+    char *p = rh->queue_count < rh->queue_cap ? strdup(path) : NULL;
+    if (p) {
+      rh->queue[rh->queue_count++] = p;
+      pthread_cond_signal(&rh->work);
+    }
+  }
+  pthread_mutex_unlock(&rh->lock);
+}
+
+static void scan(romhash_t *rh, const char *dir, int depth) {
+  DIR *d = opendir(dir);
+  if (!d) return;
+
+  char path[4096];
+  struct dirent *de;
+  while ((de = readdir(d)) != NULL && !__atomic_load_n(&rh->stop, __ATOMIC_RELAXED)) {
+    if (de->d_name[0] == '.') continue;   /* ., .., hidden files */
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", dir, de->d_name) >= sizeof(path)) continue;
+
+    unsigned char type = de->d_type;
+    if (type == DT_UNKNOWN) {
+      struct stat st;
+      if (lstat(path, &st) != 0) continue;
+      type = S_ISDIR(st.st_mode) ? DT_DIR : (S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN);
+    }
+    /* symlinked directories are not followed (no loops) */
+    if (type == DT_DIR) {
+      if (depth < SCAN_MAX_DEPTH) scan(rh, path, depth + 1);
+    } else if (type == DT_REG || type == DT_LNK) {
+      enqueue(rh, path);
+    }
+  }
+  closedir(d);
+}
+
+static void *worker(void *arg) {
+  romhash_t *rh = (romhash_t*)arg;
+  rt_alloc_exempt_thread();
+  lower_priority();
+
+  /* the first worker to start walks the library; the rest start hashing as
+   * soon as it finds something */
+  pthread_mutex_lock(&rh->lock);
+  bool scanner = rh->root != NULL;
+  char *root = rh->root;
+  rh->root = NULL;
+  pthread_mutex_unlock(&rh->lock);
+  if (scanner) {
+    scan(rh, root, 0);
+    free(root);
+    pthread_mutex_lock(&rh->lock);
+    rh->scan_done = true;
+    pthread_cond_broadcast(&rh->work);
+    pthread_mutex_unlock(&rh->lock);
+  }
+
+  pthread_mutex_lock(&rh->lock);
+  for (;;) {
+    while (!rh->stop && rh->queue_next == rh->queue_count && !rh->scan_done) pthread_cond_wait(&rh->work, &rh->lock);
+    if (rh->stop || rh->queue_next == rh->queue_count) break;
+
+    char *path = rh->queue[rh->queue_next];
+    rh->queue[rh->queue_next++] = NULL;
+    pthread_mutex_unlock(&rh->lock);
+
+    adapter_desc_t ad;
+    char hash[33];
+    bool ok = adapter_for_rom(path, &ad) && romhash_identify(rh, path, ad.rc_console, hash, NULL);
+    free(path);
+
+    pthread_mutex_lock(&rh->lock);
+    if (ok) rh->hashed++;
+    else rh->failed++;
+  }
+  bool last = --rh->busy == 0 && !rh->stop;
+  uint64_t hashed = rh->hashed, failed = rh->failed;
+  pthread_mutex_unlock(&rh->lock);
+
+  if (last) {
+    notify(NOTIFY_INFO, "romhash: library pre-hash done: %" PRIu64 " hashed, %" PRIu64 " unreadable", hashed, failed);
+    (void)romhash_save(rh);
+  }
+  return NULL;
+}
+
+bool romhash_prefetch(romhash_t *rh, const char *dir, uint32_t threads) {
+  if (!dir || !*dir || rh->thread_count) return false;
+  if (threads < 1u) threads = 1u;
+  if (threads > ROMHASH_THREADS_MAX) threads = ROMHASH_THREADS_MAX;
+
+  rh->root = strdup(dir);
+  if (!rh->root) return false;
+
+  pthread_mutex_lock(&rh->lock);
+  for (uint32_t i = 0; i < threads; i++) {
+    int rc = pthread_create(&rh->threads[i], NULL, worker, rh);
+    if (rc != 0) {
+      notify(NOTIFY_WARN, "romhash: could not start hashing thread %u: %s", i, strerror(rc));
+      break;
+    }
+    rh->thread_count++;
+    rh->busy++;
+  }
+  pthread_mutex_unlock(&rh->lock);
+
+  if (!rh->thread_count) {
+    free(rh->root);
+    rh->root = NULL;
+    return false;
+  }
+  return true;
+}
+
+void romhash_close(romhash_t *rh) {
+  pthread_mutex_lock(&rh->lock);
+  __atomic_store_n(&rh->stop, true, __ATOMIC_RELAXED);
+  pthread_cond_broadcast(&rh->work);
+  pthread_mutex_unlock(&rh->lock);
+  for (uint32_t i = 0; i < rh->thread_count; i++) pthread_join(rh->threads[i], NULL);
+
+  (void)romhash_save(rh);
+
+  for (size_t i = 0; i < rh->count; i++) free(rh->entries[i].path);
+  for (size_t i = rh->queue_next; i < rh->queue_count; i++) free(rh->queue[i]);
+  free(rh->entries);
+  free(rh->slots);
+  free(rh->queue);
+  free(rh->root);
+  pthread_cond_destroy(&rh->work);
+  pthread_mutex_destroy(&rh->lock);
+  memset(rh, 0, sizeof(*rh));
+}
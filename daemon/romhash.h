@@ -0,0 +1,81 @@
+#pragma once
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ROM identification (--rom): the running game's rc_hash, the id
+// RetroAchievements sets are published under, through a persistent cache.
+//
+// Hashing reads and digests the whole ROM (and for some consoles parses
+// it), which for large images on the SD card takes long enough to hold up
+// a launch. The cache maps a path to its hash while the file's size and
+// mtime are unchanged, so identifying a known game is a table lookup and
+// only new or modified files are hashed. With --rom-dir, a small pool of
+// threads at idle CPU and I/O priority walks the library and hashes every
+// ROM the cache does not have yet, so the next launch of any of them is a
+// hit as well.
+//
+// Cache file (--hash-cache), one entry per line, rewritten whole through a
+// temporary file and rename; lines that do not parse are dropped:
+//   <hash> <console> <size> <mtime_ns> <path to end of line>
+// A file rc_hash rejected is stored with "-" for its hash and not hashed
+// again until its size or mtime change.
+
+#define ROMHASH_THREADS_DEFAULT 2u
+#define ROMHASH_THREADS_MAX     8u
+
+typedef struct {
+  char *path;
+  uint64_t size;
+  int64_t mtime_ns;
+  uint32_t console;         // RC_CONSOLE_*
+  char hash[33];            // "" = rc_hash rejected the file
+} romhash_entry_t;
+
+typedef struct {
+  pthread_mutex_t lock;     // everything below
+  romhash_entry_t *entries;
+  size_t count;
+  size_t cap;
+  uint32_t *slots;          // entry index + 1 by path hash; 0 = empty
+  size_t slot_count;        // 2 * cap
+  char cache_path[512];     // "" = in memory only
+  bool dirty;               // entries changed since the file was written
+
+  // --rom-dir pool
+  pthread_cond_t work;      // queue grew, or the scan finished
+  pthread_t threads[ROMHASH_THREADS_MAX];
+  uint32_t thread_count;
+  char *root;
+  char **queue;             // paths found by the scan, not yet cached
+  size_t queue_count;
+  size_t queue_cap;
+  size_t queue_next;
+  bool scan_done;
+  bool stop;
+  uint32_t busy;            // workers not yet finished
+  uint64_t hashed;          // by the pool
+  uint64_t failed;
+} romhash_t;
+
+// Reads cache_path if it exists (NULL or "" keeps the cache in memory).
+// false on OOM or an unusable cache_path.
+bool romhash_open(romhash_t *rh, const char *cache_path);
+
+// rc_hash of the ROM at path for console: from the cache while the file's
+// size and mtime match, otherwise hashed in the calling thread and cached.
+// *cached (if not NULL) tells which. false if the file cannot be read or
+// rc_hash rejects it (a rejection is cached like a hash).
+bool romhash_identify(romhash_t *rh, const char *path, uint32_t console, char hash[33], bool *cached);
+
+// Starts threads (1..ROMHASH_THREADS_MAX) that hash every file under dir
+// whose extension a core claims (adapter_for_rom) and the cache lacks. The
+// cache is saved when they are done.
+bool romhash_prefetch(romhash_t *rh, const char *dir, uint32_t threads);
+
+// Writes the cache file if entries changed since it was read or last written.
+bool romhash_save(romhash_t *rh);
+
+// Stops the pool (a file being hashed is finished first), saves, frees.
+void romhash_close(romhash_t *rh);
@@ -0,0 +1,82 @@
+#define _GNU_SOURCE
+#include "rt.h"
+#include "notify.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// Stack the frame loop may touch (engine + rcheevos + stdio), faulted in
+// up front so the first deep call after warm-up does not page-fault.
+#define RT_STACK_PREFAULT (256u * 1024u)
+
+static uint64_t g_allocs = 0;
+static __thread bool t_exempt = false;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t nmemb, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  if (!t_exempt) __atomic_add_fetch(&g_allocs, 1, __ATOMIC_RELAXED);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+  if (!t_exempt) __atomic_add_fetch(&g_allocs, 1, __ATOMIC_RELAXED);
+  return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  if (!t_exempt) __atomic_add_fetch(&g_allocs, 1, __ATOMIC_RELAXED);
+  return __real_realloc(ptr, size);
+}
+
+uint64_t rt_alloc_count(void) {
+  return __atomic_load_n(&g_allocs, __ATOMIC_RELAXED);
+}
+
+void rt_alloc_exempt_thread(void) {
+  t_exempt = true;
+}
+
+static void prefault_stack(void) {
+  volatile uint8_t buf[RT_STACK_PREFAULT];
+  for (size_t i = 0; i < sizeof(buf); i += 4096) buf[i] = 0;
+}
+
+bool rt_enter(const rt_config_t *cfg) {
+  bool ok = true;
+
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    notify(NOTIFY_WARN, "realtime: mlockall failed: %s", strerror(errno));
+    ok = false;
+  }
+
+  if (cfg->cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cfg->cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      notify(NOTIFY_WARN, "realtime: pin to CPU %d failed: %s", cfg->cpu, strerror(errno));
+      ok = false;
+    }
+  }
+
+  struct sched_param sp;
+  memset(&sp, 0, sizeof(sp));
+  sp.sched_priority = cfg->priority;
+  if (sched_setscheduler(0, SCHED_FIFO, &sp) != 0) {
+    notify(NOTIFY_WARN, "realtime: SCHED_FIFO priority %d failed: %s", cfg->priority, strerror(errno));
+    ok = false;
+  }
+
+  prefault_stack();
+  return ok;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Real-time support for --realtime: locked memory, a pinned SCHED_FIFO
+// frame thread, and an allocation counter.
+//
+// The counter comes from link-time wrapping (-Wl,--wrap=malloc,...; see the
+// Makefile), so it sees every heap allocation made by the daemon and the
+// vendored rcheevos sources. Allocations libc makes internally (stdio
+// buffers, getaddrinfo, ...) go through libc's own malloc and are not
+// counted; the frame loop avoids those calls instead.
+
+typedef struct {
+  int cpu;          // CPU to pin the frame thread to (-1 = leave affinity alone)
+  int priority;     // SCHED_FIFO priority (1..99)
+} rt_config_t;
+
+// mlockall + affinity + SCHED_FIFO + stack prefault. Each step that fails is
+// reported; returns false if any did (the daemon keeps running, just not
+// real-time).
+bool rt_enter(const rt_config_t *cfg);
+
+// Allocations (malloc/calloc/realloc) made through the wrapped entry points
+// since process start.
+uint64_t rt_alloc_count(void);
+
+// Leaves the calling thread's allocations out of that count from now on, for
+// background threads (--rom-dir hashing) whose heap use says nothing about
+// the frame loop.
+void rt_alloc_exempt_thread(void);
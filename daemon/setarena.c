@@ -0,0 +1,159 @@
+#include "setarena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../third_party/rcheevos/src/rcheevos/rc_internal.h"
+#include "../third_party/rcheevos/src/rhash/md5.h"
+
+#define OBJECTS_ALIGN 64u   /* the first trigger starts on a cache line */
+
+typedef struct {
+  rc_runtime_trigger_t *triggers;
+  rc_runtime_lboard_t *lboards;
+  rc_memrefs_t *memrefs;
+} arena_head_t;
+
+/* The runtime arrays and the memref pool. With no buffer (sizing) nothing is
+ * placed and the offset just advances past where they will go. */
+static void place_head(rc_preparse_state_t *pre, uint32_t ach_count, uint32_t lb_count, arena_head_t *h) {
+  rc_parse_state_t *parse = &pre->parse;
+
+  h->triggers = (rc_runtime_trigger_t*)rc_alloc(parse->buffer, &parse->offset,
+      ach_count * (uint32_t)sizeof(rc_runtime_trigger_t), _Alignof(rc_runtime_trigger_t), NULL, 0);
+  h->lboards = (rc_runtime_lboard_t*)rc_alloc(parse->buffer, &parse->offset,
+      lb_count * (uint32_t)sizeof(rc_runtime_lboard_t), _Alignof(rc_runtime_lboard_t), NULL, 0);
+  h->memrefs = (rc_memrefs_t*)rc_alloc(parse->buffer, &parse->offset,
+      (uint32_t)sizeof(rc_memrefs_t), _Alignof(rc_memrefs_t), NULL, 0);
+
+  /* sized from the memrefs the first pass collected; with a buffer this also
+   * points the parse at the pool */
+  rc_preparse_alloc_memrefs(h->memrefs, pre);
+  (void)rc_alloc(parse->buffer, &parse->offset, 0, OBJECTS_ALIGN, NULL, 0);
+}
+
+/* Each def starts from a fresh parse state, as under rc_runtime_activate_*,
+ * but keeps the running offset and the set's memref pool. */
+static void next_def(rc_parse_state_t *parse) {
+  int32_t offset = parse->offset;
+  rc_memrefs_t *memrefs = parse->memrefs;
+  rc_reset_parse_state(parse, parse->buffer);
+  parse->offset = offset;
+  parse->memrefs = memrefs;
+}
+
+/* h is NULL on the first pass, whose objects are throwaway scratch. Both
+ * lists are placed last to first: rc_runtime_do_frame evaluates them from
+ * the highest index down. */
+static void parse_defs(rc_parse_state_t *parse, const arena_head_t *h,
+                       const set_arena_def_t *ach, uint32_t ach_count,
+                       const set_arena_def_t *lb, uint32_t lb_count) {
+  for (uint32_t i = ach_count; i-- > 0 && parse->offset >= 0;) {
+    const char *memaddr = ach[i].memaddr;
+    next_def(parse);
+    rc_trigger_t *t = RC_ALLOC(rc_trigger_t, parse);
+    rc_parse_trigger_internal(t, &memaddr, parse);
+    if (h) h->triggers[i].trigger = t;
+  }
+  for (uint32_t i = lb_count; i-- > 0 && parse->offset >= 0;) {
+    next_def(parse);
+    rc_lboard_t *l = RC_ALLOC(rc_lboard_t, parse);
+    rc_parse_lboard_internal(l, lb[i].memaddr, parse);
+    if (h) h->lboards[i].lboard = l;
+  }
+}
+
+/* rc_runtime_activate_* keep this to recognise a re-activated definition */
+static void checksum(const char *memaddr, uint8_t md5[16]) {
+  md5_state_t state;
+  md5_init(&state);
+  md5_append(&state, (const md5_byte_t*)memaddr, (int)strlen(memaddr));
+  md5_finish(&state, md5);
+}
+
+bool set_arena_build(set_arena_t *a, rc_runtime_t *rt,
+                     const set_arena_def_t *achievements, uint32_t ach_count,
+                     const set_arena_def_t *lboards, uint32_t lboard_count,
+                     const char *rp_script, rc_richpresence_t **rp) {
+  memset(a, 0, sizeof(*a));
+  *rp = NULL;
+
+  rc_preparse_state_t pre;
+  rc_init_preparse_state(&pre);
+
+  /* pass 1: the set's distinct memrefs, and the size of its objects */
+  parse_defs(&pre.parse, NULL, achievements, ach_count, lboards, lboard_count);
+  int32_t objects = pre.parse.offset;
+  if (objects < 0) {
+    rc_destroy_preparse_state(&pre);
+    return false;
+  }
+
+  arena_head_t head;
+  rc_reset_parse_state(&pre.parse, NULL);
+  place_head(&pre, ach_count, lboard_count, &head);
+  int32_t head_size = pre.parse.offset;
+
+  /* objects start aligned in both passes, so the first pass's total holds */
+  int32_t rp_size = rp_script ? rc_richpresence_size(rp_script) : 0;
+  size_t rp_at = ((size_t)head_size + (size_t)objects + (OBJECTS_ALIGN - 1u)) & ~(size_t)(OBJECTS_ALIGN - 1u);
+  size_t size = rp_at + (rp_size > 0 ? (size_t)rp_size : 0u);
+
+  uint8_t *base = (uint8_t*)malloc(size);
+  if (!base) {
+    rc_destroy_preparse_state(&pre);
+    return false;
+  }
+
+  /* pass 2: the same parse into the arena */
+  rc_reset_parse_state(&pre.parse, base);
+  place_head(&pre, ach_count, lboard_count, &head);
+  parse_defs(&pre.parse, &head, achievements, ach_count, lboards, lboard_count);
+  int32_t end = pre.parse.offset;
+  rc_destroy_preparse_state(&pre);
+
+  if (end < 0 || (size_t)end > rp_at ||
+      head.memrefs->memrefs.count != head.memrefs->memrefs.capacity) {
+    free(base);
+    return false;
+  }
+
+  memset(rt, 0, sizeof(*rt));
+  rt->triggers = head.triggers;
+  rt->trigger_count = rt->trigger_capacity = ach_count;
+  for (uint32_t i = 0; i < ach_count; i++) {
+    rc_runtime_trigger_t *t = &rt->triggers[i];
+    t->id = achievements[i].id;
+    t->buffer = NULL;
+    t->invalid_memref = NULL;
+    t->serialized_size = 0;
+    checksum(achievements[i].memaddr, t->md5);
+    rc_reset_trigger(t->trigger);
+  }
+  rt->lboards = head.lboards;
+  rt->lboard_count = rt->lboard_capacity = lboard_count;
+  for (uint32_t i = 0; i < lboard_count; i++) {
+    rc_runtime_lboard_t *l = &rt->lboards[i];
+    l->id = lboards[i].id;
+    l->value = 0;
+    l->buffer = NULL;
+    l->invalid_memref = NULL;
+    l->serialized_size = 0;
+    checksum(lboards[i].memaddr, l->md5);
+    rc_reset_lboard(l->lboard);
+  }
+  rt->memrefs = head.memrefs;
+
+  if (rp_size > 0) *rp = rc_parse_richpresence(base + rp_at, rp_script, NULL, 0);
+
+  a->base = base;
+  a->size = size;
+  a->memrefs = rc_memrefs_count_memrefs(head.memrefs) + rc_memrefs_count_modified_memrefs(head.memrefs);
+  return true;
+}
+
+void set_arena_free(set_arena_t *a, rc_runtime_t *rt) {
+  free(a->base);
+  memset(a, 0, sizeof(*a));
+  memset(rt, 0, sizeof(*rt));
+}
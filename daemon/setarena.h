@@ -0,0 +1,56 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../third_party/rcheevos/include/rc_runtime.h"
+
+// Per-set arena (--set-arena): a loaded set's runtime storage in one
+// allocation.
+//
+// rc_runtime_activate_achievement/_lboard allocate every trigger and
+// leaderboard separately and grow the shared memref pool in chained blocks,
+// so a big set ends up scattered over the heap: the frame walk takes a cache
+// (and often TLB) miss per object, and a reload frees thousands of blocks.
+// set_arena_build parses the whole set twice instead, the way
+// rc_parse_trigger does for one trigger: first to find the distinct memrefs
+// and the size of every object, then into a single buffer:
+//
+//   rc_runtime_trigger_t[ach_count], rc_runtime_lboard_t[lboard_count]
+//   rc_memrefs_t and its memref / modified memref arrays (the shared pool)
+//   the triggers, then the leaderboards, each list from its last runtime
+//     index to its first (cache-line aligned)
+//   the rich presence script, with its own memrefs
+//
+// rc_runtime_do_frame evaluates triggers and then leaderboards from the
+// highest index down, so that pass reads the objects at rising addresses.
+// The runtime arrays themselves are still indexed in runtime order.
+//
+// The runtime built here is evaluated, reset and queried like any other,
+// but it must never reach rc_runtime_destroy or rc_runtime_activate_* (they
+// would free or realloc arena memory): set_arena_free is its teardown.
+
+typedef struct {
+  uint32_t id;
+  const char *memaddr;
+} set_arena_def_t;
+
+typedef struct {
+  void *base;
+  size_t size;
+  uint32_t memrefs;           // shared pool entries, plain + modified
+} set_arena_t;
+
+// Every def must parse on its own (rc_trigger_size / rc_lboard_size >= 0)
+// and ids must be unique per kind; rp_script may be NULL. On success *rt
+// (overwritten, not destroyed) holds the set and *rp the rich presence, or
+// NULL if the script did not parse. false on OOM or a parse failure, with
+// nothing allocated.
+bool set_arena_build(set_arena_t *a, rc_runtime_t *rt,
+                     const set_arena_def_t *achievements, uint32_t ach_count,
+                     const set_arena_def_t *lboards, uint32_t lboard_count,
+                     const char *rp_script, rc_richpresence_t **rp);
+
+// One free for the whole set; *rt is left zeroed (rc_runtime_init it again
+// before activating anything into it).
+void set_arena_free(set_arena_t *a, rc_runtime_t *rt);
@@ -0,0 +1,156 @@
+#include "snapshot.h"
+#include "notify.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t page_fnv1a32(const uint8_t *p, size_t n) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++) {
+    h ^= (uint32_t)p[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static void *grow(void *p, size_t bytes) {
+  void *n = realloc(p, bytes);
+  if (!n) free(p);
+  return n;
+}
+
+bool snapshot_attach(snapshot_t *s, memtap_t *mt, uint32_t size) {
+  uint32_t pages = (size + SNAPSHOT_PAGE_SIZE - 1u) >> SNAPSHOT_PAGE_SHIFT;
+
+  if (pages > s->page_cap) {
+    s->data = (uint8_t*)grow(s->data, (size_t)pages << SNAPSHOT_PAGE_SHIFT);
+    s->fetched_gen = (uint32_t*)grow(s->fetched_gen, pages * sizeof(uint32_t));
+    s->used_gen = (uint32_t*)grow(s->used_gen, pages * sizeof(uint32_t));
+    s->page_hash = (uint32_t*)grow(s->page_hash, pages * sizeof(uint32_t));
+    if (!s->data || !s->fetched_gen || !s->used_gen || !s->page_hash) {
+      notify(NOTIFY_ERR, "snapshot: out of memory for %u pages", pages);
+      snapshot_free(s);
+      return false;
+    }
+    s->page_cap = pages;
+  }
+
+  memset(s->fetched_gen, 0, pages * sizeof(uint32_t));
+  memset(s->used_gen, 0, pages * sizeof(uint32_t));
+  s->mt = mt;
+  s->size = size;
+  s->page_count = pages;
+  s->gen = 0;
+  s->changed = false;
+  s->error = false;
+  s->frame_pages = 0;
+  s->frame_reads = 0;
+  return true;
+}
+
+void snapshot_free(snapshot_t *s) {
+  free(s->data);
+  free(s->fetched_gen);
+  free(s->used_gen);
+  free(s->page_hash);
+  memset(s, 0, sizeof(*s));
+}
+
+/* Read pages [p, q) with one seek+read and note whether any of them changed. */
+static bool read_run(snapshot_t *s, uint32_t p, uint32_t q) {
+  size_t off = (size_t)p << SNAPSHOT_PAGE_SHIFT;
+  size_t end = (size_t)q << SNAPSHOT_PAGE_SHIFT;
+  if (end > s->size) end = s->size;
+
+  if (!memtap_seek(s->mt, (uint32_t)off)) return false;
+  ssize_t r = memtap_read(s->mt, s->data + off, end - off);
+  if (r < 0 || (size_t)r != end - off) {
+    notify_limited(NOTIFY_ERR, "snapshot: read at 0x%zx got %zd (expected %zu)", off, r, end - off);
+    return false;
+  }
+  if (s->mt->ingest) s->mt->ingest(s->data + off, end - off);
+
+  for (uint32_t i = p; i < q; i++) {
+    size_t po = (size_t)i << SNAPSHOT_PAGE_SHIFT;
+    size_t pn = (po + SNAPSHOT_PAGE_SIZE > end) ? end - po : SNAPSHOT_PAGE_SIZE;
+    uint32_t h = page_fnv1a32(s->data + po, pn);
+    if (s->fetched_gen[i] == 0 || h != s->page_hash[i]) s->changed = true;
+    s->page_hash[i] = h;
+    s->fetched_gen[i] = s->gen;
+  }
+
+  s->frame_pages += q - p;
+  s->frame_reads++;
+  s->total_pages += q - p;
+  s->total_reads++;
+  return true;
+}
+
+void snapshot_begin_frame(snapshot_t *s) {
+  if (!s->mt) return;
+
+  if (++s->gen == 0) {
+    /* wrapped (years at 60 fps): forget everything rather than alias generations */
+    memset(s->fetched_gen, 0, s->page_count * sizeof(uint32_t));
+    memset(s->used_gen, 0, s->page_count * sizeof(uint32_t));
+    s->gen = 1;
+  }
+  s->changed = false;
+  s->error = false;
+  s->frame_pages = 0;
+  s->frame_reads = 0;
+
+  const uint32_t prev = s->gen - 1u;
+  if (prev == 0) return;
+
+  uint32_t p = 0;
+  while (p < s->page_count) {
+    if (s->used_gen[p] != prev) {
+      p++;
+      continue;
+    }
+    uint32_t q = p + 1;
+    while (q < s->page_count && s->used_gen[q] == prev) q++;
+    if (!read_run(s, p, q)) {
+      s->error = true;
+      return;
+    }
+    p = q;
+  }
+}
+
+void snapshot_keep_working_set(snapshot_t *s) {
+  if (!s->mt || s->gen <= 1) return;
+  const uint32_t prev = s->gen - 1u;
+  for (uint32_t p = 0; p < s->page_count; p++) {
+    if (s->used_gen[p] == prev) s->used_gen[p] = s->gen;
+  }
+}
+
+const uint8_t *snapshot_fetch(snapshot_t *s, uint32_t addr, uint32_t len) {
+  if (!s->mt || s->gen == 0 || s->error || addr >= s->size) return NULL;
+  if (len == 0) len = 1;
+
+  uint32_t last = (len > s->size - addr) ? s->size - 1u : addr + len - 1u;
+  uint32_t p = addr >> SNAPSHOT_PAGE_SHIFT;
+  uint32_t p_end = (last >> SNAPSHOT_PAGE_SHIFT) + 1u;
+
+  while (p < p_end) {
+    s->used_gen[p] = s->gen;
+    if (s->fetched_gen[p] == s->gen) {
+      p++;
+      continue;
+    }
+    uint32_t q = p + 1;
+    while (q < p_end && s->fetched_gen[q] != s->gen) {
+      s->used_gen[q] = s->gen;
+      q++;
+    }
+    if (!read_run(s, p, q)) {
+      s->error = true;
+      return NULL;
+    }
+    p = q;
+  }
+  return s->data + addr;
+}
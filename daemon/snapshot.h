@@ -0,0 +1,62 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "memtap.h"
+
+// Demand-paged view of the selected memtap region, for cores whose RAM is
+// too large to copy every frame.
+//
+// Nothing is read up front. The engine's peek path calls snapshot_fetch(),
+// which reads the pages covering the access from memtap the first time they
+// are touched in the current frame generation; later peeks in the same
+// generation are served from the cache. snapshot_begin_frame() starts a new
+// generation and prefetches, in coalesced runs, the pages peeked during the
+// previous one (achievement reads are nearly the same set every frame), so
+// steady-state I/O is one seek+read per run of pages actually used.
+//
+// The backing store is calloc'd at region size; pages never touched are
+// never written, so for large regions they stay untouched zero pages.
+
+#define SNAPSHOT_PAGE_SHIFT 10u
+#define SNAPSHOT_PAGE_SIZE  (1u << SNAPSHOT_PAGE_SHIFT)
+
+// regions at least this large are paged even without --paged
+#define SNAPSHOT_PAGED_AUTO_BYTES (1u << 20)
+
+typedef struct {
+  memtap_t *mt;
+  uint32_t size;
+  uint32_t page_count;
+  uint32_t page_cap;
+
+  uint8_t *data;            // region image; only fetched pages are meaningful
+  uint32_t *fetched_gen;    // generation each page was last read in (0 = never)
+  uint32_t *used_gen;       // generation each page was last peeked in
+  uint32_t *page_hash;      // FNV-1a of each page as last read
+
+  uint32_t gen;
+  bool changed;             // a page read this generation differed from before
+  bool error;               // a read failed; peeks in this generation return NULL
+
+  uint32_t frame_pages;     // pages / read calls this generation
+  uint32_t frame_reads;
+  uint64_t total_pages;
+  uint64_t total_reads;
+} snapshot_t;
+
+// (Re)bind to the region memtap currently has selected. Buffers are reused
+// when they are large enough; every page starts out unfetched.
+bool snapshot_attach(snapshot_t *s, memtap_t *mt, uint32_t size);
+void snapshot_free(snapshot_t *s);
+
+// New generation; prefetches the previous generation's working set.
+void snapshot_begin_frame(snapshot_t *s);
+
+// The caller skipped evaluation this generation (nothing it reads changed):
+// carry the working set over so the next prefetch still covers it.
+void snapshot_keep_working_set(snapshot_t *s);
+
+// Pointer to len bytes at addr, valid for this generation, or NULL if the
+// range is outside the region or could not be read.
+const uint8_t *snapshot_fetch(snapshot_t *s, uint32_t addr, uint32_t len);
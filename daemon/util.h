@@ -5,3 +5,11 @@
 uint64_t now_ms(void);
 void sleep_ms(uint32_t ms);
 bool file_exists(const char *path);
+
+// Monotonic clock in nanoseconds, and an absolute sleep against it (for
+// drift-free pacing loops).
+uint64_t now_ns(void);
+void sleep_until_ns(uint64_t deadline_ns);
+
+// CPU time consumed by the calling thread, in nanoseconds.
+uint64_t thread_cpu_ns(void);
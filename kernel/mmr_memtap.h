@@ -9,6 +9,14 @@
  *  - read() pulls bytes from the latest published snapshot for that region
  *  - optional WAIT_FRAME blocks until a newer frame snapshot exists
  *  - optional SEEK sets per-fd offset for subsequent read()
+ *  - optional GET_DIRTY reports which pages changed since a given frame
+ *  - privileged producers may PUBLISH a complete frame for a region
+ *  - privileged producers may SET_CORE; GET_INFO then reports the new
+ *    core_id with a bumped map_version (consumers poll for the change)
+ *  - optional READ_FRAME copies a whole frame from a short per-region
+ *    history, so a reader that fell behind can evaluate every frame
+ *  - every frame carries publish_ns, the CLOCK_MONOTONIC time the producer
+ *    published it, so readers can measure latency from the game's side
  *
  * This header is intended for BOTH kernel driver and userspace.
  */
@@ -21,7 +29,7 @@
   #include <sys/ioctl.h>
 #endif
 
-#define MMR_ABI_VERSION 1
+#define MMR_ABI_VERSION 2   /* 2: publish_ns in info, dirty and frame requests */
 #define MMR_MEMTAP_MAGIC 0x4D4D52u /* 'MMR' */
 
 #define MMR_MAX_REGIONS 16
@@ -52,6 +60,7 @@ enum mmr_region_id {
 
 enum mmr_region_flags {
   MMR_RF_SNAPSHOT = 1 << 0, /* reads return latest snapshot (read-only) */
+  MMR_RF_DIRTY    = 1 << 1, /* GET_DIRTY page tracking is available */
 };
 
 struct mmr_info {
@@ -60,6 +69,7 @@ struct mmr_info {
   uint32_t map_version;     /* per-core map revision (0 for loopback) */
   uint32_t region_count;    /* how many region_desc entries are valid */
   uint64_t frame_counter;   /* increments whenever a new snapshot is published */
+  uint64_t publish_ns;      /* CLOCK_MONOTONIC when frame_counter was published */
 };
 
 struct mmr_region_desc {
@@ -75,12 +85,74 @@ struct mmr_seek_req {
   uint32_t reserved;
 };
 
+/*
+ * Dirty-page tracking for the selected region.
+ *
+ * The producer records the frame in which each MMR_DIRTY_PAGE_SIZE page last
+ * changed. GET_DIRTY fills a caller-supplied bitmap (bit i%8 of byte i/8 is
+ * page i) with the pages that changed after since_frame, so userspace can
+ * re-read only those. since_frame == 0 reports every page (initial copy).
+ * Pass the returned frame_counter as since_frame on the next call.
+ */
+#define MMR_DIRTY_PAGE_SHIFT 8u
+#define MMR_DIRTY_PAGE_SIZE  (1u << MMR_DIRTY_PAGE_SHIFT)
+
+struct mmr_dirty_req {
+  uint64_t since_frame;     /* in: report pages changed after this frame */
+  uint64_t bitmap_ptr;      /* in: user pointer to the bitmap buffer */
+  uint32_t bitmap_bytes;    /* in: size of the bitmap buffer */
+  uint32_t page_shift;      /* out: log2 of the page size */
+  uint32_t page_count;      /* out: pages in the selected region */
+  uint32_t dirty_count;     /* out: bits set in the bitmap */
+  uint64_t frame_counter;   /* out: frame the bitmap was taken at */
+  uint64_t publish_ns;      /* out: when that frame was published */
+};
+
+/*
+ * Producer-side frame publication (loopback driver: load generators, tests).
+ * Requires CAP_SYS_ADMIN and an fd opened for writing. size must equal the
+ * region size; the frame becomes visible to readers atomically and wakes
+ * WAIT_FRAME waiters.
+ */
+struct mmr_publish_req {
+  uint32_t region_id;       /* in: enum mmr_region_id */
+  uint32_t size;            /* in: bytes at data_ptr (== region size) */
+  uint64_t data_ptr;        /* in: user pointer to the frame contents */
+  uint64_t frame_counter;   /* out: frame number assigned to this publish */
+};
+
+/*
+ * Frame history for the selected region (readers that fall behind).
+ *
+ * The producer keeps the last `history` frames it published for each region.
+ * Frames of one region are numbered by seq (1, 2, 3, ... per region, unlike
+ * frame_counter, which every region shares). READ_FRAME copies the oldest
+ * retained frame with seq > after_seq into data_ptr; if none is newer it
+ * copies the latest one (seq <= after_seq: nothing new). after_seq == 0
+ * always returns the latest frame. A returned seq above after_seq + 1 means
+ * the frames in between were dropped from the history before being read.
+ */
+struct mmr_frame_req {
+  uint64_t after_seq;       /* in: last seq the caller has seen (0 = none) */
+  uint64_t data_ptr;        /* in: user pointer to a region-sized buffer */
+  uint32_t size;            /* in: bytes at data_ptr (>= region size) */
+  uint32_t history;         /* out: frames kept per region (0 = latest only) */
+  uint64_t seq;             /* out: seq of the frame copied */
+  uint64_t frame_counter;   /* out: frame_counter it was published at */
+  uint64_t latest_seq;      /* out: newest seq published for the region */
+  uint64_t publish_ns;      /* out: when the frame copied was published */
+};
+
 /* ioctl ABI (shared) */
 #define MMR_IOCTL_GET_INFO       _IOR(MMR_MEMTAP_MAGIC, 0x01, struct mmr_info)
 #define MMR_IOCTL_GET_REGIONS    _IOR(MMR_MEMTAP_MAGIC, 0x02, struct mmr_region_desc[MMR_MAX_REGIONS])
 #define MMR_IOCTL_SELECT_REGION  _IOW(MMR_MEMTAP_MAGIC, 0x03, uint32_t)
 #define MMR_IOCTL_WAIT_FRAME     _IOW(MMR_MEMTAP_MAGIC, 0x04, uint64_t)
 #define MMR_IOCTL_SEEK           _IOW(MMR_MEMTAP_MAGIC, 0x05, struct mmr_seek_req)
+#define MMR_IOCTL_GET_DIRTY      _IOWR(MMR_MEMTAP_MAGIC, 0x06, struct mmr_dirty_req)
+#define MMR_IOCTL_PUBLISH        _IOWR(MMR_MEMTAP_MAGIC, 0x07, struct mmr_publish_req)
+#define MMR_IOCTL_SET_CORE       _IOW(MMR_MEMTAP_MAGIC, 0x08, uint32_t)
+#define MMR_IOCTL_READ_FRAME     _IOWR(MMR_MEMTAP_MAGIC, 0x09, struct mmr_frame_req)
 
 #ifdef __cplusplus
 }
@@ -5,6 +5,29 @@
 // Provides the ioctl ABI defined in kernel/mmr_memtap.h and implements
 // read()/llseek() over snapshot files on disk (nes_path/snes_path/gen_path).
 //
+// A delayed work item plays the role of the FPGA producer: every
+// 1/publish_hz seconds it re-reads the backing files and publishes them as a
+// new frame. Readers are served from the published copy, and per-page change
+// tracking (GET_DIRTY) is computed at publish time. With user_publish=1,
+// userspace producers can also push whole frames through MMR_IOCTL_PUBLISH,
+// including for regions that have no backing file.
+//
+// Locking: gdev.lock serializes producers only. The region layout and each
+// region's latest snapshot are published with RCU, and frame_counter is an
+// atomic, so read()/llseek()/ioctl never take the mutex. Readers copy the
+// snapshot into a per-fd bounce buffer inside the RCU read section and do
+// copy_to_user() after leaving it. Producers recycle a retired snapshot only
+// once the grace period that started when it was retired has elapsed.
+//
+// History: each region also keeps its last `history` frames in a ring of
+// copies, written by the producer under a per-slot seqcount, so
+// MMR_IOCTL_READ_FRAME can hand a reader that fell behind the frames it
+// missed, in order, without taking the mutex either.
+//
+// Observability: per-CPU counters are summed into
+// /sys/kernel/debug/mmr_memtap/stats, and the mmr_memtap tracepoints
+// (mmr_memtap_trace.h) mark publish, read and WAIT_FRAME.
+//
 // This enables daemon/mmr-daemon "device mode" testing without FPGA patches.
 // Later: replace file-backed reads with FPGA bridge reads, keep ABI unchanged.
 
@@ -15,13 +38,27 @@
 #include <linux/miscdevice.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
 #include <linux/mutex.h>
 #include <linux/wait.h>
 #include <linux/sched.h>
 #include <linux/errno.h>
+#include <linux/atomic.h>
+#include <linux/rcupdate.h>
+#include <linux/seqlock.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/capability.h>
 
 #include "../mmr_memtap.h"  // IMPORTANT: shared ABI header
 
+#define CREATE_TRACE_POINTS
+#include "mmr_memtap_trace.h"
+
 // Module parameters: backing snapshot file paths
 static char *nes_path  = NULL;
 static char *snes_path = NULL;
@@ -34,44 +71,150 @@ MODULE_PARM_DESC(snes_path, "Path to SNES WRAM snapshot file (131072 bytes)");
 module_param(gen_path, charp, 0644);
 MODULE_PARM_DESC(gen_path,  "Path to Genesis 68K RAM snapshot file (65536 bytes)");
 
-struct mmr_loopback_dev {
-	struct mutex lock;
+static unsigned int publish_hz = 60;
+module_param(publish_hz, uint, 0444);
+MODULE_PARM_DESC(publish_hz, "Rate at which backing files are re-read and published as frames (default 60)");
+
+static unsigned int history = 8;
+module_param(history, uint, 0444);
+MODULE_PARM_DESC(history, "Frames kept per region for MMR_IOCTL_READ_FRAME (0..256, default 8; 0 = latest only)");
+
+static bool user_publish = false;
+module_param(user_publish, bool, 0444);
+MODULE_PARM_DESC(user_publish, "Expose every known region for MMR_IOCTL_PUBLISH, even without a backing file");
+
+/* One published frame of a region. page_frame and data trail the struct. */
+struct mmr_snapshot {
+	u64 frame;         /* frame this snapshot was published in */
+	u64 seq;           /* per-region publish number (mmr_frame_req.seq) */
+	u64 publish_ns;    /* ktime_get_ns() at publication */
+	u64 *page_frame;   /* frame in which each page last changed */
+	u8 *data;
+};
+
+/* One retained frame. Written under gdev.lock, read under the seqcount only.
+ * A plain seqcount_t (not seqcount_mutex_t, which needs 5.10) keeps the
+ * module building on the older kernels the compat code below covers; the
+ * writer asserts the mutex and runs with preemption off instead, for the
+ * metadata only: data is copied while the slot is marked empty
+ * (region_seq 0), between two short write sections. */
+struct mmr_hist_slot {
+	seqcount_t seq;
+	u64 region_seq;    /* 0 = never written */
+	u64 frame;
+	u64 publish_ns;
+	u8 *data;
+};
+
+struct mmr_region {
+	struct mmr_region_desc desc;
+	const char *path;
+	u32 page_count;
+
+	struct mmr_snapshot __rcu *snap;  /* latest frame; NULL until first publish */
+	struct mmr_snapshot *spare;       /* producer-owned, retired at spare_gp */
+	unsigned long spare_gp;           /* RCU cookie taken when spare was retired */
 
+	u64 seq;                          /* publishes so far */
+	struct mmr_hist_slot *hist;       /* hist_len slots, seq % hist_len; NULL = none */
+	u32 hist_len;
+};
+
+/* Region metadata. Replaced as a whole, never modified in place once published. */
+struct mmr_layout {
 	u32 core_id;
 	u32 map_version;
 
-	struct mmr_region_desc regions[MMR_MAX_REGIONS];
+	struct mmr_region regions[MMR_MAX_REGIONS];
 	u32 region_count;
+	u32 max_size;      /* largest region; sizes per-fd bounce buffers */
+	bool has_files;    /* at least one region is file-backed */
+};
+
+struct mmr_loopback_dev {
+	struct mutex lock;  /* producers only */
+
+	struct mmr_layout __rcu *layout;
 
-	u64 frame_counter;
+	atomic64_t frame_counter;
+	u64 frame_ns;         /* publish stamp of frame_counter (GET_INFO) */
 	wait_queue_head_t wq;
+	u64 last_publish_ns;  /* ktime of the latest wake-up, for wake latency */
+
+	struct delayed_work publish_work;
+
+	u64 load_ns;
+	struct dentry *debugfs_dir;
 };
 
 static struct mmr_loopback_dev gdev;
 
+/* ---------------- statistics ---------------- */
+
+/* Per-CPU so the read path never bounces a shared cache line. */
+struct mmr_pcpu_stats {
+	u64 reads;
+	u64 read_bytes;
+	u64 read_errors;
+	u64 dirty_queries;
+	u64 frame_reads;      /* READ_FRAME calls ... */
+	u64 history_reads;    /* ... served from the history, not the latest frame */
+
+	u64 wait_calls;
+	u64 wait_sleeps;      /* WAIT_FRAME calls that actually blocked */
+	u64 wait_wake_ns;     /* sum of publish -> waiter-running latency */
+	u64 wait_wake_ns_max;
+
+	u64 publishes;
+	u64 publish_ns;       /* time spent in the producer */
+	u64 dirty_pages;
+
+	u64 region_reads[MMR_MAX_REGIONS];
+	u64 region_bytes[MMR_MAX_REGIONS];
+};
+
+static DEFINE_PER_CPU(struct mmr_pcpu_stats, mmr_stats);
+
+#define MMR_STAT_ADD(field, n) this_cpu_add(mmr_stats.field, (n))
+#define MMR_STAT_INC(field)    this_cpu_inc(mmr_stats.field)
+
 struct mmr_file_state {
+	struct mutex lock;  /* per-fd: offset and bounce buffers */
+
 	u32 selected_region;
 	u32 offset;
+
+	/* preallocated at open so the read path never allocates */
+	u8 *bounce;
+	u32 bounce_size;
+	u8 *dirty_bits;
+	u32 dirty_bytes;
 };
 
-static const char *path_for_region(u32 region_id)
+/* Caller holds rcu_read_lock() or gdev.lock. */
+static struct mmr_region *layout_find(struct mmr_layout *l, u32 region_id)
 {
-	switch (region_id) {
-	case MMR_REGION_NES_CPU_RAM: return nes_path;
-	case MMR_REGION_SNES_WRAM:   return snes_path;
-	case MMR_REGION_GEN_68K_RAM: return gen_path;
-	default: return NULL;
+	u32 i;
+
+	if (!l)
+		return NULL;
+	for (i = 0; i < l->region_count; i++) {
+		if (l->regions[i].desc.region_id == region_id)
+			return &l->regions[i];
 	}
+	return NULL;
 }
 
 static u32 size_for_region(u32 region_id)
 {
-	u32 i;
-	for (i = 0; i < gdev.region_count; i++) {
-		if (gdev.regions[i].region_id == region_id)
-			return gdev.regions[i].size_bytes;
-	}
-	return 0;
+	struct mmr_region *r;
+	u32 size;
+
+	rcu_read_lock();
+	r = layout_find(rcu_dereference(gdev.layout), region_id);
+	size = r ? r->desc.size_bytes : 0;
+	rcu_read_unlock();
+	return size;
 }
 
 static bool region_is_valid(u32 region_id)
@@ -108,21 +251,337 @@ static ssize_t file_read_exact(const char *path, loff_t offset, void *buf, size_
 	return r;
 }
 
+/* ---------------- producer ---------------- */
+
+static struct mmr_snapshot *snapshot_alloc(const struct mmr_region *r)
+{
+	struct mmr_snapshot *s;
+
+	s = kvzalloc(sizeof(*s) + r->page_count * sizeof(u64) + r->desc.size_bytes, GFP_KERNEL);
+	if (!s)
+		return NULL;
+	s->page_frame = (u64 *)(s + 1);
+	s->data = (u8 *)(s->page_frame + r->page_count);
+	return s;
+}
+
+static void region_init(struct mmr_region *r, u32 region_id, u32 size, const char *path)
+{
+	memset(r, 0, sizeof(*r));
+	r->desc = (struct mmr_region_desc){
+		.region_id  = region_id,
+		.flags      = MMR_RF_SNAPSHOT | MMR_RF_DIRTY,
+		.size_bytes = size,
+	};
+	r->path = path;
+	r->page_count = DIV_ROUND_UP(size, MMR_DIRTY_PAGE_SIZE);
+	RCU_INIT_POINTER(r->snap, NULL);
+}
+
+/*
+ * History ring for r (first publish). Failure only costs READ_FRAME its
+ * older frames; the region itself keeps working.
+ */
+static void region_alloc_history(struct mmr_region *r)
+{
+	struct mmr_hist_slot *h;
+	u32 i;
+
+	if (!history)
+		return;
+	h = kvzalloc(history * (sizeof(*h) + r->desc.size_bytes), GFP_KERNEL);
+	if (!h) {
+		pr_warn("mmr_memtap_loopback: no memory for region %u history\n", r->desc.region_id);
+		return;
+	}
+	for (i = 0; i < history; i++) {
+		seqcount_init(&h[i].seq);
+		h[i].data = (u8 *)(h + history) + (size_t)i * r->desc.size_bytes;
+	}
+	r->hist = h;
+	r->hist_len = history;
+}
+
+/*
+ * Spare snapshot ready to be overwritten: allocated on first use, otherwise
+ * waits (only if still needed) for readers of its retired frame to finish.
+ */
+static struct mmr_snapshot *region_get_spare(struct mmr_region *r)
+{
+	if (!r->spare) {
+		r->spare = snapshot_alloc(r);
+		if (r->spare && !r->hist)
+			region_alloc_history(r);
+		return r->spare;
+	}
+	cond_synchronize_rcu(r->spare_gp);
+	return r->spare;
+}
+
+/* Only called once no reader can reach r (module exit). */
+static void region_free(struct mmr_region *r)
+{
+	kvfree(rcu_dereference_protected(r->snap, 1));
+	kvfree(r->spare);
+	kvfree(r->hist);
+	RCU_INIT_POINTER(r->snap, NULL);
+	r->spare = NULL;
+	r->hist = NULL;
+}
+
+/*
+ * Publish r->spare (already filled with the new contents) as frame 'frame',
+ * stamped stamp_ns:
+ * stamp the pages that differ from the current snapshot, copy it into the
+ * history, swap it in, and keep the old one as the next spare (see
+ * region_get_spare). Caller holds gdev.lock.
+ */
+static u32 region_publish_locked(struct mmr_region *r, u64 frame, u64 stamp_ns)
+{
+	struct mmr_snapshot *cur = rcu_dereference_protected(r->snap, lockdep_is_held(&gdev.lock));
+	struct mmr_snapshot *next = r->spare;
+	u32 size = r->desc.size_bytes;
+	u32 dirty = 0;
+	u32 p;
+
+	for (p = 0; p < r->page_count; p++) {
+		u32 off = p << MMR_DIRTY_PAGE_SHIFT;
+		u32 n = min_t(u32, MMR_DIRTY_PAGE_SIZE, size - off);
+
+		if (!cur || memcmp(next->data + off, cur->data + off, n)) {
+			next->page_frame[p] = frame;
+			dirty++;
+		} else {
+			next->page_frame[p] = cur->page_frame[p];
+		}
+	}
+	next->frame = frame;
+	next->seq = ++r->seq;
+	next->publish_ns = stamp_ns;
+
+	if (r->hist) {
+		struct mmr_hist_slot *h = &r->hist[next->seq % r->hist_len];
+
+		lockdep_assert_held(&gdev.lock);
+		/*
+		 * Only the metadata is written inside the count, with preemption
+		 * off: retire the slot (region_seq 0 matches no request, and a
+		 * reader already copying fails its retry), copy the frame in
+		 * preemptibly, then stamp it valid. A region is up to 128 KiB.
+		 */
+		preempt_disable();
+		write_seqcount_begin(&h->seq);
+		h->region_seq = 0;
+		write_seqcount_end(&h->seq);
+		preempt_enable();
+
+		memcpy(h->data, next->data, size);
+
+		preempt_disable();
+		write_seqcount_begin(&h->seq);
+		h->region_seq = next->seq;
+		h->frame = frame;
+		h->publish_ns = stamp_ns;
+		write_seqcount_end(&h->seq);
+		preempt_enable();
+	}
+
+	rcu_assign_pointer(r->snap, next);
+	r->spare = cur;
+	r->spare_gp = get_state_synchronize_rcu();
+
+	trace_mmr_publish(frame, r->desc.region_id, dirty);
+	return dirty;
+}
+
+/* Re-read every backing file and publish the set as one new frame. */
+static void mmr_publish_files(void)
+{
+	struct mmr_layout *l;
+	bool fresh[MMR_MAX_REGIONS];
+	bool any = false;
+	u64 t0 = ktime_get_ns();
+	u64 frame, stamp;
+	u32 dirty = 0;
+	u32 i;
+
+	mutex_lock(&gdev.lock);
+	l = rcu_dereference_protected(gdev.layout, lockdep_is_held(&gdev.lock));
+
+	/* spares are invisible to readers, so the file I/O can fill them directly */
+	for (i = 0; i < l->region_count; i++) {
+		struct mmr_region *r = &l->regions[i];
+		struct mmr_snapshot *spare;
+		ssize_t ret;
+
+		fresh[i] = false;
+		if (!r->path)
+			continue;  /* fed by MMR_IOCTL_PUBLISH only */
+
+		spare = region_get_spare(r);
+		if (!spare)
+			continue;
+
+		ret = file_read_exact(r->path, 0, spare->data, r->desc.size_bytes);
+		if (ret < 0) {
+			pr_warn_ratelimited("mmr_memtap_loopback: read %s failed: %zd\n", r->path, ret);
+			continue;
+		}
+		fresh[i] = true;
+		any = true;
+	}
+
+	if (!any) {
+		mutex_unlock(&gdev.lock);
+		return;
+	}
+
+	/* every region of one frame carries the same stamp */
+	frame = atomic64_read(&gdev.frame_counter) + 1;
+	stamp = ktime_get_ns();
+	for (i = 0; i < l->region_count; i++) {
+		if (fresh[i])
+			dirty += region_publish_locked(&l->regions[i], frame, stamp);
+	}
+	WRITE_ONCE(gdev.frame_ns, stamp);
+	smp_wmb();	/* pairs with smp_rmb() in GET_INFO: stamp before counter */
+	atomic64_set(&gdev.frame_counter, frame);
+	WRITE_ONCE(gdev.last_publish_ns, ktime_get_ns());
+	wake_up_interruptible(&gdev.wq);
+	mutex_unlock(&gdev.lock);
+
+	MMR_STAT_INC(publishes);
+	MMR_STAT_ADD(dirty_pages, dirty);
+	MMR_STAT_ADD(publish_ns, ktime_get_ns() - t0);
+}
+
+/*
+ * MMR_IOCTL_SET_CORE: publish a copy of the layout with a new core_id and a
+ * bumped map_version. The copy takes over the region snapshots as-is; readers
+ * still holding the old layout only see snapshots that are themselves freed
+ * or recycled after a grace period, so only the old struct needs freeing.
+ */
+static long mmr_set_core(u32 core_id)
+{
+	struct mmr_layout *old, *l;
+
+	if (core_id == MMR_CORE_UNKNOWN)
+		return -EINVAL;
+
+	if (mutex_lock_interruptible(&gdev.lock))
+		return -ERESTARTSYS;
+
+	old = rcu_dereference_protected(gdev.layout, lockdep_is_held(&gdev.lock));
+	if (old->core_id == core_id) {
+		mutex_unlock(&gdev.lock);
+		return 0;
+	}
+
+	l = kmemdup(old, sizeof(*old), GFP_KERNEL);
+	if (!l) {
+		mutex_unlock(&gdev.lock);
+		return -ENOMEM;
+	}
+	l->core_id = core_id;
+	l->map_version = old->map_version + 1;
+	rcu_assign_pointer(gdev.layout, l);
+	mutex_unlock(&gdev.lock);
+
+	pr_info("mmr_memtap_loopback: core_id=%u map_version=%u\n", l->core_id, l->map_version);
+
+	synchronize_rcu();
+	kfree(old);
+	return 0;
+}
+
+/* MMR_IOCTL_PUBLISH: one region, one new frame, contents from userspace. */
+static long mmr_publish_user(struct mmr_publish_req *req)
+{
+	struct mmr_layout *l;
+	struct mmr_region *r;
+	struct mmr_snapshot *spare;
+	u64 t0 = ktime_get_ns();
+	u64 frame, stamp;
+	u32 dirty;
+
+	if (mutex_lock_interruptible(&gdev.lock))
+		return -ERESTARTSYS;
+
+	l = rcu_dereference_protected(gdev.layout, lockdep_is_held(&gdev.lock));
+	r = layout_find(l, req->region_id);
+	if (!r || req->size != r->desc.size_bytes) {
+		mutex_unlock(&gdev.lock);
+		return -EINVAL;
+	}
+
+	spare = region_get_spare(r);
+	if (!spare) {
+		mutex_unlock(&gdev.lock);
+		return -ENOMEM;
+	}
+
+	if (copy_from_user(spare->data, (const void __user *)(uintptr_t)req->data_ptr, req->size)) {
+		mutex_unlock(&gdev.lock);
+		return -EFAULT;
+	}
+
+	frame = atomic64_read(&gdev.frame_counter) + 1;
+	stamp = ktime_get_ns();
+	dirty = region_publish_locked(r, frame, stamp);
+	WRITE_ONCE(gdev.frame_ns, stamp);
+	smp_wmb();	/* pairs with smp_rmb() in GET_INFO: stamp before counter */
+	atomic64_set(&gdev.frame_counter, frame);
+	WRITE_ONCE(gdev.last_publish_ns, ktime_get_ns());
+	wake_up_interruptible(&gdev.wq);
+	mutex_unlock(&gdev.lock);
+
+	MMR_STAT_INC(publishes);
+	MMR_STAT_ADD(dirty_pages, dirty);
+	MMR_STAT_ADD(publish_ns, ktime_get_ns() - t0);
+
+	req->frame_counter = frame;
+	return 0;
+}
+
+static void mmr_publish_work_fn(struct work_struct *work)
+{
+	mmr_publish_files();
+	schedule_delayed_work(&gdev.publish_work, msecs_to_jiffies(1000 / publish_hz));
+}
+
 /* ---------------- file ops ---------------- */
 
 static int mmr_open(struct inode *inode, struct file *f)
 {
 	struct mmr_file_state *st;
+	struct mmr_layout *l;
+	u32 max_size, max_pages;
 
 	st = kzalloc(sizeof(*st), GFP_KERNEL);
 	if (!st)
 		return -ENOMEM;
 
+	mutex_init(&st->lock);
+
 	/* default region: first exposed region */
-	mutex_lock(&gdev.lock);
-	st->selected_region = (gdev.region_count ? gdev.regions[0].region_id : MMR_REGION_NONE);
+	rcu_read_lock();
+	l = rcu_dereference(gdev.layout);
+	st->selected_region = (l && l->region_count ? l->regions[0].desc.region_id : MMR_REGION_NONE);
+	max_size = l ? l->max_size : 0;
+	rcu_read_unlock();
 	st->offset = 0;
-	mutex_unlock(&gdev.lock);
+
+	max_pages = DIV_ROUND_UP(max_size, MMR_DIRTY_PAGE_SIZE);
+	st->bounce_size = max_size;
+	st->dirty_bytes = DIV_ROUND_UP(max_pages, 8);
+	st->bounce = kvmalloc(max(st->bounce_size, 1u), GFP_KERNEL);
+	st->dirty_bits = kvmalloc(max(st->dirty_bytes, 1u), GFP_KERNEL);
+	if (!st->bounce || !st->dirty_bits) {
+		kvfree(st->bounce);
+		kvfree(st->dirty_bits);
+		kfree(st);
+		return -ENOMEM;
+	}
 
 	f->private_data = st;
 	return 0;
@@ -131,6 +590,11 @@ static int mmr_open(struct inode *inode, struct file *f)
 static int mmr_release(struct inode *inode, struct file *f)
 {
 	struct mmr_file_state *st = f->private_data;
+
+	if (st) {
+		kvfree(st->bounce);
+		kvfree(st->dirty_bits);
+	}
 	kfree(st);
 	f->private_data = NULL;
 	return 0;
@@ -145,86 +609,175 @@ static loff_t mmr_llseek(struct file *f, loff_t off, int whence)
 	if (!st)
 		return -EINVAL;
 
-	mutex_lock(&gdev.lock);
+	mutex_lock(&st->lock);
 	size = size_for_region(st->selected_region);
-	mutex_unlock(&gdev.lock);
 
-	if (!size)
-		return -EINVAL;
+	if (!size) {
+		newpos = -EINVAL;
+		goto out;
+	}
 
 	switch (whence) {
 	case SEEK_SET: newpos = off; break;
 	case SEEK_CUR: newpos = (loff_t)st->offset + off; break;
 	case SEEK_END: newpos = (loff_t)size + off; break;
-	default: return -EINVAL;
+	default: newpos = -EINVAL; goto out;
 	}
 
-	if (newpos < 0)
-		return -EINVAL;
-	if (newpos > (loff_t)size)
-		return -EINVAL;
+	if (newpos < 0 || newpos > (loff_t)size) {
+		newpos = -EINVAL;
+		goto out;
+	}
 
 	st->offset = (u32)newpos;
+out:
+	mutex_unlock(&st->lock);
 	return newpos;
 }
 
 static ssize_t mmr_read(struct file *f, char __user *ubuf, size_t len, loff_t *ppos)
 {
 	struct mmr_file_state *st = f->private_data;
-	const char *path;
-	u32 size;
-	ssize_t r;
-	void *kbuf;
+	struct mmr_layout *l;
+	struct mmr_region *r;
+	struct mmr_snapshot *snap;
+	ssize_t ret;
+	u64 frame;
+	u32 size, slot;
 
 	if (!st || !ubuf)
 		return -EINVAL;
 
-	mutex_lock(&gdev.lock);
-	size = size_for_region(st->selected_region);
-	path = path_for_region(st->selected_region);
-	mutex_unlock(&gdev.lock);
+	mutex_lock(&st->lock);
 
-	if (!size || !path)
-		return -EINVAL;
+	rcu_read_lock();
+	l = rcu_dereference(gdev.layout);
+	r = layout_find(l, st->selected_region);
+	size = r ? r->desc.size_bytes : 0;
 
-	/* clamp len to remaining bytes */
-	if (st->offset > size)
-		return -EINVAL;
+	if (!size || st->offset > size) {
+		rcu_read_unlock();
+		ret = -EINVAL;
+		goto out;
+	}
 
+	/* clamp len to remaining bytes */
 	if (len > (size_t)(size - st->offset))
 		len = (size_t)(size - st->offset);
 
 	/* standard read semantics: allow short read at EOF */
-	if (len == 0)
-		return 0;
-
-	kbuf = kmalloc(len, GFP_KERNEL);
-	if (!kbuf)
-		return -ENOMEM;
+	if (len == 0) {
+		rcu_read_unlock();
+		ret = 0;
+		goto out;
+	}
 
-	r = file_read_exact(path, (loff_t)st->offset, kbuf, len);
-	if (r < 0) {
-		kfree(kbuf);
-		return r;
+	snap = rcu_dereference(r->snap);
+	if (!snap || len > st->bounce_size) {
+		rcu_read_unlock();
+		ret = snap ? -EINVAL : -ENODATA;
+		goto out;
 	}
 
-	if (copy_to_user(ubuf, kbuf, len)) {
-		kfree(kbuf);
-		return -EFAULT;
+	/* copy out of one published snapshot; a read never straddles two frames */
+	memcpy(st->bounce, snap->data + st->offset, len);
+	frame = snap->frame;
+	slot = (u32)(r - l->regions);
+	rcu_read_unlock();
+
+	if (copy_to_user(ubuf, st->bounce, len)) {
+		ret = -EFAULT;
+		goto out;
 	}
 
-	kfree(kbuf);
+	trace_mmr_read(st->selected_region, st->offset, (u32)len, frame);
+	MMR_STAT_INC(reads);
+	MMR_STAT_ADD(read_bytes, len);
+	MMR_STAT_INC(region_reads[slot]);
+	MMR_STAT_ADD(region_bytes[slot], len);
 
 	/* advance */
 	st->offset += (u32)len;
+	ret = (ssize_t)len;
+out:
+	if (ret < 0)
+		MMR_STAT_INC(read_errors);
+	mutex_unlock(&st->lock);
+	return ret;
+}
 
-	/* mimic frame progress + wake waiters */
-	mutex_lock(&gdev.lock);
-	gdev.frame_counter++;
-	wake_up_interruptible(&gdev.wq);
-	mutex_unlock(&gdev.lock);
+/*
+ * MMR_IOCTL_READ_FRAME into st->bounce (caller holds st->lock). Older frames
+ * come from the history slots, each copied under its seqcount: a slot the
+ * producer is rewriting holds a frame that has just dropped out, so the next
+ * one is tried. The latest frame is copied under RCU, as read() does.
+ */
+static long mmr_read_frame(struct mmr_file_state *st, struct mmr_frame_req *req, u32 *out_size)
+{
+	struct mmr_region *r;
+	struct mmr_snapshot *snap;
+	struct mmr_hist_slot *hist = NULL;
+	u64 latest = 0, want;
+	u32 size = 0, len = 0;
+
+	/* hist and hist_len move with the region to a new layout, never change */
+	rcu_read_lock();
+	r = layout_find(rcu_dereference(gdev.layout), st->selected_region);
+	snap = r ? rcu_dereference(r->snap) : NULL;
+	if (snap) {
+		size = r->desc.size_bytes;
+		hist = r->hist;
+		len = r->hist_len;
+		latest = snap->seq;
+	}
+	rcu_read_unlock();
+
+	if (!snap)
+		return r ? -ENODATA : -EINVAL;
+	if (req->size < size || size > st->bounce_size)
+		return -ENOSPC;
+
+	MMR_STAT_INC(frame_reads);
+	req->history = hist ? len : 0;
+	*out_size = size;
+
+	want = req->after_seq + 1;
+	if (hist && req->after_seq && want < latest) {
+		if (latest - want >= len)
+			want = latest - len + 1;  /* anything older is overwritten */
+		for (; want < latest; want++) {
+			struct mmr_hist_slot *h = &hist[want % len];
+			unsigned int start = raw_read_seqcount(&h->seq);
+
+			if ((start & 1) || READ_ONCE(h->region_seq) != want)
+				continue;
+			memcpy(st->bounce, h->data, size);
+			req->frame_counter = h->frame;
+			req->publish_ns = h->publish_ns;
+			if (read_seqcount_retry(&h->seq, start))
+				continue;
+
+			req->seq = want;
+			req->latest_seq = latest;
+			MMR_STAT_INC(history_reads);
+			return 0;
+		}
+	}
 
-	return (ssize_t)len;
+	rcu_read_lock();
+	r = layout_find(rcu_dereference(gdev.layout), st->selected_region);
+	snap = r ? rcu_dereference(r->snap) : NULL;
+	if (!snap) {
+		rcu_read_unlock();
+		return -ENODATA;
+	}
+	memcpy(st->bounce, snap->data, size);
+	req->seq = snap->seq;
+	req->frame_counter = snap->frame;
+	req->publish_ns = snap->publish_ns;
+	req->latest_seq = snap->seq;
+	rcu_read_unlock();
+	return 0;
 }
 
 /* ---------------- ioctl ---------------- */
@@ -237,15 +790,22 @@ static long mmr_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 	switch (cmd) {
 	case MMR_IOCTL_GET_INFO: {
 		struct mmr_info info;
+		struct mmr_layout *l;
 		memset(&info, 0, sizeof(info));
 
-		mutex_lock(&gdev.lock);
+		rcu_read_lock();
+		l = rcu_dereference(gdev.layout);
 		info.abi_version   = MMR_ABI_VERSION;
-		info.core_id       = gdev.core_id;
-		info.map_version   = gdev.map_version;
-		info.region_count  = gdev.region_count;
-		info.frame_counter = gdev.frame_counter;
-		mutex_unlock(&gdev.lock);
+		info.core_id       = l->core_id;
+		info.map_version   = l->map_version;
+		info.region_count  = l->region_count;
+		rcu_read_unlock();
+		/* the producer orders the stamp before the counter (smp_wmb) and
+		 * this reads them in the opposite order, so a racing publish can
+		 * only make the stamp newer than the frame read here, never older */
+		info.frame_counter = atomic64_read(&gdev.frame_counter);
+		smp_rmb();
+		info.publish_ns    = READ_ONCE(gdev.frame_ns);
 
 		if (copy_to_user((void __user *)arg, &info, sizeof(info)))
 			ret = -EFAULT;
@@ -254,11 +814,15 @@ static long mmr_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 
 	case MMR_IOCTL_GET_REGIONS: {
 		struct mmr_region_desc out[MMR_MAX_REGIONS];
+		struct mmr_layout *l;
+		u32 i;
 		memset(out, 0, sizeof(out));
 
-		mutex_lock(&gdev.lock);
-		memcpy(out, gdev.regions, sizeof(gdev.regions));
-		mutex_unlock(&gdev.lock);
+		rcu_read_lock();
+		l = rcu_dereference(gdev.layout);
+		for (i = 0; i < l->region_count; i++)
+			out[i] = l->regions[i].desc;
+		rcu_read_unlock();
 
 		if (copy_to_user((void __user *)arg, out, sizeof(out)))
 			ret = -EFAULT;
@@ -274,15 +838,13 @@ static long mmr_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 		if (copy_from_user(&region_id, (void __user *)arg, sizeof(region_id)))
 			return -EFAULT;
 
-		mutex_lock(&gdev.lock);
-		if (!region_is_valid(region_id)) {
-			mutex_unlock(&gdev.lock);
+		if (!region_is_valid(region_id))
 			return -EINVAL;
-		}
-		mutex_unlock(&gdev.lock);
 
+		mutex_lock(&st->lock);
 		st->selected_region = region_id;
 		st->offset = 0;
+		mutex_unlock(&st->lock);
 		break;
 	}
 
@@ -296,27 +858,139 @@ static long mmr_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 		if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
 			return -EFAULT;
 
-		mutex_lock(&gdev.lock);
+		mutex_lock(&st->lock);
 		size = size_for_region(st->selected_region);
-		mutex_unlock(&gdev.lock);
+		if (!size || req.offset > size)
+			ret = -EINVAL;
+		else
+			st->offset = req.offset;
+		mutex_unlock(&st->lock);
+		break;
+	}
 
-		if (!size)
+	case MMR_IOCTL_GET_DIRTY: {
+		struct mmr_dirty_req req;
+		struct mmr_region *r;
+		struct mmr_snapshot *snap;
+		u32 nbytes, p;
+
+		if (!st)
 			return -EINVAL;
-		if (req.offset > size)
+
+		if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+			return -EFAULT;
+
+		MMR_STAT_INC(dirty_queries);
+		mutex_lock(&st->lock);
+
+		rcu_read_lock();
+		r = layout_find(rcu_dereference(gdev.layout), st->selected_region);
+		snap = r ? rcu_dereference(r->snap) : NULL;
+		if (!r || !snap) {
+			rcu_read_unlock();
+			ret = r ? -ENODATA : -EINVAL;
+			goto dirty_out;
+		}
+
+		nbytes = DIV_ROUND_UP(r->page_count, 8);
+		if (req.bitmap_bytes < nbytes || nbytes > st->dirty_bytes) {
+			rcu_read_unlock();
+			ret = -ENOSPC;
+			goto dirty_out;
+		}
+
+		memset(st->dirty_bits, 0, nbytes);
+		req.dirty_count = 0;
+		for (p = 0; p < r->page_count; p++) {
+			if (req.since_frame == 0 || snap->page_frame[p] > req.since_frame) {
+				st->dirty_bits[p >> 3] |= (u8)(1u << (p & 7));
+				req.dirty_count++;
+			}
+		}
+		req.frame_counter = snap->frame;
+		req.publish_ns = snap->publish_ns;
+		req.page_count = r->page_count;
+		rcu_read_unlock();
+
+		req.page_shift = MMR_DIRTY_PAGE_SHIFT;
+
+		if (copy_to_user((void __user *)(uintptr_t)req.bitmap_ptr, st->dirty_bits, nbytes) ||
+		    copy_to_user((void __user *)arg, &req, sizeof(req)))
+			ret = -EFAULT;
+dirty_out:
+		mutex_unlock(&st->lock);
+		break;
+	}
+
+	case MMR_IOCTL_READ_FRAME: {
+		struct mmr_frame_req req;
+		u32 size = 0;
+
+		if (!st)
 			return -EINVAL;
 
-		st->offset = req.offset;
+		if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+			return -EFAULT;
+
+		mutex_lock(&st->lock);
+		ret = mmr_read_frame(st, &req, &size);
+		if (!ret &&
+		    (copy_to_user((void __user *)(uintptr_t)req.data_ptr, st->bounce, size) ||
+		     copy_to_user((void __user *)arg, &req, sizeof(req))))
+			ret = -EFAULT;
+		mutex_unlock(&st->lock);
+		break;
+	}
+
+	case MMR_IOCTL_PUBLISH: {
+		struct mmr_publish_req req;
+
+		if (!(f->f_mode & FMODE_WRITE) || !capable(CAP_SYS_ADMIN))
+			return -EPERM;
+
+		if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+			return -EFAULT;
+
+		ret = mmr_publish_user(&req);
+		if (!ret && copy_to_user((void __user *)arg, &req, sizeof(req)))
+			ret = -EFAULT;
+		break;
+	}
+
+	case MMR_IOCTL_SET_CORE: {
+		u32 core_id;
+
+		if (!(f->f_mode & FMODE_WRITE) || !capable(CAP_SYS_ADMIN))
+			return -EPERM;
+
+		if (copy_from_user(&core_id, (void __user *)arg, sizeof(core_id)))
+			return -EFAULT;
+
+		ret = mmr_set_core(core_id);
 		break;
 	}
 
 	case MMR_IOCTL_WAIT_FRAME: {
-		u64 last;
+		u64 last, wake_ns = 0;
 
 		if (copy_from_user(&last, (void __user *)arg, sizeof(last)))
 			return -EFAULT;
 
+		MMR_STAT_INC(wait_calls);
+		if ((u64)atomic64_read(&gdev.frame_counter) > last)
+			break;
+
 		/* wait until frame_counter > last */
-		ret = wait_event_interruptible(gdev.wq, READ_ONCE(gdev.frame_counter) > last);
+		trace_mmr_wait_begin(last);
+		MMR_STAT_INC(wait_sleeps);
+		ret = wait_event_interruptible(gdev.wq, (u64)atomic64_read(&gdev.frame_counter) > last);
+		if (!ret) {
+			wake_ns = ktime_get_ns() - READ_ONCE(gdev.last_publish_ns);
+			MMR_STAT_ADD(wait_wake_ns, wake_ns);
+			if (wake_ns > this_cpu_read(mmr_stats.wait_wake_ns_max))
+				this_cpu_write(mmr_stats.wait_wake_ns_max, wake_ns);
+		}
+		trace_mmr_wait_end(last, (u64)atomic64_read(&gdev.frame_counter), wake_ns, (int)ret);
 		if (ret)
 			return ret;
 		break;
@@ -342,6 +1016,67 @@ static const struct file_operations mmr_fops = {
 #endif
 };
 
+/* ---------------- debugfs ---------------- */
+
+static int mmr_stats_show(struct seq_file *m, void *v)
+{
+	struct mmr_pcpu_stats sum;
+	struct mmr_layout *l;
+	u64 wake_max = 0;
+	int cpu;
+	u32 i;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		const struct mmr_pcpu_stats *s = per_cpu_ptr(&mmr_stats, cpu);
+
+		sum.reads         += s->reads;
+		sum.read_bytes    += s->read_bytes;
+		sum.read_errors   += s->read_errors;
+		sum.dirty_queries += s->dirty_queries;
+		sum.frame_reads   += s->frame_reads;
+		sum.history_reads += s->history_reads;
+		sum.wait_calls    += s->wait_calls;
+		sum.wait_sleeps   += s->wait_sleeps;
+		sum.wait_wake_ns  += s->wait_wake_ns;
+		sum.publishes     += s->publishes;
+		sum.publish_ns    += s->publish_ns;
+		sum.dirty_pages   += s->dirty_pages;
+		wake_max = max(wake_max, s->wait_wake_ns_max);
+		for (i = 0; i < MMR_MAX_REGIONS; i++) {
+			sum.region_reads[i] += s->region_reads[i];
+			sum.region_bytes[i] += s->region_bytes[i];
+		}
+	}
+
+	seq_printf(m, "uptime_ms        %llu\n", div_u64(ktime_get_ns() - gdev.load_ns, NSEC_PER_MSEC));
+	seq_printf(m, "frame_counter    %lld\n", (long long)atomic64_read(&gdev.frame_counter));
+	seq_printf(m, "publishes        %llu\n", sum.publishes);
+	seq_printf(m, "publish_ns_avg   %llu\n", sum.publishes ? div64_u64(sum.publish_ns, sum.publishes) : 0);
+	seq_printf(m, "dirty_pages      %llu\n", sum.dirty_pages);
+	seq_printf(m, "reads            %llu\n", sum.reads);
+	seq_printf(m, "read_bytes       %llu\n", sum.read_bytes);
+	seq_printf(m, "read_errors      %llu\n", sum.read_errors);
+	seq_printf(m, "dirty_queries    %llu\n", sum.dirty_queries);
+	seq_printf(m, "history          %u\n", history);
+	seq_printf(m, "frame_reads      %llu\n", sum.frame_reads);
+	seq_printf(m, "history_reads    %llu\n", sum.history_reads);
+	seq_printf(m, "wait_calls       %llu\n", sum.wait_calls);
+	seq_printf(m, "wait_sleeps      %llu\n", sum.wait_sleeps);
+	seq_printf(m, "wake_ns_avg      %llu\n", sum.wait_sleeps ? div64_u64(sum.wait_wake_ns, sum.wait_sleeps) : 0);
+	seq_printf(m, "wake_ns_max      %llu\n", wake_max);
+
+	rcu_read_lock();
+	l = rcu_dereference(gdev.layout);
+	for (i = 0; l && i < l->region_count; i++) {
+		seq_printf(m, "region %-3u      reads=%llu bytes=%llu\n",
+			   l->regions[i].desc.region_id, sum.region_reads[i], sum.region_bytes[i]);
+	}
+	rcu_read_unlock();
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mmr_stats);
+
 static struct miscdevice mmr_misc = {
 	.minor = MISC_DYNAMIC_MINOR,
 	.name  = "mmr_memtap",
@@ -350,63 +1085,103 @@ static struct miscdevice mmr_misc = {
 	.mode  = 0600,
 };
 
+/* Only called once no reader can reach the layout (init failure, module exit). */
+static void mmr_free_layout(void)
+{
+	struct mmr_layout *l = rcu_dereference_protected(gdev.layout, 1);
+	u32 i;
+
+	if (!l)
+		return;
+	for (i = 0; i < l->region_count; i++)
+		region_free(&l->regions[i]);
+	RCU_INIT_POINTER(gdev.layout, NULL);
+	kfree(l);
+}
+
 static int __init mmr_init(void)
 {
+	static const struct {
+		u32 region_id;
+		u32 size;
+	} defs[] = {
+		{ MMR_REGION_NES_CPU_RAM, 2048 },
+		{ MMR_REGION_SNES_WRAM,   131072 },
+		{ MMR_REGION_GEN_68K_RAM, 65536 },
+	};
+	const char *paths[] = { nes_path, snes_path, gen_path };
+	struct mmr_layout *l;
+	u32 i;
 	int r;
 
 	mutex_init(&gdev.lock);
 	init_waitqueue_head(&gdev.wq);
+	INIT_DELAYED_WORK(&gdev.publish_work, mmr_publish_work_fn);
+	atomic64_set(&gdev.frame_counter, 0);
+	gdev.load_ns = ktime_get_ns();
 
-	/* Default to NES core_id=1 to match userspace mapping. */
-	gdev.core_id = MMR_CORE_NES;
-	gdev.map_version = 0;
+	if (publish_hz == 0 || publish_hz > 1000) {
+		pr_err("mmr_memtap_loopback: publish_hz must be 1..1000\n");
+		return -EINVAL;
+	}
+	if (history > 256) {
+		pr_err("mmr_memtap_loopback: history must be 0..256\n");
+		return -EINVAL;
+	}
 
-	gdev.region_count = 0;
+	l = kzalloc(sizeof(*l), GFP_KERNEL);
+	if (!l)
+		return -ENOMEM;
 
-	mutex_lock(&gdev.lock);
-	if (nes_path) {
-		gdev.regions[gdev.region_count++] = (struct mmr_region_desc){
-			.region_id  = MMR_REGION_NES_CPU_RAM,
-			.flags      = MMR_RF_SNAPSHOT,
-			.size_bytes = 2048,
-		};
-	}
-	if (snes_path) {
-		gdev.regions[gdev.region_count++] = (struct mmr_region_desc){
-			.region_id  = MMR_REGION_SNES_WRAM,
-			.flags      = MMR_RF_SNAPSHOT,
-			.size_bytes = 131072,
-		};
-	}
-	if (gen_path) {
-		gdev.regions[gdev.region_count++] = (struct mmr_region_desc){
-			.region_id  = MMR_REGION_GEN_68K_RAM,
-			.flags      = MMR_RF_SNAPSHOT,
-			.size_bytes = 65536,
-		};
-	}
-
-	gdev.frame_counter = 0;
-	mutex_unlock(&gdev.lock);
+	/* Default to NES core_id=1 to match userspace mapping. */
+	l->core_id = MMR_CORE_NES;
+	l->map_version = 0;
+
+	for (i = 0; i < ARRAY_SIZE(defs); i++) {
+		if (!paths[i] && !user_publish)
+			continue;
+		region_init(&l->regions[l->region_count++], defs[i].region_id, defs[i].size, paths[i]);
+		l->max_size = max(l->max_size, defs[i].size);
+		if (paths[i])
+			l->has_files = true;
+	}
 
-	if (gdev.region_count == 0) {
-		pr_err("mmr_memtap_loopback: no regions enabled. Pass nes_path=... (and/or snes_path/gen_path)\n");
+	if (l->region_count == 0) {
+		pr_err("mmr_memtap_loopback: no regions enabled. Pass nes_path=... (and/or snes_path/gen_path, or user_publish=1)\n");
+		kfree(l);
 		return -EINVAL;
 	}
 
+	rcu_assign_pointer(gdev.layout, l);
+
+	/* publish once up front so the first reader never sees an empty region */
+	mmr_publish_files();
+
 	r = misc_register(&mmr_misc);
 	if (r) {
 		pr_err("mmr_memtap_loopback: misc_register failed: %d\n", r);
+		mmr_free_layout();
 		return r;
 	}
 
-	pr_info("mmr_memtap_loopback: registered /dev/mmr_memtap (regions=%u)\n", gdev.region_count);
+	if (l->has_files)
+		schedule_delayed_work(&gdev.publish_work, msecs_to_jiffies(1000 / publish_hz));
+
+	/* debugfs is best effort; the device works without it */
+	gdev.debugfs_dir = debugfs_create_dir("mmr_memtap", NULL);
+	debugfs_create_file("stats", 0444, gdev.debugfs_dir, NULL, &mmr_stats_fops);
+
+	pr_info("mmr_memtap_loopback: registered /dev/mmr_memtap (regions=%u publish_hz=%u history=%u user_publish=%d)\n",
+		l->region_count, publish_hz, history, user_publish);
 	return 0;
 }
 
 static void __exit mmr_exit(void)
 {
+	debugfs_remove_recursive(gdev.debugfs_dir);
 	misc_deregister(&mmr_misc);
+	cancel_delayed_work_sync(&gdev.publish_work);
+	mmr_free_layout();
 	pr_info("mmr_memtap_loopback: unloaded\n");
 }
 
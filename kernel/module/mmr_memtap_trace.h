@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Tracepoints for the memtap loopback driver.
+ *
+ * Enable with e.g. `trace-cmd record -e mmr_memtap` or
+ * `perf record -e 'mmr_memtap:*'` to line kernel-side publish/read/wait
+ * time up against daemon frame time.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mmr_memtap
+
+#if !defined(_MMR_MEMTAP_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _MMR_MEMTAP_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(mmr_publish,
+	TP_PROTO(u64 frame, u32 region_id, u32 dirty_pages),
+	TP_ARGS(frame, region_id, dirty_pages),
+	TP_STRUCT__entry(
+		__field(u64, frame)
+		__field(u32, region_id)
+		__field(u32, dirty_pages)
+	),
+	TP_fast_assign(
+		__entry->frame       = frame;
+		__entry->region_id   = region_id;
+		__entry->dirty_pages = dirty_pages;
+	),
+	TP_printk("frame=%llu region=%u dirty_pages=%u",
+		  __entry->frame, __entry->region_id, __entry->dirty_pages)
+);
+
+TRACE_EVENT(mmr_read,
+	TP_PROTO(u32 region_id, u32 offset, u32 len, u64 frame),
+	TP_ARGS(region_id, offset, len, frame),
+	TP_STRUCT__entry(
+		__field(u32, region_id)
+		__field(u32, offset)
+		__field(u32, len)
+		__field(u64, frame)
+	),
+	TP_fast_assign(
+		__entry->region_id = region_id;
+		__entry->offset    = offset;
+		__entry->len       = len;
+		__entry->frame     = frame;
+	),
+	TP_printk("region=%u offset=%u len=%u frame=%llu",
+		  __entry->region_id, __entry->offset, __entry->len, __entry->frame)
+);
+
+TRACE_EVENT(mmr_wait_begin,
+	TP_PROTO(u64 last),
+	TP_ARGS(last),
+	TP_STRUCT__entry(
+		__field(u64, last)
+	),
+	TP_fast_assign(
+		__entry->last = last;
+	),
+	TP_printk("last=%llu", __entry->last)
+);
+
+TRACE_EVENT(mmr_wait_end,
+	TP_PROTO(u64 last, u64 frame, u64 wake_ns, int ret),
+	TP_ARGS(last, frame, wake_ns, ret),
+	TP_STRUCT__entry(
+		__field(u64, last)
+		__field(u64, frame)
+		__field(u64, wake_ns)
+		__field(int, ret)
+	),
+	TP_fast_assign(
+		__entry->last    = last;
+		__entry->frame   = frame;
+		__entry->wake_ns = wake_ns;
+		__entry->ret     = ret;
+	),
+	TP_printk("last=%llu frame=%llu wake_ns=%llu ret=%d",
+		  __entry->last, __entry->frame, __entry->wake_ns, __entry->ret)
+);
+
+#endif /* _MMR_MEMTAP_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mmr_memtap_trace
+#include <trace/define_trace.h>
@@ -65,6 +65,11 @@ typedef struct rc_runtime_richpresence_t {
 }
 rc_runtime_richpresence_t;
 
+/* mister-milestones patch (third_party/PATCHES.md): updates runtime->memrefs
+ * in place of rc_update_memref_values at the start of rc_runtime_do_frame. */
+struct rc_runtime_t;
+typedef void (RC_CCONV *rc_runtime_update_memrefs_t)(struct rc_runtime_t* runtime, rc_runtime_peek_t peek, void* ud);
+
 typedef struct rc_runtime_t {
   rc_runtime_trigger_t* triggers;
   uint32_t trigger_count;
@@ -79,6 +84,9 @@ typedef struct rc_runtime_t {
   struct rc_memrefs_t* memrefs;
 
   uint8_t owns_self;
+
+  /* mister-milestones patch: NULL (the default) keeps rc_update_memref_values */
+  rc_runtime_update_memrefs_t update_memrefs;
 }
 rc_runtime_t;
 
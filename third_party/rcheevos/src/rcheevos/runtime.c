@@ -514,7 +514,11 @@ void rc_runtime_do_frame(rc_runtime_t* self, rc_runtime_event_handler_t event_ha
 
   runtime_event.value = 0;
 
-  rc_update_memref_values(self->memrefs, peek, ud);
+  /* mister-milestones patch (third_party/PATCHES.md) */
+  if (self->update_memrefs)
+    self->update_memrefs(self, peek, ud);
+  else
+    rc_update_memref_values(self->memrefs, peek, ud);
 
   for (i = self->trigger_count - 1; i >= 0; --i) {
     rc_trigger_t* trigger = self->triggers[i].trigger;
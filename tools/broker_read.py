@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Read frames the daemon republishes with --broker (see daemon/broker.h).
+
+Examples:
+  broker_read.py --info
+  broker_read.py --peek 0x075A --peek 0x07ED:2 --follow
+  broker_read.py --dump /tmp/frame.bin
+  broker_read.py --dump /tmp/frame.bin --bus-order
+
+Frames are in the layout RetroAchievements addresses (version 2 segments):
+Genesis 68K RAM has each 16-bit word byte-swapped against bus order, so
+--peek addresses are RA addresses. --bus-order swaps Genesis frames back.
+"""
+import argparse
+import mmap
+import os
+import struct
+import sys
+import time
+
+MAGIC = 0x4B52424D
+VERSION = 2
+
+CORE_GENESIS = 3  # MMR_CORE_GENESIS: frames word-swapped (adapters.c ingest)
+
+# mmr_broker_header_t / mmr_broker_slot_t
+HEADER = struct.Struct("<IIIIIIIIQ24x")
+SLOT = struct.Struct("<IIQQII32x")
+
+
+class Broker:
+    def __init__(self, name):
+        path = os.path.join("/dev/shm", name)
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            self.mm = mmap.mmap(fd, 0, mmap.MAP_SHARED, mmap.PROT_READ)
+        finally:
+            os.close(fd)
+
+        (magic, version, self.header_size, self.slot_count, self.slot_stride,
+         self.capacity, _latest, self.writer_pid, _published) = HEADER.unpack_from(self.mm, 0)
+        if magic != MAGIC:
+            raise SystemExit(f"{path}: not a broker segment (magic 0x{magic:08x})")
+        if version != VERSION:
+            raise SystemExit(f"{path}: unsupported broker version {version}")
+
+    def header(self):
+        return HEADER.unpack_from(self.mm, 0)
+
+    def read(self, ranges=None, retries=1000):
+        """Return (frame, core_id, region_id, mono_ns, data) from the newest slot.
+
+        ranges is a list of (offset, length); None copies the whole frame.
+        Retries while the slot is being written (seqlock)."""
+        for _ in range(retries):
+            latest = self.header()[6]
+            off = self.header_size + latest * self.slot_stride
+            s1, size, frame, mono_ns, core_id, region_id = SLOT.unpack_from(self.mm, off)
+            if s1 & 1:
+                continue
+            base = off + SLOT.size
+            if ranges is None:
+                data = self.mm[base:base + size]
+            else:
+                data = [self.mm[base + o:base + o + n] if o + n <= size else b""
+                        for o, n in ranges]
+            s2 = struct.unpack_from("<I", self.mm, off)[0]
+            if s1 == s2:
+                return frame, core_id, region_id, mono_ns, data
+        raise RuntimeError("broker slot kept changing under the reader")
+
+
+def to_bus_order(core_id, data):
+    """Undo the daemon's ingest stage for cores that have one."""
+    if core_id != CORE_GENESIS:
+        return data
+    b = bytearray(data)
+    n = len(b) & ~1
+    b[0:n:2], b[1:n:2] = b[1:n:2], b[0:n:2]
+    return bytes(b)
+
+
+def parse_peek(spec):
+    addr, _, n = spec.partition(":")
+    return int(addr, 0), int(n or "1", 0)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--name", default="mmr-frames", help="segment name under /dev/shm")
+    ap.add_argument("--info", action="store_true", help="print the segment header and exit")
+    ap.add_argument("--peek", action="append", default=[], metavar="ADDR[:N]",
+                    help="print N bytes (little-endian value) at ADDR; repeatable")
+    ap.add_argument("--dump", metavar="FILE", help="write one consistent frame to FILE")
+    ap.add_argument("--bus-order", action="store_true",
+                    help="--dump bytes in the core's bus order (Genesis: undo the word swap)")
+    ap.add_argument("--follow", action="store_true", help="keep printing on every new frame")
+    ap.add_argument("--interval", type=float, default=1 / 60, help="poll interval in seconds")
+    args = ap.parse_args()
+
+    br = Broker(args.name)
+
+    if args.info:
+        _, _, hsz, slots, stride, cap, latest, pid, published = br.header()
+        print(f"writer_pid={pid} slots={slots} stride={stride} capacity={cap} "
+              f"latest_slot={latest} published={published}")
+        return
+
+    if args.dump:
+        frame, core_id, region_id, _, data = br.read()
+        if args.bus_order:
+            data = to_bus_order(core_id, data)
+        with open(args.dump, "wb") as f:
+            f.write(data)
+        print(f"frame={frame} core={core_id} region={region_id} bytes={len(data)} -> {args.dump}")
+        return
+
+    ranges = [parse_peek(p) for p in args.peek]
+    if not ranges:
+        ap.error("nothing to do: use --info, --dump or --peek")
+
+    last = None
+    while True:
+        frame, core_id, region_id, _, parts = br.read(ranges)
+        if frame != last:
+            vals = " ".join(f"0x{o:04X}={int.from_bytes(b, 'little')}" for (o, _), b in zip(ranges, parts))
+            print(f"frame={frame} core={core_id} region={region_id} {vals}", flush=True)
+            last = frame
+        if not args.follow:
+            return
+        time.sleep(args.interval)
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except KeyboardInterrupt:
+        sys.exit(0)
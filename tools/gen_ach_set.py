@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+"""Generate synthetic .ach achievement sets for engine scaling benchmarks.
+
+The output is valid rcheevos trigger syntax in the daemon's .ach format
+(see achievements/smb1_demo.ach). Everything is drawn from one seeded PRNG,
+so the same arguments always produce the same file. The arguments are also
+recorded in the file header, which means any set can be regenerated from
+the set itself.
+
+Examples:
+  gen_ach_set.py --core nes --count 1000 --seed 1 -o /tmp/nes_1k.ach
+  gen_ach_set.py --core snes --count 10000 --conds 4-12 --spread uniform
+  gen_ach_set.py --core genesis --count 100 --hits 0.5 --addsource 0.2 --chain 4
+
+Knobs (fractions are per condition unless noted):
+  --conds MIN-MAX     conditions per trigger, including chain links
+  --conds-dist        flat, or skewed toward MIN the way real sets are
+  --hits / --max-hits hit targets (log-uniform in 2..max-hits)
+  --delta / --prior   compare against the previous / prior value of the same memref
+  --addsource/--chain AddSource chains of 1..chain links summed into one compare
+  --addaddress        AddAddress pointer hops (pointer read + small offset)
+  --pauseif/--resetif PauseIf / ResetIf conditions
+  --alts              fraction of triggers that get 1..max-alts alt groups
+  --spread            uniform over the region, or clustered around a few hot spots
+"""
+import argparse
+import math
+import random
+import sys
+
+# region bytes per core, as exposed by memtap (see daemon/adapters.c)
+REGION_SIZE = {
+    "nes": 0x0800,
+    "genesis": 0x10000,
+    "snes": 0x20000,
+}
+
+# ach_load.c reads lines into a 2 KiB buffer
+MAX_LINE = 2000
+
+CMP_WEIGHTS = [("=", 50), ("!=", 15), (">", 10), ("<", 10), (">=", 8), ("<=", 7)]
+
+
+def parse_range(spec):
+    lo, _, hi = spec.partition("-")
+    lo = int(lo)
+    hi = int(hi or lo)
+    if lo < 1 or hi < lo:
+        raise argparse.ArgumentTypeError(f"invalid range '{spec}' (MIN-MAX, MIN >= 1)")
+    return lo, hi
+
+
+def fraction(s):
+    v = float(s)
+    if not 0.0 <= v <= 1.0:
+        raise argparse.ArgumentTypeError(f"{s} is not in 0..1")
+    return v
+
+
+class Generator:
+    def __init__(self, args):
+        self.a = args
+        self.rng = random.Random(args.seed)
+        self.size = REGION_SIZE[args.core]
+        if args.spread == "clustered":
+            self.centers = [self.rng.randrange(self.size) for _ in range(args.clusters)]
+
+    def chance(self, p):
+        return self.rng.random() < p
+
+    def pick_cmp(self):
+        ops, weights = zip(*CMP_WEIGHTS)
+        return self.rng.choices(ops, weights)[0]
+
+    def address(self):
+        if self.a.spread == "uniform":
+            return self.rng.randrange(self.size)
+        c = self.rng.choice(self.centers)
+        off = self.rng.randint(-self.a.cluster_width, self.a.cluster_width)
+        return min(max(c + off, 0), self.size - 1)
+
+    def memref(self, addr=None):
+        """Return (operand text, max value) for a random read."""
+        if addr is None:
+            addr = self.address()
+        r = self.rng.random()
+        if r < 0.70:
+            return f"0xH{addr:06x}", 0xFF
+        if r < 0.90 and addr + 1 < self.size:
+            return f"0x{addr:06x}", 0xFFFF
+        bit = self.rng.randrange(8)
+        return f"0x{'MNOPQRST'[bit]}{addr:06x}", 1
+
+    def hit_suffix(self):
+        if not self.chance(self.a.hits):
+            return ""
+        target = int(math.exp(self.rng.uniform(math.log(2), math.log(self.a.max_hits))))
+        return f".{max(target, 2)}."
+
+    def compare(self, lhs, max_value):
+        """lhs against a constant, or its own delta/prior."""
+        r = self.rng.random()
+        if r < self.a.delta:
+            return f"{lhs}{self.pick_cmp()}d{lhs}"
+        if r < self.a.delta + self.a.prior:
+            return f"{lhs}!=p{lhs}"
+        return f"{lhs}{self.pick_cmp()}{self.rng.randint(0, max_value)}"
+
+    def condition_unit(self, budget):
+        """One logical condition; chains use several links. Returns a list of conditions."""
+        if budget >= 2 and self.chance(self.a.addsource):
+            links = self.rng.randint(1, min(self.a.chain, budget - 1))
+            out = [f"A:{self.memref()[0]}" for _ in range(links)]
+            lhs, max_value = self.memref()
+            total = max_value * (links + 1)
+            out.append(f"{lhs}{self.pick_cmp()}{self.rng.randint(0, total)}{self.hit_suffix()}")
+            return out
+
+        if budget >= 2 and self.chance(self.a.addaddress):
+            ptr, _ = self.memref()
+            lhs, max_value = self.memref(addr=self.rng.randrange(0x40))
+            return [f"I:{ptr}", self.compare(lhs, max_value) + self.hit_suffix()]
+
+        lhs, max_value = self.memref()
+        cond = self.compare(lhs, max_value)
+        r = self.rng.random()
+        if r < self.a.pauseif:
+            return [f"P:{cond}"]
+        if r < self.a.pauseif + self.a.resetif:
+            return [f"R:{cond}"]
+        return [cond + self.hit_suffix()]
+
+    def group(self, n):
+        out = []
+        while len(out) < n:
+            out.extend(self.condition_unit(n - len(out)))
+        return out
+
+    def cond_count(self):
+        lo, hi = self.a.conds
+        if self.a.conds_dist == "flat":
+            return self.rng.randint(lo, hi)
+        # geometric-ish: each extra condition is kept with p=0.6
+        n = lo
+        while n < hi and self.chance(0.6):
+            n += 1
+        return n
+
+    def trigger(self):
+        groups = [self.group(self.cond_count())]
+        if self.chance(self.a.alts):
+            for _ in range(self.rng.randint(1, self.a.max_alts)):
+                groups.append(self.group(max(1, self.cond_count() // 2)))
+        return "S".join("_".join(g) for g in groups)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--core", choices=sorted(REGION_SIZE), default="nes")
+    ap.add_argument("--count", type=int, default=100, help="number of achievements")
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--id-base", type=int, default=1000, help="first achievement id")
+    ap.add_argument("--conds", type=parse_range, default=(1, 6), metavar="MIN-MAX")
+    ap.add_argument("--conds-dist", choices=["flat", "skewed"], default="skewed")
+    ap.add_argument("--hits", type=fraction, default=0.15)
+    ap.add_argument("--max-hits", type=int, default=600)
+    ap.add_argument("--delta", type=fraction, default=0.25)
+    ap.add_argument("--prior", type=fraction, default=0.05)
+    ap.add_argument("--addsource", type=fraction, default=0.05)
+    ap.add_argument("--chain", type=int, default=3, help="max AddSource links per chain")
+    ap.add_argument("--addaddress", type=fraction, default=0.03)
+    ap.add_argument("--pauseif", type=fraction, default=0.05)
+    ap.add_argument("--resetif", type=fraction, default=0.05)
+    ap.add_argument("--alts", type=fraction, default=0.10, help="fraction of triggers with alt groups")
+    ap.add_argument("--max-alts", type=int, default=3)
+    ap.add_argument("--spread", choices=["uniform", "clustered"], default="clustered")
+    ap.add_argument("--clusters", type=int, default=16, help="hot spots for --spread clustered")
+    ap.add_argument("--cluster-width", type=int, default=32, help="+/- bytes around each hot spot")
+    ap.add_argument("-o", "--output", help="output file (default: stdout)")
+    args = ap.parse_args()
+
+    if args.count < 0 or args.max_hits < 2 or args.chain < 1 or args.max_alts < 1 or args.clusters < 1:
+        ap.error("--count must be >= 0, --max-hits >= 2, --chain/--max-alts/--clusters >= 1")
+    if args.delta + args.prior > 1.0 or args.pauseif + args.resetif > 1.0:
+        ap.error("--delta + --prior and --pauseif + --resetif must each be <= 1")
+
+    gen = Generator(args)
+    argv = " ".join(sys.argv[1:])
+    lines = [
+        f"# synthetic set: gen_ach_set.py {argv}".rstrip(),
+        f"# core={args.core} region=0x{gen.size:x} count={args.count} seed={args.seed}",
+        "",
+    ]
+    for i in range(args.count):
+        aid = args.id_base + i
+        for _ in range(100):
+            line = f'achievement {aid} "Synthetic {aid}" {gen.trigger()}'
+            if len(line) <= MAX_LINE:
+                break
+        else:
+            sys.exit(f"could not fit achievement {aid} in {MAX_LINE} bytes; lower --conds")
+        lines.append(line)
+
+    text = "\n".join(lines) + "\n"
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""Read the achievement progress table the daemon publishes with --progress
+(see daemon/progress.h).
+
+Examples:
+  progress_read.py --info
+  progress_read.py --id 1234 --id 1235 --follow
+  progress_read.py --all
+"""
+import argparse
+import mmap
+import os
+import struct
+import sys
+import time
+
+MAGIC = 0x4752504D
+VERSION = 1
+
+# mmr_progress_header_t / mmr_progress_buffer_t / mmr_progress_entry_t
+HEADER = struct.Struct("<IIIIIIIIIIQ16x")
+BUFFER = struct.Struct("<IIQQII32x")
+ENTRY = struct.Struct("<IBBHIIII")
+
+F_PERCENT = 0x01
+
+# RC_TRIGGER_STATE_*
+STATES = ["inactive", "waiting", "active", "paused", "reset", "triggered", "primed", "disabled"]
+
+
+class Progress:
+    def __init__(self, name):
+        path = os.path.join("/dev/shm", name)
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            self.mm = mmap.mmap(fd, 0, mmap.MAP_SHARED, mmap.PROT_READ)
+        finally:
+            os.close(fd)
+
+        (magic, version, self.header_size, self.buffer_count, self.buffer_stride,
+         self.capacity, self.index_size, _latest, self.writer_pid, _, _published) = HEADER.unpack_from(self.mm, 0)
+        if magic != MAGIC:
+            raise SystemExit(f"{path}: not a progress segment (magic 0x{magic:08x})")
+        if version != VERSION:
+            raise SystemExit(f"{path}: unsupported progress version {version}")
+
+    def header(self):
+        return HEADER.unpack_from(self.mm, 0)
+
+    def _hash(self, id_):
+        return (id_ * 0x9E3779B1) & 0xFFFFFFFF & (self.index_size - 1)
+
+    def read(self, ids=None, retries=1000):
+        """Return (frame, core_id, {id: entry tuple}) from the newest buffer.
+
+        ids=None returns every entry; otherwise each id is looked up through
+        the table's hash index. Retries while the buffer is being written."""
+        for _ in range(retries):
+            latest = self.header()[7]
+            off = self.header_size + latest * self.buffer_stride
+            s1, count, frame, _mono_ns, core_id, _set_id = BUFFER.unpack_from(self.mm, off)
+            if s1 & 1:
+                continue
+            index_off = off + BUFFER.size
+            entries_off = index_off + 4 * self.index_size
+            out = {}
+            if ids is None:
+                for i in range(count):
+                    e = ENTRY.unpack_from(self.mm, entries_off + i * ENTRY.size)
+                    out[e[0]] = e
+            else:
+                for id_ in ids:
+                    slot = self._hash(id_)
+                    for _ in range(self.index_size):
+                        pos = struct.unpack_from("<I", self.mm, index_off + 4 * slot)[0]
+                        if pos == 0 or pos > count:
+                            break
+                        e = ENTRY.unpack_from(self.mm, entries_off + (pos - 1) * ENTRY.size)
+                        if e[0] == id_:
+                            out[id_] = e
+                            break
+                        slot = (slot + 1) & (self.index_size - 1)
+            s2 = struct.unpack_from("<I", self.mm, off)[0]
+            if s1 == s2:
+                return frame, core_id, out
+        raise RuntimeError("progress buffer kept changing under the reader")
+
+
+def describe(e):
+    id_, state, flags, _, value, target, hits, _ = e
+    text = f"id={id_} state={STATES[state] if state < len(STATES) else state}"
+    if target:
+        if flags & F_PERCENT:
+            text += f" measured={min(value, target) * 100 // target}%"
+        else:
+            text += f" measured={value}/{target}"
+    if hits:
+        text += f" hits={hits}"
+    return text
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--name", default="mmr-progress", help="segment name under /dev/shm")
+    ap.add_argument("--info", action="store_true", help="print the segment header and exit")
+    ap.add_argument("--id", action="append", type=lambda s: int(s, 0), default=[], metavar="N",
+                    help="print achievement N; repeatable")
+    ap.add_argument("--all", action="store_true", help="print every achievement in the table")
+    ap.add_argument("--follow", action="store_true", help="keep printing on every new frame")
+    ap.add_argument("--interval", type=float, default=1 / 60, help="poll interval in seconds")
+    args = ap.parse_args()
+
+    pg = Progress(args.name)
+
+    if args.info:
+        h = pg.header()
+        print(f"writer_pid={h[8]} buffers={h[3]} stride={h[4]} capacity={h[5]} "
+              f"index_size={h[6]} latest_buffer={h[7]} published={h[10]}")
+        return
+
+    if not args.id and not args.all:
+        ap.error("nothing to do: use --info, --id or --all")
+
+    last = None
+    while True:
+        frame, core_id, entries = pg.read(None if args.all else args.id)
+        if frame != last:
+            for id_ in (sorted(entries) if args.all else args.id):
+                line = describe(entries[id_]) if id_ in entries else f"id={id_} not loaded"
+                print(f"frame={frame} core={core_id} {line}", flush=True)
+            last = frame
+        if not args.follow:
+            return
+        time.sleep(args.interval)
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except KeyboardInterrupt:
+        sys.exit(0)